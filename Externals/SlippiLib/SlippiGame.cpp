@@ -1,11 +1,36 @@
 #include <string>
+#include <chrono>
+#include <climits>
 #include <codecvt>
+#include <cstring>
 #include <locale>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include <thread>
+
+#include <zlib.h>
+
 #include "SlippiGame.h"
 
 namespace Slippi {
 
+  // How far past the end of a file it is mapped, a whole game is a few MB so a live one only gets mapped
+  // again every once in a while
+  const size_t MAPPING_GROWTH_RESERVE = 16 * 1024 * 1024;
+
   //**********************************************************************
   //*                         Event Handlers
   //**********************************************************************
@@ -46,7 +71,34 @@ namespace Slippi {
     return *(float*)(&bytes);
   }
 
-  void handleGameInit(Game* game, uint32_t maxSize) {
+  FrameData* findFrame(Game* game, int32_t frame) {
+    int64_t idx = (int64_t)frame - GAME_FIRST_FRAME;
+    if (idx < 0 || idx >= (int64_t)game->framesByIndex.size()) {
+      return nullptr;
+    }
+
+    return game->framesByIndex[(size_t)idx];
+  }
+
+  FrameData* addFrame(Game* game, int32_t frameCount) {
+    game->frames.emplace_back();
+    FrameData* frame = &game->frames.back();
+    frame->frame = frameCount;
+    frame->numSinceStart = (uint32_t)game->frames.size() - 1;
+
+    int64_t idx = (int64_t)frameCount - GAME_FIRST_FRAME;
+    if (idx >= 0) {
+      if (idx >= (int64_t)game->framesByIndex.size()) {
+        game->framesByIndex.resize((size_t)idx + 1, nullptr);
+      }
+
+      game->framesByIndex[(size_t)idx] = frame;
+    }
+
+    return frame;
+  }
+
+  void handleGameInit(Game* game, uint8_t* data, uint32_t maxSize) {
     int idx = 0;
 
     // Read version number
@@ -152,7 +204,7 @@ namespace Slippi {
     }
   }
 
-  void handleGeckoList(Game* game, uint32_t maxSize) {
+  void handleGeckoList(Game* game, uint8_t* data, uint32_t maxSize) {
     game->settings.geckoCodes.clear();
     game->settings.geckoCodes.insert(game->settings.geckoCodes.end(), data, data + maxSize);
 
@@ -160,50 +212,46 @@ namespace Slippi {
     game->areSettingsLoaded = true;
   }
 
-  void handleFrameStart(Game* game, uint32_t maxSize) {
+  void handleFrameStart(Game* game, uint8_t* data, uint32_t maxSize) {
     int idx = 0;
 
     //Check frame count
     int32_t frameCount = readWord(data, idx, maxSize, 0);
     game->frameCount = frameCount;
 
-    auto frameUniquePtr = std::make_unique<FrameData>();
-    FrameData* frame = frameUniquePtr.get();
-
-    frame->frame = frameCount;
-    frame->randomSeedExists = true;
-    frame->randomSeed = readWord(data, idx, maxSize, 0);
-
     // Add frame to game. The frames are stored in multiple ways because
     // for games with rollback, the same frame may be replayed multiple times
-    frame->numSinceStart = game->frames.size();
-    game->frames.push_back(std::move(frameUniquePtr));
-    game->framesByIndex[frameCount] = frame;
+    FrameData* frame = addFrame(game, frameCount);
+    frame->randomSeedExists = true;
+    frame->randomSeed = readWord(data, idx, maxSize, 0);
   }
 
-  void handlePreFrameUpdate(Game* game, uint32_t maxSize) {
+  void handlePreFrameUpdate(Game* game, uint8_t* data, uint32_t maxSize) {
     int idx = 0;
 
     //Check frame count
     int32_t frameCount = readWord(data, idx, maxSize, 0);
     game->frameCount = frameCount;
 
-    auto frameUniquePtr = std::make_unique<FrameData>();
-    FrameData* frame = frameUniquePtr.get();
-    bool isNewFrame = true;
+    uint8_t playerSlot = readByte(data, idx, maxSize, 0);
+    uint8_t isFollower = readByte(data, idx, maxSize, 0);
+    if (playerSlot >= 4) {
+      return;
+    }
 
-    if (game->framesByIndex.count(frameCount)) {
+    FrameData* frame;
+    if (findFrame(game, frameCount)) {
       // If this frame already exists, get the current frame
-      frame = game->frames.back().get();
-      isNewFrame = false;
+      frame = &game->frames.back();
+    }
+    else {
+      frame = addFrame(game, frameCount);
     }
 
-    frame->frame = frameCount;
-
-    PlayerFrameData p;
-
-    uint8_t playerSlot = readByte(data, idx, maxSize, 0);
-    uint8_t isFollower = readByte(data, idx, maxSize, 0);
+    // Set the player data for the player or follower in place
+    PlayerFrameData& p = isFollower ? frame->followers[playerSlot] : frame->players[playerSlot];
+    uint8_t& mask = isFollower ? frame->followerMask : frame->playerMask;
+    mask |= 1 << playerSlot;
 
     //Load random seed for player frame update
     p.randomSeed = readWord(data, idx, maxSize, 0);
@@ -227,51 +275,51 @@ namespace Slippi {
     p.lTrigger = readFloat(data, idx, maxSize, 0);
     p.rTrigger = readFloat(data, idx, maxSize, 0);
 
-    if (asmEvents[EVENT_PRE_FRAME_UPDATE] >= 59) {
+    if (maxSize >= 59) {
       p.joystickXRaw = readByte(data, idx, maxSize, 0);
     }
 
     uint32_t noPercent = 0xFFFFFFFF;
     p.percent = readFloat(data, idx, maxSize, *(float*)(&noPercent));
-
-    // Add player data to frame
-    std::unordered_map<uint8_t, PlayerFrameData>* target;
-    target = isFollower ? &frame->followers : &frame->players;
-
-    // Set the player data for the player or follower
-    target->operator[](playerSlot) = p;
-
-    // Add frame to game
-    if (isNewFrame) {
-      frame->numSinceStart = game->frames.size();
-      game->frames.push_back(std::move(frameUniquePtr));
-      game->framesByIndex[frameCount] = frame;
-    }
   }
 
-  void handlePostFrameUpdate(Game* game, uint32_t maxSize) {
+  void handlePostFrameUpdate(Game* game, uint8_t* data, uint32_t maxSize) {
     int idx = 0;
 
     //Check frame count
     int32_t frameCount = readWord(data, idx, maxSize, 0);
 
-    FrameData* frame;
-    if (game->framesByIndex.count(frameCount)) {
-      // If this frame already exists, get the current frame
-      frame = game->frames.back().get();
+    if (!findFrame(game, frameCount)) {
+      return;
     }
 
+    // If this frame already exists, get the current frame
+    FrameData* frame = &game->frames.back();
+
     // As soon as a post frame update happens, we know we have received all the inputs
     // This is used to determine if a frame is ready to be used for a replay (for mirroring)
     frame->inputsFullyFetched = true;
 
     uint8_t playerSlot = readByte(data, idx, maxSize, 0);
     uint8_t isFollower = readByte(data, idx, maxSize, 0);
+    if (playerSlot >= 4) {
+      return;
+    }
 
     PlayerFrameData* p = isFollower ? &frame->followers[playerSlot] : &frame->players[playerSlot];
+    uint8_t& mask = isFollower ? frame->followerMask : frame->playerMask;
+    mask |= 1 << playerSlot;
 
     p->internalCharacterId = readByte(data, idx, maxSize, 0);
 
+    // Animation, position, facing direction and percent are kept from the pre frame update
+    idx += 18;
+    p->shieldSize = readFloat(data, idx, maxSize, 0);
+    p->lastMoveHitId = readByte(data, idx, maxSize, 0);
+    p->comboCount = readByte(data, idx, maxSize, 0);
+    p->lastHitBy = readByte(data, idx, maxSize, 0);
+    p->stocks = readByte(data, idx, maxSize, 0);
+
     // Check if a player started as sheik and update
     if (frameCount == GAME_FIRST_FRAME && p->internalCharacterId == GAME_SHEIK_INTERNAL_ID) {
       game->settings.players[playerSlot].characterId = GAME_SHEIK_EXTERNAL_ID;
@@ -280,12 +328,10 @@ namespace Slippi {
     // Set settings loaded if this is the last character
     if (frameCount == GAME_FIRST_FRAME) {
       uint8_t lastPlayerIndex = 0;
-      for (auto it = frame->players.begin(); it != frame->players.end(); ++it) {
-        if (it->first <= lastPlayerIndex) {
-          continue;
+      for (uint8_t i = 0; i < 4; i++) {
+        if (frame->playerMask & (1 << i)) {
+          lastPlayerIndex = i;
         }
-
-        lastPlayerIndex = it->first;
       }
 
       if (playerSlot >= lastPlayerIndex) {
@@ -294,7 +340,7 @@ namespace Slippi {
     }
   }
 
-  void handleFrameEnd(Game* game, uint32_t maxSize) {
+  void handleFrameEnd(Game* game, uint8_t* data, uint32_t maxSize) {
     int idx = 0;
 
     int32_t frameCount = readWord(data, idx, maxSize, 0);
@@ -303,23 +349,19 @@ namespace Slippi {
     game->lastFinalizedFrame = lastFinalizedFrame;
   }
 
-  void handleGameEnd(Game* game, uint32_t maxSize) {
+  void handleGameEnd(Game* game, uint8_t* data, uint32_t maxSize) {
     int idx = 0;
 
     game->winCondition = readByte(data, idx, maxSize, 0);
   }
 
   // This function gets the position where the raw data starts
-  int getRawDataPosition(std::ifstream* f) {
-    char buffer[2];
-    f->seekg(0, std::ios::beg);
-    f->read(buffer, 2);
-
-    if (buffer[0] == 0x36) {
+  size_t getRawDataPosition(uint8_t* buf) {
+    if (buf[0] == 0x36) {
       return 0;
     }
 
-    if (buffer[0] != '{') {
+    if (buf[0] != '{') {
       // TODO: Do something here to cause an error
       return 0;
     }
@@ -329,50 +371,269 @@ namespace Slippi {
     return 15;
   }
 
-  uint32_t getRawDataLength(std::ifstream* f, int position, int fileSize) {
-    if (position == 0) {
-      return fileSize;
-    }
-
-    char buffer[4];
-    f->seekg(position - 4, std::ios::beg);
-    f->read(buffer, 4);
+  uint32_t readLE32(const uint8_t* a) {
+    return a[0] | a[1] << 8 | a[2] << 16 | (uint32_t)a[3] << 24;
+  }
 
-    uint8_t* byteBuf = (uint8_t*)&buffer[0];
-    uint32_t length = byteBuf[0] << 24 | byteBuf[1] << 16 | byteBuf[2] << 8 | byteBuf[3];
-    return length;
+  uint64_t readLE64(const uint8_t* a) {
+    return readLE32(a) | (uint64_t)readLE32(&a[4]) << 32;
   }
 
-  std::unordered_map<uint8_t, uint32_t> getMessageSizes(std::ifstream* f, int position) {
-    char buffer[2];
-    f->seekg(position, std::ios::beg);
-    f->read(buffer, 2);
-    if (buffer[0] != EVENT_PAYLOAD_SIZES) {
+  std::unordered_map<uint8_t, uint32_t> getMessageSizes(uint8_t* buf) {
+    if (buf[0] != EVENT_PAYLOAD_SIZES) {
       return {};
     }
 
-    int payloadLength = buffer[1];
+    int payloadLength = buf[1];
     std::unordered_map<uint8_t, uint32_t> messageSizes = {
       { EVENT_PAYLOAD_SIZES, payloadLength }
     };
 
-
-    std::vector<char> messageSizesBuffer(payloadLength - 1);
-    f->read(&messageSizesBuffer[0], payloadLength - 1);
+    uint8_t* messageSizesBuffer = &buf[2];
     for (int i = 0; i < payloadLength - 1; i += 3) {
       uint8_t command = messageSizesBuffer[i];
-
-      // Extract the bytes in u8s. Without this the chars don't or together well
-      uint8_t byte1 = messageSizesBuffer[i + 1];
-      uint8_t byte2 = messageSizesBuffer[i + 2];
-
-      uint16_t size = byte1 << 8 | byte2;
+      uint16_t size = messageSizesBuffer[i + 1] << 8 | messageSizesBuffer[i + 2];
       messageSizes[command] = size;
     }
 
     return messageSizes;
   }
 
+  bool SlippiGame::openFile() {
+#ifdef _WIN32
+    // On Windows, we need to convert paths to std::wstring to deal with UTF-8
+    std::wstring convertedPath = std::wstring_convert<std::codecvt_utf8<wchar_t>>().from_bytes(path);
+
+    // The replay may still be getting written to, so let the writer keep its access
+    HANDLE handle = CreateFileW(convertedPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    fileHandle = handle;
+#else
+    fileDescriptor = open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+      return false;
+    }
+#endif
+
+    return true;
+  }
+
+  void SlippiGame::unmap() {
+    if (!mappedData) {
+      return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(mappedData);
+    CloseHandle((HANDLE)mappingHandle);
+    mappingHandle = nullptr;
+#else
+    munmap(mappedData, mappedCapacity);
+    mappedCapacity = 0;
+#endif
+
+    mappedData = nullptr;
+    mappedSize = 0;
+  }
+
+  void SlippiGame::closeFile() {
+    unmap();
+
+#ifdef _WIN32
+    if (fileHandle) {
+      CloseHandle((HANDLE)fileHandle);
+      fileHandle = nullptr;
+    }
+#else
+    if (fileDescriptor >= 0) {
+      close(fileDescriptor);
+      fileDescriptor = -1;
+    }
+#endif
+
+#ifdef __linux__
+    if (watchDescriptor >= 0) {
+      close(watchDescriptor);
+      watchDescriptor = -1;
+    }
+#endif
+  }
+
+  // Maps the whole file again if it grew past the mapping. Returns whether there is a mapping
+  bool SlippiGame::updateMapping() {
+#ifdef _WIN32
+    LARGE_INTEGER fileSize;
+    if (!fileHandle || !GetFileSizeEx((HANDLE)fileHandle, &fileSize)) {
+      return false;
+    }
+
+    size_t size = (size_t)fileSize.QuadPart;
+#else
+    struct stat st;
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &st) != 0) {
+      return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+#endif
+
+#ifndef _WIN32
+    if (size > mappedSize && size <= mappedCapacity) {
+      // Appended bytes are already in the mapping
+      mappedSize = size;
+    }
+#endif
+
+    if (size > mappedSize) {
+      unmap();
+
+#ifdef _WIN32
+      mappingHandle = CreateFileMappingW((HANDLE)fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (!mappingHandle) {
+        return false;
+      }
+
+      mappedData = (uint8_t*)MapViewOfFile((HANDLE)mappingHandle, FILE_MAP_READ, 0, 0, size);
+      if (!mappedData) {
+        CloseHandle((HANDLE)mappingHandle);
+        mappingHandle = nullptr;
+        return false;
+      }
+#else
+      // Only pages that are part of the file get touched, the rest of the range is just reserved for
+      // what gets written next
+      size_t capacity = size + MAPPING_GROWTH_RESERVE;
+      void* ptr = mmap(nullptr, capacity, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+      if (ptr == MAP_FAILED) {
+        return false;
+      }
+
+      mappedData = (uint8_t*)ptr;
+      mappedCapacity = capacity;
+#endif
+
+      mappedSize = size;
+    }
+
+    return mappedData != nullptr;
+  }
+
+  // Decompresses every block that has been fully written since the last call
+  void SlippiGame::decompressBlocks() {
+    if (compressedReadPos == 0) {
+      if (mappedSize < COMPRESSED_HEADER_SIZE) {
+        return;
+      }
+
+      compressedReadPos = COMPRESSED_HEADER_SIZE;
+    }
+
+    while (!isCompressedDataComplete) {
+      size_t blockPos = compressedReadPos;
+      if (hasBlockSelection) {
+        if (selectedBlockIdx >= selectedBlocks.size()) {
+          isCompressedDataComplete = true;
+          return;
+        }
+
+        blockPos = (size_t)selectedBlocks[selectedBlockIdx];
+      }
+
+      if (mappedSize < blockPos + 8) {
+        return;
+      }
+
+      uint32_t compressedSize = readLE32(&mappedData[blockPos]);
+      uint32_t rawSize = readLE32(&mappedData[blockPos + 4]);
+      if (compressedSize == COMPRESSED_INDEX_MARKER) {
+        // Made it to the index, the raw data length could not be filled in while the game was
+        // being written so do that here
+        if (decompressed.size() >= 15 && decompressed[0] == '{') {
+          decompressed[11] = rawSize >> 24;
+          decompressed[12] = rawSize >> 16;
+          decompressed[13] = rawSize >> 8;
+          decompressed[14] = rawSize;
+        }
+
+        isCompressedDataComplete = true;
+        return;
+      }
+
+      size_t dataPos = blockPos + COMPRESSED_BLOCK_HEADER_SIZE;
+      if (mappedSize < dataPos + compressedSize) {
+        // The rest of this block hasn't been written yet
+        return;
+      }
+
+      size_t pos = decompressed.size();
+      decompressed.resize(pos + rawSize);
+
+      uLongf decompressedSize = rawSize;
+      int result = uncompress(&decompressed[pos], &decompressedSize, &mappedData[dataPos], compressedSize);
+      if (result != Z_OK || decompressedSize != rawSize) {
+        // Treat a corrupt block like the end of the file
+        decompressed.resize(pos);
+        isCompressedDataComplete = true;
+        return;
+      }
+
+      compressedReadPos = dataPos + compressedSize;
+      selectedBlockIdx++;
+    }
+  }
+
+  // Uses the block index of a finished compressed replay to pick the blocks holding frames in
+  // [startFrame, endFrame]. The first block is always needed for the payload sizes and game settings
+  void SlippiGame::selectBlocks(int32_t startFrame, int32_t endFrame) {
+    if (!updateMapping() || mappedSize < COMPRESSED_HEADER_SIZE + COMPRESSED_TRAILER_SIZE ||
+        memcmp(mappedData, COMPRESSED_MAGIC, 4) != 0) {
+      return;
+    }
+
+    const uint8_t* trailer = &mappedData[mappedSize - COMPRESSED_TRAILER_SIZE];
+    if (memcmp(&trailer[8], COMPRESSED_INDEX_MAGIC, 4) != 0) {
+      // Not finished, there is no index yet
+      return;
+    }
+
+    uint64_t indexPos = readLE64(trailer);
+    if (indexPos + COMPRESSED_INDEX_HEADER_SIZE > mappedSize - COMPRESSED_TRAILER_SIZE) {
+      return;
+    }
+
+    uint32_t blockCount = readLE32(&mappedData[indexPos + 8]);
+    const uint8_t* entries = &mappedData[indexPos + COMPRESSED_INDEX_HEADER_SIZE];
+    if (indexPos + COMPRESSED_INDEX_HEADER_SIZE + (uint64_t)blockCount * COMPRESSED_INDEX_ENTRY_SIZE >
+        mappedSize - COMPRESSED_TRAILER_SIZE) {
+      return;
+    }
+
+    // Rollbacks can send a frame again after the next block started, so a block following
+    // one in the range is taken as well
+    bool wasPreviousSelected = false;
+    for (uint32_t i = 0; i < blockCount; i++) {
+      const uint8_t* entry = &entries[i * COMPRESSED_INDEX_ENTRY_SIZE];
+      int32_t firstFrame = (int32_t)readLE32(&entry[8]);
+      int32_t nextFirstFrame = INT_MAX;
+      if (i + 1 < blockCount) {
+        nextFirstFrame = (int32_t)readLE32(&entry[COMPRESSED_INDEX_ENTRY_SIZE + 8]);
+      }
+
+      bool isInRange = nextFirstFrame >= startFrame && firstFrame <= endFrame;
+      if (i == 0 || isInRange || wasPreviousSelected) {
+        selectedBlocks.push_back(readLE64(entry));
+      }
+
+      wasPreviousSelected = isInRange;
+    }
+
+    hasBlockSelection = true;
+  }
+
   void SlippiGame::processData() {
     if (isProcessingComplete) {
       // If we have finished processing this file, return
@@ -380,75 +641,62 @@ namespace Slippi {
     }
 
     // This function will process as much data as possible
-    int startPos = (int)file->tellg();
-    file->seekg(startPos);
-    if (startPos == 0) {
-      file->seekg(0, std::ios::end);
-      int len = (int)file->tellg();
+    if (!updateMapping()) {
+      return;
+    }
+
+    if (readPos == 0 && decompressed.empty()) {
+      isCompressed = mappedSize >= 4 && memcmp(mappedData, COMPRESSED_MAGIC, 4) == 0;
+    }
+
+    uint8_t* stream = mappedData;
+    size_t len = mappedSize;
+    if (isCompressed) {
+      decompressBlocks();
+      stream = decompressed.data();
+      len = decompressed.size();
+
+      // Only the blocks that were asked for get decompressed, they may not include the game end
+      if (isCompressedDataComplete && readPos >= len) {
+        isProcessingComplete = true;
+        return;
+      }
+    }
+
+    if (readPos == 0) {
       if (len < 2) {
         // If we can't read message sizes payload size yet, return
         return;
       }
 
-      int rawDataPos = getRawDataPosition(file.get());
-      int rawDataLen = len - rawDataPos;
-      if (rawDataLen < 2) {
+      size_t rawDataPos = getRawDataPosition(stream);
+      if (len < rawDataPos + 2) {
         // If we don't have enough raw data yet to read the replay file, return
-        // Reset to begining so that the startPos condition will be hit again
-        file->seekg(0);
         return;
       }
 
-      startPos = rawDataPos;
-
-      char buffer[2];
-      file->seekg(startPos);
-      file->read(buffer, 2);
-      file->seekg(startPos);
-      auto messageSizesSize = (int)buffer[1];
-      if (rawDataLen < messageSizesSize) {
+      size_t messageSizesSize = stream[rawDataPos + 1];
+      if (len < rawDataPos + 1 + messageSizesSize) {
         // If we haven't received the full payload sizes message, return
-        // Reset to begining so that the startPos condition will be hit again
-        file->seekg(0);
         return;
       }
 
-      asmEvents = getMessageSizes(file.get(), rawDataPos);
+      asmEvents = getMessageSizes(&stream[rawDataPos]);
+      readPos = rawDataPos;
     }
 
-    // Read everything to the end
-    file->seekg(0, std::ios::end);
-    int endPos = (int)file->tellg();
-    int sizeToRead = endPos - startPos;
-    file->seekg(startPos);
-    //log << "Size to read: " << sizeToRead << "\n";
-    //log << "Start Pos: " << startPos << "\n";
-    //log << "End Pos: " << endPos << "\n\n";
-    if (sizeToRead <= 0) {
-      return;
-    }
-
-    std::vector<char> newData(sizeToRead);
-    file->read(&newData[0], sizeToRead);
-
-    int newDataPos = 0;
-    while (newDataPos < sizeToRead) {
-      auto command = newData[newDataPos];
+    while (readPos < len) {
+      auto command = stream[readPos];
       auto payloadSize = asmEvents[command];
 
-      //char buff[100];
-      //snprintf(buff, sizeof(buff), "%x", command);
-      //log << "Command: " << buff << " | Payload Size: " << payloadSize << "\n";
-
-      auto remainingLen = sizeToRead - newDataPos;
-      if (remainingLen < ((int)payloadSize + 1)) {
+      auto remainingLen = len - readPos;
+      if (remainingLen < (size_t)payloadSize + 1) {
         // Here we don't have enough data to read the whole payload
         // Will be processed after getting more data (hopefully)
-        file->seekg(-remainingLen, std::ios::cur);
         return;
       }
 
-      data = (uint8_t*)&newData[newDataPos + 1];
+      uint8_t* data = &stream[readPos + 1];
 
       uint8_t isSplitComplete = false;
       uint32_t outerPayloadSize = payloadSize;
@@ -478,25 +726,25 @@ namespace Slippi {
 
       switch (command) {
       case EVENT_GAME_INIT:
-        handleGameInit(game.get(), payloadSize);
+        handleGameInit(game.get(), data, payloadSize);
         break;
       case EVENT_GECKO_LIST:
-        handleGeckoList(game.get(), payloadSize);
+        handleGeckoList(game.get(), data, payloadSize);
         break;
       case EVENT_FRAME_START:
-        handleFrameStart(game.get(), payloadSize);
+        handleFrameStart(game.get(), data, payloadSize);
         break;
       case EVENT_PRE_FRAME_UPDATE:
-        handlePreFrameUpdate(game.get(), payloadSize);
+        handlePreFrameUpdate(game.get(), data, payloadSize);
         break;
       case EVENT_POST_FRAME_UPDATE:
-        handlePostFrameUpdate(game.get(), payloadSize);
+        handlePostFrameUpdate(game.get(), data, payloadSize);
         break;
       case EVENT_FRAME_END:
-        handleFrameEnd(game.get(), payloadSize);
+        handleFrameEnd(game.get(), data, payloadSize);
         break;
       case EVENT_GAME_END:
-        handleGameEnd(game.get(), payloadSize);
+        handleGameEnd(game.get(), data, payloadSize);
         isProcessingComplete = true;
         break;
       case 0x55:
@@ -506,12 +754,11 @@ namespace Slippi {
         // ubjson file format
         //log.close();
         isProcessingComplete = true;
-        file->seekg(-remainingLen, std::ios::cur);
         return;
       }
 
       payloadSize = isSplitComplete ? outerPayloadSize : payloadSize;
-      newDataPos += payloadSize + 1;
+      readPos += payloadSize + 1;
     }
   }
 
@@ -520,37 +767,78 @@ namespace Slippi {
     result->game = std::make_unique<Game>();
     result->path = path;
 
-#ifdef _WIN32
-    // On Windows, we need to convert paths to std::wstring to deal with UTF-8
-    std::wstring convertedPath = std::wstring_convert<std::codecvt_utf8<wchar_t>>().from_bytes(path);
-    result->file = std::make_unique<std::ifstream>(convertedPath, std::ios::in | std::ios::binary);
-#else
-    result->file = std::make_unique<std::ifstream>(path, std::ios::in | std::ios::binary);
-#endif
-
     //result->log.open("log.txt");
-    if (!result->file->is_open()) {
+    if (!result->openFile()) {
       return nullptr;
     }
 
-    //int fileLength = (int)file.tellg();
-    //int rawDataPos = getRawDataPosition(&file);
-    //uint32_t rawDataLength = getRawDataLength(&file, rawDataPos, fileLength);
-    //asmEvents = getMessageSizes(&file, rawDataPos);
+    return std::move(result);
+  }
 
-    //std::vector<char> rawData(rawDataLength);
-    //file.seekg(rawDataPos, std::ios::beg);
-    //file.read(&rawData[0], rawDataLength);
+  std::unique_ptr<SlippiGame> SlippiGame::FromFile(std::string path, int32_t startFrame, int32_t endFrame) {
+    auto result = FromFile(path);
+    if (result) {
+      result->selectBlocks(startFrame, endFrame);
+    }
 
-    //SlippiGame* result = processFile((uint8_t*)&rawData[0], rawDataLength);
+    return result;
+  }
 
-    return std::move(result);
+  SlippiGame::~SlippiGame() {
+    closeFile();
   }
 
   bool SlippiGame::IsProcessingComplete() {
     return isProcessingComplete;
   }
 
+  bool SlippiGame::WaitForData(uint32_t timeoutMs) {
+    if (isProcessingComplete) {
+      return false;
+    }
+
+    size_t readSize = mappedSize;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+#ifdef __linux__
+    // The watch has to be in place before the size is checked or a write right in between is missed
+    if (watchDescriptor < 0) {
+      watchDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (watchDescriptor >= 0 && inotify_add_watch(watchDescriptor, path.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+        close(watchDescriptor);
+        watchDescriptor = -1;
+      }
+    }
+#endif
+
+    while (true) {
+      if (updateMapping() && mappedSize > readSize) {
+        return true;
+      }
+
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      if (remaining.count() <= 0) {
+        return false;
+      }
+
+#ifdef __linux__
+      if (watchDescriptor >= 0) {
+        pollfd watch = { watchDescriptor, POLLIN, 0 };
+        if (poll(&watch, 1, (int)remaining.count()) > 0) {
+          // Only whether something happened matters, the events themselves are dropped
+          char events[4096];
+          while (read(watchDescriptor, events, sizeof(events)) > 0) {
+          }
+        }
+        continue;
+      }
+#endif
+
+      // Without a way to be told about writes, check again shortly
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
   bool SlippiGame::AreSettingsLoaded() {
     processData();
     return game->areSettingsLoaded;
@@ -558,7 +846,7 @@ namespace Slippi {
 
   bool SlippiGame::DoesFrameExist(int32_t frame) {
     processData();
-    return (bool)game->framesByIndex.count(frame);
+    return findFrame(game.get(), frame) != nullptr;
   }
 
   std::array<uint8_t, 4> SlippiGame::GetVersion()
@@ -576,7 +864,7 @@ namespace Slippi {
 
   FrameData* SlippiGame::GetFrame(int32_t frame) {
     // Get the frame we want
-    return game->framesByIndex.at(frame);
+    return findFrame(game.get(), frame);
   }
 
   FrameData* SlippiGame::GetFrameAt(uint32_t pos) {
@@ -585,7 +873,7 @@ namespace Slippi {
     }
 
     // Get the frame we want
-    return game->frames[pos].get();
+    return &game->frames[pos];
   }
 
   int32_t SlippiGame::GetLastFinalizedFrame() {
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <array>
+#include <deque>
 #include <vector>
 #include <unordered_map>
 #include <iostream>
@@ -31,7 +32,22 @@ namespace Slippi {
 
   const uint32_t SPLIT_MESSAGE_INTERNAL_DATA_LEN = 512;
 
-  static uint8_t* data;
+  // Compressed replays start with COMPRESSED_MAGIC and a version byte padded to 8 bytes. The regular
+  // replay bytes follow in zlib blocks that each end on an event boundary, every block has a header of
+  // its compressed size, raw size and the first frame it has events for (all little endian). A
+  // finished file then has a block index: COMPRESSED_INDEX_MARKER in place of a compressed size, the
+  // raw data length, the block count and a (file offset, first frame) entry per block. The file ends
+  // with the offset of the index and COMPRESSED_INDEX_MAGIC
+  const uint8_t COMPRESSED_MAGIC[4] = { 'S', 'L', 'P', 'Z' };
+  const uint8_t COMPRESSED_INDEX_MAGIC[4] = { 'S', 'L', 'P', 'I' };
+  const uint8_t COMPRESSED_VERSION = 1;
+  const uint32_t COMPRESSED_HEADER_SIZE = 8;
+  const uint32_t COMPRESSED_BLOCK_HEADER_SIZE = 12;
+  const uint32_t COMPRESSED_BLOCK_SIZE = 64 * 1024;
+  const uint32_t COMPRESSED_INDEX_MARKER = 0xFFFFFFFF;
+  const uint32_t COMPRESSED_INDEX_HEADER_SIZE = 12;
+  const uint32_t COMPRESSED_INDEX_ENTRY_SIZE = 12;
+  const uint32_t COMPRESSED_TRAILER_SIZE = 12;
 
   typedef struct {
     // Every player update has its own rng seed because it might change in between players
@@ -71,8 +87,16 @@ namespace Slippi {
     bool randomSeedExists = false;
     uint32_t randomSeed;
     bool inputsFullyFetched = false;
-    std::unordered_map<uint8_t, PlayerFrameData> players;
-    std::unordered_map<uint8_t, PlayerFrameData> followers;
+
+    // Indexed by port, a bit is set in the mask for every port that has data on this frame
+    std::array<PlayerFrameData, 4> players;
+    std::array<PlayerFrameData, 4> followers;
+    uint8_t playerMask = 0;
+    uint8_t followerMask = 0;
+
+    bool HasPlayer(uint8_t port, bool isFollower) const {
+      return port < 4 && ((isFollower ? followerMask : playerMask) >> port) & 1;
+    }
   } FrameData;
 
   typedef struct {
@@ -101,8 +125,13 @@ namespace Slippi {
 
   typedef struct Game {
     std::array<uint8_t, 4> version;
-    std::unordered_map<int32_t, FrameData*> framesByIndex;
-    std::vector<std::unique_ptr<FrameData>> frames;
+
+    // Latest copy of every frame indexed by frame - GAME_FIRST_FRAME, nullptr for frames not seen yet
+    std::vector<FrameData*> framesByIndex;
+
+    // Every frame in the order they were received, rollbacks make the same frame show up multiple
+    // times. A deque keeps the pointers above valid as frames are added
+    std::deque<FrameData> frames;
     GameSettings settings;
     bool areSettingsLoaded = false;
 
@@ -113,20 +142,14 @@ namespace Slippi {
     uint8_t winCondition;
   } Game;
 
-  // TODO: This shouldn't be static. Doesn't matter too much atm because we always
-  // TODO: only read one file at a time
-  static std::unordered_map<uint8_t, uint32_t> asmEvents = {
-    { EVENT_GAME_INIT, 320 },
-    { EVENT_PRE_FRAME_UPDATE, 58 },
-    { EVENT_POST_FRAME_UPDATE, 33 },
-    { EVENT_GAME_END, 1 },
-    { EVENT_FRAME_START, 8 }
-  };
-
   class SlippiGame
   {
   public:
     static std::unique_ptr<SlippiGame> FromFile(std::string path);
+
+    // Same as above, but a finished compressed replay only has the blocks holding frames in
+    // [startFrame, endFrame] decompressed. Other frames will not exist
+    static std::unique_ptr<SlippiGame> FromFile(std::string path, int32_t startFrame, int32_t endFrame);
     bool AreSettingsLoaded();
     bool DoesFrameExist(int32_t frame);
     std::array<uint8_t, 4> GetVersion();
@@ -139,12 +162,65 @@ namespace Slippi {
     uint8_t getGameEndMethod();
     bool DoesPlayerExist(int8_t port);
     bool IsProcessingComplete();
+
+    // Blocks until the file grows past what has been read, for replays that are still being written.
+    // Returns false if nothing was appended within timeoutMs
+    bool WaitForData(uint32_t timeoutMs);
+    ~SlippiGame();
   private:
     std::unique_ptr<Game> game;
-    std::unique_ptr<std::ifstream> file;
-    std::vector<uint8_t> rawData;
     std::string path;
+
+    // The replay file is memory mapped and events are decoded straight from the mapping. The file
+    // may still be growing while it's being read, so the mapping is refreshed whenever it gets bigger.
+    // Outside of Windows the mapping reaches past the end of the file so appended bytes show up in it
+    // without mapping again, mappedSize is how much of it is file
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+    size_t mappedCapacity = 0;
+#endif
+#ifdef __linux__
+    // inotify instance watching the file for writes, set up by the first WaitForData
+    int watchDescriptor = -1;
+#endif
+    uint8_t* mappedData = nullptr;
+    size_t mappedSize = 0;
+    size_t readPos = 0;
+
+    bool openFile();
+    void closeFile();
+    bool updateMapping();
+    void unmap();
+
+    // Compressed replays are decompressed a block at a time onto the end of this buffer, which
+    // is then parsed exactly like the mapping of an uncompressed replay
+    bool isCompressed = false;
+    bool isCompressedDataComplete = false;
+    std::vector<uint8_t> decompressed;
+    size_t compressedReadPos = 0;
+
+    // File offsets of the blocks to decompress when only part of the replay was asked for
+    bool hasBlockSelection = false;
+    std::vector<uint64_t> selectedBlocks;
+    size_t selectedBlockIdx = 0;
+
+    void decompressBlocks();
+    void selectBlocks(int32_t startFrame, int32_t endFrame);
+
     std::ofstream log;
+
+    // Payload size of every event, read from the payload sizes event at the start of the replay.
+    // Kept per game so several replays can be parsed on different threads at once
+    std::unordered_map<uint8_t, uint32_t> asmEvents = {
+      { EVENT_GAME_INIT, 320 },
+      { EVENT_PRE_FRAME_UPDATE, 58 },
+      { EVENT_POST_FRAME_UPDATE, 33 },
+      { EVENT_GAME_END, 1 },
+      { EVENT_FRAME_START, 8 }
+    };
     std::vector<uint8_t> splitMessageBuf;
     bool shouldResetSplitMessageBuf = false;
 
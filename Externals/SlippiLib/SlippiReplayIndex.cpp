@@ -0,0 +1,570 @@
+#include <algorithm>
+#include <atomic>
+#include <codecvt>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <locale>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "SlippiGame.h"
+#include "SlippiReplayIndex.h"
+
+namespace Slippi {
+  static const uint32_t COLUMN_ELEMENT_SIZES[COLUMN_COUNT] = {
+    8, 4, 8, 8, 2, 4, 4, 1, 8, 4, // Game columns
+    4, 4, 16, // Frame columns
+    1, // Paths
+  };
+
+  static const char* const FRAME_COLUMN_SUFFIXES[] = { ".frames", ".stocks", ".percent" };
+
+  // Everything the index keeps about one game
+  typedef struct {
+    std::string path;
+    uint64_t fileSize = 0;
+    int64_t fileTime = 0;
+    uint16_t stage = 0;
+    std::array<uint8_t, 4> characters;
+    int32_t lastFrame = 0;
+    uint8_t gameEndMethod = 0;
+    std::vector<int32_t> frames;
+    std::vector<std::array<uint8_t, 4>> stocks;
+    std::vector<std::array<float, 4>> percents;
+  } GameSummary;
+
+#ifdef _WIN32
+  static std::wstring toWidePath(const std::string& path) {
+    return std::wstring_convert<std::codecvt_utf8<wchar_t>>().from_bytes(path);
+  }
+#endif
+
+  static bool getFileStamp(const std::string& path, uint64_t& size, int64_t& time) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_wstat64(toWidePath(path).c_str(), &st) != 0) {
+      return false;
+    }
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+      return false;
+    }
+#endif
+
+    size = (uint64_t)st.st_size;
+    time = (int64_t)st.st_mtime;
+    return true;
+  }
+
+  static bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExW(toWidePath(from).c_str(), toWidePath(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+  }
+
+  template <typename Stream>
+  static void openStream(Stream& stream, const std::string& path, std::ios::openmode mode) {
+#ifdef _WIN32
+    stream.open(toWidePath(path), mode | std::ios::binary);
+#else
+    stream.open(path, mode | std::ios::binary);
+#endif
+  }
+
+  static bool summarizeGame(GameSummary& summary) {
+    auto game = SlippiGame::FromFile(summary.path);
+    if (!game || !game->AreSettingsLoaded()) {
+      return false;
+    }
+
+    GameSettings* settings = game->GetSettings();
+    summary.stage = settings->stage;
+    summary.characters.fill(INDEX_NO_CHARACTER);
+    for (auto& player : settings->players) {
+      if (player.first < 4) {
+        summary.characters[player.first] = player.second.characterId;
+      }
+    }
+
+    summary.lastFrame = game->GetLatestIndex();
+    summary.gameEndMethod = game->getGameEndMethod();
+
+    for (int32_t i = GAME_FIRST_FRAME; i <= summary.lastFrame; i++) {
+      FrameData* frame = game->GetFrame(i);
+      if (!frame) {
+        continue;
+      }
+
+      std::array<uint8_t, 4> stocks;
+      std::array<float, 4> percents;
+      for (uint8_t port = 0; port < 4; port++) {
+        bool isPresent = frame->HasPlayer(port, false);
+        stocks[port] = isPresent ? frame->players[port].stocks : INDEX_NO_STOCKS;
+        percents[port] = isPresent ? frame->players[port].percent : 0;
+      }
+
+      summary.frames.push_back(i);
+      summary.stocks.push_back(stocks);
+      summary.percents.push_back(percents);
+    }
+
+    return true;
+  }
+
+  static void copyGame(SlippiReplayIndex& index, uint32_t game, GameSummary& summary) {
+    IndexedGameInfo info = index.GetGame(game);
+    summary.stage = info.stage;
+    summary.characters = info.characters;
+    summary.lastFrame = info.lastFrame;
+    summary.gameEndMethod = info.gameEndMethod;
+
+    uint64_t start = index.GetColumn<uint64_t>(COLUMN_GAME_FRAME_START)[game];
+    const int32_t* frames = index.GetColumn<int32_t>(COLUMN_FRAME_NUMBER) + start;
+    const std::array<uint8_t, 4>* stocks = index.GetColumn<std::array<uint8_t, 4>>(COLUMN_FRAME_STOCKS) + start;
+    const std::array<float, 4>* percents = index.GetColumn<std::array<float, 4>>(COLUMN_FRAME_PERCENT) + start;
+    summary.frames.assign(frames, frames + info.frameCount);
+    summary.stocks.assign(stocks, stocks + info.frameCount);
+    summary.percents.assign(percents, percents + info.frameCount);
+  }
+
+  // Collects the columns of an index while games finish. The per game columns are small and stay in
+  // memory, frame columns go to a temporary file each so a big folder doesn't have to fit in memory
+  class IndexWriter {
+  public:
+    IndexWriter(const std::string& indexPath) : path(indexPath) {
+      for (int i = 0; i < 3; i++) {
+        openStream(frameStreams[i], path + FRAME_COLUMN_SUFFIXES[i], std::ios::out | std::ios::trunc);
+      }
+    }
+
+    ~IndexWriter() {
+      for (int i = 0; i < 3; i++) {
+        frameStreams[i].close();
+        remove((path + FRAME_COLUMN_SUFFIXES[i]).c_str());
+      }
+    }
+
+    void Add(const GameSummary& summary) {
+      std::lock_guard<std::mutex> lk(mutex);
+
+      gamePathOffsets.push_back(paths.size());
+      gamePathLengths.push_back((uint32_t)summary.path.size());
+      paths.insert(paths.end(), summary.path.begin(), summary.path.end());
+      gameFileSizes.push_back(summary.fileSize);
+      gameFileTimes.push_back(summary.fileTime);
+      gameStages.push_back(summary.stage);
+      gameCharacters.push_back(summary.characters);
+      gameLastFrames.push_back(summary.lastFrame);
+      gameEndMethods.push_back(summary.gameEndMethod);
+      gameFrameStarts.push_back(frameCount);
+      gameFrameCounts.push_back((uint32_t)summary.frames.size());
+
+      size_t rows = summary.frames.size();
+      frameStreams[0].write((const char*)summary.frames.data(), rows * sizeof(int32_t));
+      frameStreams[1].write((const char*)summary.stocks.data(), rows * sizeof(std::array<uint8_t, 4>));
+      frameStreams[2].write((const char*)summary.percents.data(), rows * sizeof(std::array<float, 4>));
+      frameCount += rows;
+    }
+
+    uint64_t GetFrameCount() {
+      return frameCount;
+    }
+
+    // Writes the finished index to outputPath, returns its size or 0 on failure
+    uint64_t Finish(const std::string& outputPath) {
+      std::lock_guard<std::mutex> lk(mutex);
+
+      typedef struct {
+        const void* data;
+        uint64_t count;
+      } MemoryColumn;
+
+      std::array<MemoryColumn, COLUMN_COUNT> memoryColumns = { {
+        { gamePathOffsets.data(), gamePathOffsets.size() },
+        { gamePathLengths.data(), gamePathLengths.size() },
+        { gameFileSizes.data(), gameFileSizes.size() },
+        { gameFileTimes.data(), gameFileTimes.size() },
+        { gameStages.data(), gameStages.size() },
+        { gameCharacters.data(), gameCharacters.size() },
+        { gameLastFrames.data(), gameLastFrames.size() },
+        { gameEndMethods.data(), gameEndMethods.size() },
+        { gameFrameStarts.data(), gameFrameStarts.size() },
+        { gameFrameCounts.data(), gameFrameCounts.size() },
+        { nullptr, frameCount },
+        { nullptr, frameCount },
+        { nullptr, frameCount },
+        { paths.data(), paths.size() },
+      } };
+
+      for (int i = 0; i < 3; i++) {
+        frameStreams[i].close();
+      }
+
+      std::ofstream output;
+      openStream(output, outputPath, std::ios::out | std::ios::trunc);
+      if (!output.is_open()) {
+        return 0;
+      }
+
+      uint32_t header[3] = { INDEX_VERSION, INDEX_BYTE_ORDER_MARK, COLUMN_COUNT };
+      output.write((const char*)INDEX_MAGIC, 4);
+      output.write((const char*)header, sizeof(header));
+
+      uint64_t offset = INDEX_HEADER_SIZE + (uint64_t)COLUMN_COUNT * INDEX_COLUMN_ENTRY_SIZE;
+      for (uint32_t i = 0; i < COLUMN_COUNT; i++) {
+        offset = (offset + 7) & ~7ULL;
+        uint32_t ids[2] = { i, COLUMN_ELEMENT_SIZES[i] };
+        uint64_t placement[2] = { memoryColumns[i].count, offset };
+        output.write((const char*)ids, sizeof(ids));
+        output.write((const char*)placement, sizeof(placement));
+        offset += memoryColumns[i].count * COLUMN_ELEMENT_SIZES[i];
+      }
+
+      uint64_t written = INDEX_HEADER_SIZE + (uint64_t)COLUMN_COUNT * INDEX_COLUMN_ENTRY_SIZE;
+      std::vector<char> buffer(1024 * 1024);
+      for (uint32_t i = 0; i < COLUMN_COUNT; i++) {
+        static const char padding[8] = {};
+        uint64_t aligned = (written + 7) & ~7ULL;
+        output.write(padding, aligned - written);
+        written = aligned;
+
+        uint64_t size = memoryColumns[i].count * COLUMN_ELEMENT_SIZES[i];
+        if (memoryColumns[i].data) {
+          output.write((const char*)memoryColumns[i].data, size);
+        }
+        else {
+          std::ifstream input;
+          openStream(input, path + FRAME_COLUMN_SUFFIXES[i - COLUMN_FRAME_NUMBER], std::ios::in);
+          uint64_t remaining = size;
+          while (remaining && input.read(buffer.data(), std::min<uint64_t>(remaining, buffer.size()))) {
+            output.write(buffer.data(), input.gcount());
+            remaining -= input.gcount();
+          }
+
+          if (remaining) {
+            return 0;
+          }
+        }
+
+        written += size;
+      }
+
+      output.close();
+      return output.good() ? written : 0;
+    }
+
+  private:
+    std::string path;
+    std::mutex mutex;
+
+    std::vector<uint64_t> gamePathOffsets;
+    std::vector<uint32_t> gamePathLengths;
+    std::vector<uint64_t> gameFileSizes;
+    std::vector<int64_t> gameFileTimes;
+    std::vector<uint16_t> gameStages;
+    std::vector<std::array<uint8_t, 4>> gameCharacters;
+    std::vector<int32_t> gameLastFrames;
+    std::vector<uint8_t> gameEndMethods;
+    std::vector<uint64_t> gameFrameStarts;
+    std::vector<uint32_t> gameFrameCounts;
+    std::vector<char> paths;
+
+    std::ofstream frameStreams[3];
+    uint64_t frameCount = 0;
+  };
+
+  std::unique_ptr<SlippiReplayIndex> SlippiReplayIndex::Open(std::string path) {
+    auto result = std::make_unique<SlippiReplayIndex>();
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(toWidePath(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+      return nullptr;
+    }
+
+    result->fileHandle = handle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart < INDEX_HEADER_SIZE) {
+      return nullptr;
+    }
+
+    result->mappingHandle = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!result->mappingHandle) {
+      return nullptr;
+    }
+
+    result->mappedData = (uint8_t*)MapViewOfFile((HANDLE)result->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    result->mappedSize = (size_t)fileSize.QuadPart;
+#else
+    result->fileDescriptor = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (result->fileDescriptor < 0 || fstat(result->fileDescriptor, &st) != 0 || st.st_size < INDEX_HEADER_SIZE) {
+      return nullptr;
+    }
+
+    void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, result->fileDescriptor, 0);
+    if (ptr == MAP_FAILED) {
+      return nullptr;
+    }
+
+    result->mappedData = (uint8_t*)ptr;
+    result->mappedSize = (size_t)st.st_size;
+#endif
+
+    if (!result->mappedData || !result->readDirectory()) {
+      return nullptr;
+    }
+
+    return result;
+  }
+
+  SlippiReplayIndex::~SlippiReplayIndex() {
+#ifdef _WIN32
+    if (mappedData) {
+      UnmapViewOfFile(mappedData);
+    }
+    if (mappingHandle) {
+      CloseHandle((HANDLE)mappingHandle);
+    }
+    if (fileHandle) {
+      CloseHandle((HANDLE)fileHandle);
+    }
+#else
+    if (mappedData) {
+      munmap(mappedData, mappedSize);
+    }
+    if (fileDescriptor >= 0) {
+      close(fileDescriptor);
+    }
+#endif
+  }
+
+  bool SlippiReplayIndex::readDirectory() {
+    uint32_t header[3];
+    memcpy(header, &mappedData[4], sizeof(header));
+    if (memcmp(mappedData, INDEX_MAGIC, 4) != 0 || header[0] != INDEX_VERSION || header[1] != INDEX_BYTE_ORDER_MARK) {
+      return false;
+    }
+
+    uint32_t columnCount = header[2];
+    if (INDEX_HEADER_SIZE + (uint64_t)columnCount * INDEX_COLUMN_ENTRY_SIZE > mappedSize) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < columnCount; i++) {
+      const uint8_t* entry = &mappedData[INDEX_HEADER_SIZE + i * INDEX_COLUMN_ENTRY_SIZE];
+      uint32_t ids[2];
+      ColumnEntry column;
+      memcpy(ids, entry, sizeof(ids));
+      memcpy(&column.count, &entry[8], 8);
+      memcpy(&column.offset, &entry[16], 8);
+      column.elementSize = ids[1];
+
+      // Columns this version doesn't know about are skipped
+      if (ids[0] >= COLUMN_COUNT) {
+        continue;
+      }
+
+      if (column.elementSize != COLUMN_ELEMENT_SIZES[ids[0]] || column.offset % 8 != 0 ||
+          column.offset > mappedSize || column.count > (mappedSize - column.offset) / column.elementSize) {
+        return false;
+      }
+
+      columns[ids[0]] = column;
+    }
+
+    // All game columns have to cover every game and the frame ranges have to be in the frame columns
+    gameCount = (uint32_t)columns[COLUMN_GAME_PATH_OFFSET].count;
+    for (uint32_t i = COLUMN_GAME_PATH_OFFSET; i <= COLUMN_GAME_FRAME_COUNT; i++) {
+      if (columns[i].count != gameCount) {
+        return false;
+      }
+    }
+
+    uint64_t frameRows = columns[COLUMN_FRAME_NUMBER].count;
+    if (columns[COLUMN_FRAME_STOCKS].count != frameRows || columns[COLUMN_FRAME_PERCENT].count != frameRows) {
+      return false;
+    }
+
+    const uint64_t* pathOffsets = GetColumn<uint64_t>(COLUMN_GAME_PATH_OFFSET);
+    const uint32_t* pathLengths = GetColumn<uint32_t>(COLUMN_GAME_PATH_LENGTH);
+    const uint64_t* frameStarts = GetColumn<uint64_t>(COLUMN_GAME_FRAME_START);
+    const uint32_t* frameCounts = GetColumn<uint32_t>(COLUMN_GAME_FRAME_COUNT);
+    for (uint32_t i = 0; i < gameCount; i++) {
+      if (pathOffsets[i] + pathLengths[i] > columns[COLUMN_PATHS].count || frameStarts[i] + frameCounts[i] > frameRows) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  const void* SlippiReplayIndex::getColumn(IndexColumn column, uint32_t elementSize, uint64_t* count) {
+    if (column >= COLUMN_COUNT || columns[column].elementSize != elementSize) {
+      return nullptr;
+    }
+
+    if (count) {
+      *count = columns[column].count;
+    }
+
+    return &mappedData[columns[column].offset];
+  }
+
+  uint32_t SlippiReplayIndex::GetGameCount() {
+    return gameCount;
+  }
+
+  IndexedGameInfo SlippiReplayIndex::GetGame(uint32_t game) {
+    IndexedGameInfo info;
+    const char* paths = GetColumn<char>(COLUMN_PATHS);
+    info.path.assign(paths + GetColumn<uint64_t>(COLUMN_GAME_PATH_OFFSET)[game],
+                     GetColumn<uint32_t>(COLUMN_GAME_PATH_LENGTH)[game]);
+    info.stage = GetColumn<uint16_t>(COLUMN_GAME_STAGE)[game];
+    info.characters = GetColumn<std::array<uint8_t, 4>>(COLUMN_GAME_CHARACTERS)[game];
+    info.lastFrame = GetColumn<int32_t>(COLUMN_GAME_LAST_FRAME)[game];
+    info.gameEndMethod = GetColumn<uint8_t>(COLUMN_GAME_END_METHOD)[game];
+    info.frameCount = GetColumn<uint32_t>(COLUMN_GAME_FRAME_COUNT)[game];
+    return info;
+  }
+
+  std::vector<uint32_t> SlippiReplayIndex::FindGames(int characterId, int stage) {
+    std::vector<uint32_t> result;
+    const uint16_t* stages = GetColumn<uint16_t>(COLUMN_GAME_STAGE);
+    const std::array<uint8_t, 4>* characters = GetColumn<std::array<uint8_t, 4>>(COLUMN_GAME_CHARACTERS);
+
+    for (uint32_t i = 0; i < gameCount; i++) {
+      if (stage >= 0 && stages[i] != stage) {
+        continue;
+      }
+
+      bool isMatch = characterId < 0;
+      for (int port = 0; port < 4 && !isMatch; port++) {
+        isMatch = characters[i][port] == characterId;
+      }
+
+      if (isMatch) {
+        result.push_back(i);
+      }
+    }
+
+    return result;
+  }
+
+  std::vector<StockChange> SlippiReplayIndex::FindStockChanges(uint32_t game) {
+    std::vector<StockChange> result;
+    if (game >= gameCount) {
+      return result;
+    }
+
+    uint64_t start = GetColumn<uint64_t>(COLUMN_GAME_FRAME_START)[game];
+    uint32_t count = GetColumn<uint32_t>(COLUMN_GAME_FRAME_COUNT)[game];
+    const int32_t* frames = GetColumn<int32_t>(COLUMN_FRAME_NUMBER) + start;
+    const std::array<uint8_t, 4>* stocks = GetColumn<std::array<uint8_t, 4>>(COLUMN_FRAME_STOCKS) + start;
+
+    for (uint32_t i = 1; i < count; i++) {
+      for (uint8_t port = 0; port < 4; port++) {
+        uint8_t previous = stocks[i - 1][port];
+        uint8_t current = stocks[i][port];
+        if (current != previous && current != INDEX_NO_STOCKS && previous != INDEX_NO_STOCKS) {
+          result.push_back({ frames[i], port, current });
+        }
+      }
+    }
+
+    return result;
+  }
+
+  bool SlippiReplayIndex::Update(std::string indexPath, const std::vector<std::string>& replayPaths, int threadCount,
+                                 IndexUpdateStats* stats) {
+    // Games of the previous index by path so unchanged ones don't need to be parsed again
+    auto previous = Open(indexPath);
+    std::unordered_map<std::string, uint32_t> previousGames;
+    if (previous) {
+      for (uint32_t i = 0; i < previous->GetGameCount(); i++) {
+        previousGames[previous->GetGame(i).path] = i;
+      }
+    }
+
+    std::string tempPath = indexPath + ".tmp";
+    IndexWriter writer(tempPath);
+
+    std::atomic<size_t> nextReplay(0);
+    std::atomic<uint32_t> parsedGames(0);
+    std::atomic<uint32_t> failedGames(0);
+    auto indexWorker = [&]() {
+      for (size_t i = nextReplay++; i < replayPaths.size(); i = nextReplay++) {
+        GameSummary summary;
+        summary.path = replayPaths[i];
+        if (!getFileStamp(summary.path, summary.fileSize, summary.fileTime)) {
+          failedGames++;
+          continue;
+        }
+
+        auto it = previousGames.find(summary.path);
+        if (it != previousGames.end() && previous->GetColumn<uint64_t>(COLUMN_GAME_FILE_SIZE)[it->second] == summary.fileSize &&
+            previous->GetColumn<int64_t>(COLUMN_GAME_FILE_TIME)[it->second] == summary.fileTime) {
+          copyGame(*previous, it->second, summary);
+        }
+        else if (summarizeGame(summary)) {
+          parsedGames++;
+        }
+        else {
+          failedGames++;
+          continue;
+        }
+
+        writer.Add(summary);
+      }
+    };
+
+    if (threadCount <= 0) {
+      threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threadCount; i++) {
+      workers.emplace_back(indexWorker);
+    }
+    indexWorker();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+
+    uint64_t indexBytes = writer.Finish(tempPath);
+    uint64_t frameCount = writer.GetFrameCount();
+
+    // Windows won't replace a file that is still mapped
+    previous.reset();
+    if (!indexBytes || !replaceFile(tempPath, indexPath)) {
+      remove(tempPath.c_str());
+      return false;
+    }
+
+    if (stats) {
+      stats->games = (uint32_t)(replayPaths.size() - failedGames);
+      stats->parsedGames = parsedGames;
+      stats->failedGames = failedGames;
+      stats->frames = frameCount;
+      stats->indexBytes = indexBytes;
+    }
+
+    return true;
+  }
+}
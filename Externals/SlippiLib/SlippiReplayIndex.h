@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Slippi {
+  // An index file holds a summary of many replays so they can be searched without being parsed. It is
+  // columnar: every field is one contiguous array over all games (or all frames of all games) that is
+  // used straight from a memory mapping. The file starts with INDEX_MAGIC, the version, the column
+  // count and a directory of (column id, element size, element count, file offset) entries. Columns
+  // are 8 byte aligned and in the byte order of the machine that wrote them (little endian in
+  // practice), a file from a machine with a different byte order is rejected
+  const uint8_t INDEX_MAGIC[4] = { 'S', 'L', 'P', 'X' };
+  const uint32_t INDEX_VERSION = 1;
+  const uint32_t INDEX_BYTE_ORDER_MARK = 0x01020304;
+  const uint32_t INDEX_HEADER_SIZE = 16;
+  const uint32_t INDEX_COLUMN_ENTRY_SIZE = 24;
+
+  // Port values in the character and stock columns for ports nobody played on
+  const uint8_t INDEX_NO_CHARACTER = 0xFF;
+  const uint8_t INDEX_NO_STOCKS = 0xFF;
+
+  enum IndexColumn : uint32_t {
+    // One entry per game
+    COLUMN_GAME_PATH_OFFSET, // uint64_t, into COLUMN_PATHS
+    COLUMN_GAME_PATH_LENGTH, // uint32_t
+    COLUMN_GAME_FILE_SIZE, // uint64_t
+    COLUMN_GAME_FILE_TIME, // int64_t, modification time, compared with the size to spot changed files
+    COLUMN_GAME_STAGE, // uint16_t
+    COLUMN_GAME_CHARACTERS, // uint8_t[4], external character id by port
+    COLUMN_GAME_LAST_FRAME, // int32_t
+    COLUMN_GAME_END_METHOD, // uint8_t
+    COLUMN_GAME_FRAME_START, // uint64_t, first row of the game in the frame columns
+    COLUMN_GAME_FRAME_COUNT, // uint32_t
+
+    // One entry per frame of every game, in frame order. Values are those of the last copy of a frame
+    // in case of rollbacks
+    COLUMN_FRAME_NUMBER, // int32_t
+    COLUMN_FRAME_STOCKS, // uint8_t[4]
+    COLUMN_FRAME_PERCENT, // float[4]
+
+    COLUMN_PATHS, // char
+
+    COLUMN_COUNT,
+  };
+
+  typedef struct {
+    std::string path;
+    uint16_t stage;
+    std::array<uint8_t, 4> characters;
+    int32_t lastFrame;
+    uint8_t gameEndMethod;
+    uint32_t frameCount;
+  } IndexedGameInfo;
+
+  typedef struct {
+    int32_t frame;
+    uint8_t port;
+    uint8_t stocks;
+  } StockChange;
+
+  typedef struct {
+    uint32_t games = 0;
+    // Games that had to be parsed, the rest were carried over from the previous index
+    uint32_t parsedGames = 0;
+    uint32_t failedGames = 0;
+    uint64_t frames = 0;
+    uint64_t indexBytes = 0;
+  } IndexUpdateStats;
+
+  class SlippiReplayIndex
+  {
+  public:
+    // Maps an index file, nullptr if it doesn't exist or isn't a valid index
+    static std::unique_ptr<SlippiReplayIndex> Open(std::string path);
+
+    // Writes an index over replayPaths to indexPath. Games that are already in the index at indexPath
+    // with the same size and modification time are copied over from it, the rest are parsed on
+    // threadCount threads (0 for one per core). The new index replaces the old one in one rename so
+    // readers never see half of it
+    static bool Update(std::string indexPath, const std::vector<std::string>& replayPaths, int threadCount,
+                       IndexUpdateStats* stats = nullptr);
+
+    ~SlippiReplayIndex();
+
+    uint32_t GetGameCount();
+    IndexedGameInfo GetGame(uint32_t game);
+
+    // Games where someone played characterId on stage, -1 for either matches anything
+    std::vector<uint32_t> FindGames(int characterId, int stage);
+
+    // Every frame of a game on which a player's stock count differs from the frame before
+    std::vector<StockChange> FindStockChanges(uint32_t game);
+
+    // Raw access to a column, nullptr if the column is missing or its elements aren't sizeof(T) bytes
+    template <typename T>
+    const T* GetColumn(IndexColumn column, uint64_t* count = nullptr) {
+      return (const T*)getColumn(column, sizeof(T), count);
+    }
+
+  private:
+    typedef struct {
+      uint32_t elementSize;
+      uint64_t count;
+      uint64_t offset;
+    } ColumnEntry;
+
+    const void* getColumn(IndexColumn column, uint32_t elementSize, uint64_t* count);
+    bool readDirectory();
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+    uint8_t* mappedData = nullptr;
+    size_t mappedSize = 0;
+
+    std::array<ColumnEntry, COLUMN_COUNT> columns = {};
+    uint32_t gameCount = 0;
+  };
+}
@@ -0,0 +1,300 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// Times CoreTiming::EventQueue against the queues it was chosen over: the heap CoreTiming used
+// before, which rebuilds itself on every removal, and a radix heap. The radix heap only pulls ahead
+// well past the 8 to 30 events a GameCube session keeps pending, run this again before changing the
+// queue.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <getopt.h>
+#include <random>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/MathUtil.h"
+#include "Core/CoreTimingQueue.h"
+
+using CoreTiming::Event;
+using CoreTiming::EventType;
+
+static constexpr s64 MAX_SLICE_LENGTH = 20000;  // Copied from CoreTiming internals
+
+// The heap CoreTiming used before EventQueue
+class HeapQueue
+{
+public:
+	void Push(const Event& event)
+	{
+		m_heap.push_back(event);
+		std::push_heap(m_heap.begin(), m_heap.end(), std::greater<Event>());
+	}
+	const Event& Top() const { return m_heap.front(); }
+	Event Pop()
+	{
+		std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<Event>());
+		Event event = m_heap.back();
+		m_heap.pop_back();
+		return event;
+	}
+	bool Empty() const { return m_heap.empty(); }
+	void Remove(EventType* event_type)
+	{
+		auto itr = std::remove_if(m_heap.begin(), m_heap.end(),
+		                          [&](const Event& e) { return e.type == event_type; });
+		if (itr != m_heap.end())
+		{
+			m_heap.erase(itr, m_heap.end());
+			std::make_heap(m_heap.begin(), m_heap.end(), std::greater<Event>());
+		}
+	}
+
+private:
+	std::vector<Event> m_heap;
+};
+
+// Radix heap keyed on event time. Bucket 0 holds the events at the time of the last pop and bucket i
+// the events whose time differs from it first in bit i-1. Events scheduled before the last pop can't
+// be bucketed and wait in a small binary heap that pops first.
+class RadixQueue
+{
+public:
+	void Push(const Event& event)
+	{
+		const u64 key = GetKey(event.time);
+		if (key < m_last)
+		{
+			m_overdue.push_back(event);
+			std::push_heap(m_overdue.begin(), m_overdue.end(), std::greater<Event>());
+		}
+		else
+		{
+			AddToBucket(event, key);
+		}
+
+		m_size++;
+		if (m_has_top && event < m_top)
+			m_top = event;
+	}
+
+	const Event& Top()
+	{
+		if (!m_has_top)
+		{
+			m_top = !m_overdue.empty() ? m_overdue.front() : *FindEarliest(m_buckets[GetLowestBucket()]);
+			m_has_top = true;
+		}
+		return m_top;
+	}
+
+	Event Pop()
+	{
+		m_size--;
+
+		if (!m_overdue.empty())
+		{
+			m_has_top = false;
+			std::pop_heap(m_overdue.begin(), m_overdue.end(), std::greater<Event>());
+			Event event = m_overdue.back();
+			m_overdue.pop_back();
+			return event;
+		}
+
+		const size_t lowest = GetLowestBucket();
+		if (lowest != 0)
+		{
+			m_last = GetKey(m_has_top ? m_top.time : FindEarliest(m_buckets[lowest])->time);
+			m_used_buckets &= ~(1ULL << (lowest - 1));
+			// Every event lands in a lower bucket, so this one can be walked while they are added
+			for (const Event& event : m_buckets[lowest])
+				AddToBucket(event, GetKey(event.time));
+			m_buckets[lowest].clear();
+		}
+		m_has_top = false;
+
+		std::vector<Event>& bucket = m_buckets[0];
+		auto earliest = FindEarliest(bucket);
+		Event event = *earliest;
+		*earliest = bucket.back();
+		bucket.pop_back();
+		return event;
+	}
+
+	bool Empty() const { return m_size == 0; }
+
+	void Remove(EventType* event_type)
+	{
+		auto is_type = [&](const Event& e) { return e.type == event_type; };
+
+		size_t removed = 0;
+		for (size_t i = 0; i < m_buckets.size(); i++)
+		{
+			std::vector<Event>& bucket = m_buckets[i];
+			auto itr = std::remove_if(bucket.begin(), bucket.end(), is_type);
+			removed += bucket.end() - itr;
+			bucket.erase(itr, bucket.end());
+			if (i && bucket.empty())
+				m_used_buckets &= ~(1ULL << (i - 1));
+		}
+
+		auto itr = std::remove_if(m_overdue.begin(), m_overdue.end(), is_type);
+		if (itr != m_overdue.end())
+		{
+			removed += m_overdue.end() - itr;
+			m_overdue.erase(itr, m_overdue.end());
+			std::make_heap(m_overdue.begin(), m_overdue.end(), std::greater<Event>());
+		}
+
+		m_size -= removed;
+		if (removed)
+			m_has_top = false;
+	}
+
+private:
+	// Flips the sign bit so negative times order before positive ones as unsigned keys
+	static u64 GetKey(s64 time) { return static_cast<u64>(time) ^ (1ULL << 63); }
+
+	static std::vector<Event>::iterator FindEarliest(std::vector<Event>& bucket)
+	{
+		return std::min_element(bucket.begin(), bucket.end());
+	}
+
+	void AddToBucket(const Event& event, u64 key)
+	{
+		const size_t bucket = key == m_last ? 0 : 1 + IntLog2(key ^ m_last);
+		m_buckets[bucket].push_back(event);
+		if (bucket)
+			m_used_buckets |= 1ULL << (bucket - 1);
+	}
+
+	size_t GetLowestBucket() const
+	{
+		if (!m_buckets[0].empty())
+			return 0;
+		return 1 + IntLog2(m_used_buckets & (~m_used_buckets + 1));
+	}
+
+	std::array<std::vector<Event>, 65> m_buckets;
+	// Bit i is set while bucket i + 1 has events
+	u64 m_used_buckets = 0;
+	std::vector<Event> m_overdue;
+	u64 m_last = 0;
+	size_t m_size = 0;
+	Event m_top;
+	bool m_has_top = false;
+};
+
+static EventType* FakeType(u32 index)
+{
+	return reinterpret_cast<EventType*>(static_cast<uintptr_t>(index + 1) * 64);
+}
+
+// The pattern Advance() sees, the same as in CoreTimingTest: slices of up to MAX_SLICE_LENGTH cycles,
+// every due event popped and most of them rescheduled a period later. Returns a checksum of the pop
+// order
+template <typename Queue>
+static u64 RunWorkload(Queue& queue, u32 seed, int slices, int types)
+{
+	std::minstd_rand rng(seed);
+	s64 now = 0;
+	u64 fifo = 0;
+	u64 checksum = 0;
+
+	for (int i = 0; i < types; i++)
+		queue.Push(Event{static_cast<s64>(rng() % MAX_SLICE_LENGTH), fifo++, 0, FakeType(i)});
+
+	for (int slice = 0; slice < slices; slice++)
+	{
+		while (!queue.Empty() && queue.Top().time <= now)
+		{
+			Event event = queue.Pop();
+			checksum = checksum * 31 + event.fifo_order;
+
+			// Mostly periodic events, some share a time, a few get scheduled into the past
+			const u32 roll = rng() % 64;
+			s64 period = static_cast<s64>(rng() % (4 * MAX_SLICE_LENGTH));
+			if (roll == 0)
+				period = -static_cast<s64>(rng() % 1000);
+			else if (roll < 8)
+				period = 1000;
+			event.time = now + period - (now - event.time);
+			event.fifo_order = fifo++;
+			queue.Push(event);
+		}
+
+		if (rng() % 256 == 0)
+		{
+			const u32 type = rng() % types;
+			queue.Remove(FakeType(type));
+			queue.Push(Event{now + 100, fifo++, 0, FakeType(type)});
+		}
+
+		now += queue.Empty() ? MAX_SLICE_LENGTH :
+		                       std::min(std::max<s64>(queue.Top().time - now, 1), MAX_SLICE_LENGTH);
+	}
+
+	return checksum;
+}
+
+template <typename Queue>
+static double TimeWorkload(int slices, int types, u64* checksum)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	Queue queue;
+	const Clock::time_point start = Clock::now();
+	*checksum = RunWorkload(queue, 1, slices, types);
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	int slices = 200000;
+	struct option longopts[] = {{"slices", required_argument, nullptr, 's'},
+	                            {"help", no_argument, nullptr, 'h'},
+	                            {nullptr, 0, nullptr, 0}};
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "s:h?", longopts, nullptr)) != -1)
+	{
+		switch (ch)
+		{
+		case 's':
+			slices = std::max(1, atoi(optarg));
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+			fprintf(stderr, "Time CoreTiming's event queue against a rebuilding heap and a radix heap\n\n");
+			fprintf(stderr, "  -s, --slices <count>  Slices to run per queue (default: 200000)\n");
+			return 1;
+		}
+	}
+
+	int result = 0;
+	for (int types : {8, 16, 32, 64, 128})
+	{
+		u64 heap_checksum, radix_checksum, queue_checksum;
+		const double heap_ms = TimeWorkload<HeapQueue>(slices, types, &heap_checksum);
+		const double radix_ms = TimeWorkload<RadixQueue>(slices, types, &radix_checksum);
+		const double queue_ms = TimeWorkload<CoreTiming::EventQueue>(slices, types, &queue_checksum);
+
+		// Every queue has to pop in the same order for the times to mean anything
+		if (radix_checksum != heap_checksum || queue_checksum != heap_checksum)
+		{
+			fprintf(stderr, "%d pending events: pop order differs between the queues\n", types);
+			result = 1;
+		}
+
+		printf("%3d pending events: heap %8.2f ms, radix heap %8.2f ms, event queue %8.2f ms\n", types,
+		       heap_ms, radix_ms, queue_ms);
+	}
+
+	return result;
+}
@@ -0,0 +1,365 @@
+#include "SlippiReplayIndexBench.h"
+
+#include <SlippiLib/SlippiGame.h>
+#include <SlippiLib/SlippiReplayIndex.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <random>
+
+#include "Common/FileSearch.h"
+#include "Common/FileUtil.h"
+#include "Common/StringUtil.h"
+#include "Common/Timer.h"
+
+#define REPLAY_RAW_MARKER "{U\x03raw[$U#l"
+#define EVENT_PAYLOAD_SIZES 0x35
+#define EVENT_GAME_INIT 0x36
+#define EVENT_PRE_FRAME_UPDATE 0x37
+#define EVENT_POST_FRAME_UPDATE 0x38
+#define EVENT_GAME_END 0x39
+#define EVENT_FRAME_START 0x3A
+#define EVENT_FRAME_END 0x3C
+
+// Payload sizes of a 3.7.0 replay, without the command byte
+#define GAME_INIT_SIZE 584
+#define PRE_FRAME_UPDATE_SIZE 63
+#define POST_FRAME_UPDATE_SIZE 33
+#define GAME_END_SIZE 2
+#define FRAME_START_SIZE 8
+#define FRAME_END_SIZE 8
+
+// What the queries look for: Fox on Battlefield
+#define QUERY_CHARACTER 2
+#define QUERY_STAGE 31
+
+static const u8 corpusCharacters[] = {2, 20, 9, 15, 0, 19};
+static const u16 corpusStages[] = {2, 3, 8, 28, 31, 32};
+
+static void appendBE16(std::string &buf, u16 value)
+{
+	buf += (char)(value >> 8);
+	buf += (char)value;
+}
+
+static void appendBE32(std::string &buf, u32 value)
+{
+	appendBE16(buf, value >> 16);
+	appendBE16(buf, value & 0xFFFF);
+}
+
+static void appendFloat(std::string &buf, float value)
+{
+	u32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	appendBE32(buf, bits);
+}
+
+// A two player singles game where stocks are lost at random and percent climbs in between
+static std::string makeReplay(std::mt19937 &rng, int frames)
+{
+	std::string raw;
+	raw += (char)EVENT_PAYLOAD_SIZES;
+	raw += (char)(1 + 6 * 3);
+	u16 sizes[][2] = {{EVENT_GAME_INIT, GAME_INIT_SIZE},
+	                  {EVENT_PRE_FRAME_UPDATE, PRE_FRAME_UPDATE_SIZE},
+	                  {EVENT_POST_FRAME_UPDATE, POST_FRAME_UPDATE_SIZE},
+	                  {EVENT_GAME_END, GAME_END_SIZE},
+	                  {EVENT_FRAME_START, FRAME_START_SIZE},
+	                  {EVENT_FRAME_END, FRAME_END_SIZE}};
+	for (auto &size : sizes)
+	{
+		raw += (char)size[0];
+		appendBE16(raw, size[1]);
+	}
+
+	u8 characters[2] = {corpusCharacters[rng() % sizeof(corpusCharacters)],
+	                    corpusCharacters[rng() % sizeof(corpusCharacters)]};
+	u16 stage = corpusStages[rng() % (sizeof(corpusStages) / sizeof(corpusStages[0]))];
+
+	// Version, then the game info block where word 3 has the stage and every player has 9 words from word 24
+	std::string gameInit(GAME_INIT_SIZE, '\0');
+	gameInit[0] = 3;
+	gameInit[1] = 7;
+	for (int port = 0; port < 4; port++)
+	{
+		u32 playerInfo = port < 2 ? (u32)characters[port] << 24 : 3 << 16;
+		for (int i = 0; i < 4; i++)
+			gameInit[4 + (24 + 9 * port) * 4 + i] = (char)(playerInfo >> (24 - 8 * i));
+	}
+	gameInit[4 + 3 * 4 + 2] = (char)(stage >> 8);
+	gameInit[4 + 3 * 4 + 3] = (char)stage;
+	raw += (char)EVENT_GAME_INIT;
+	raw += gameInit;
+
+	u8 stocks[2] = {4, 4};
+	float percents[2] = {0, 0};
+	s32 lastFrame = Slippi::GAME_FIRST_FRAME + frames - 1;
+	for (s32 frame = Slippi::GAME_FIRST_FRAME; frame <= lastFrame; frame++)
+	{
+		raw += (char)EVENT_FRAME_START;
+		appendBE32(raw, frame);
+		appendBE32(raw, rng());
+
+		for (u8 port = 0; port < 2; port++)
+		{
+			if (stocks[port] > 1 && rng() % 900 == 0)
+			{
+				stocks[port]--;
+				percents[port] = 0;
+			}
+			else if (rng() % 30 == 0)
+			{
+				percents[port] += rng() % 20;
+			}
+
+			// Only the frame, port and the percent at the very end are filled in
+			raw += (char)EVENT_PRE_FRAME_UPDATE;
+			appendBE32(raw, frame);
+			raw += (char)port;
+			raw += '\0';
+			raw += std::string(PRE_FRAME_UPDATE_SIZE - 10, '\0');
+			appendFloat(raw, percents[port]);
+		}
+
+		for (u8 port = 0; port < 2; port++)
+		{
+			raw += (char)EVENT_POST_FRAME_UPDATE;
+			appendBE32(raw, frame);
+			raw += (char)port;
+			raw += '\0';
+			// Internal character id first, the stock count is the last byte
+			std::string post(POST_FRAME_UPDATE_SIZE - 6, '\0');
+			post[0] = characters[port];
+			post.back() = stocks[port];
+			raw += post;
+		}
+
+		raw += (char)EVENT_FRAME_END;
+		appendBE32(raw, frame);
+		appendBE32(raw, frame);
+	}
+
+	raw += (char)EVENT_GAME_END;
+	raw += (char)2;
+	raw += (char)0xFF;
+
+	std::string replay = REPLAY_RAW_MARKER;
+	appendBE32(replay, (u32)raw.size());
+	return replay + raw + "}";
+}
+
+SlippiReplayIndexBench::SlippiReplayIndexBench(const Options &benchOptions) : options(benchOptions)
+{
+	if (!options.directory.empty() && options.directory.back() != '/')
+		options.directory += '/';
+}
+
+bool SlippiReplayIndexBench::writeCorpus(int firstGame, int count)
+{
+	std::string corpusDirectory = options.directory + "corpus/";
+	File::CreateFullPath(corpusDirectory);
+
+	for (int i = firstGame; i < firstGame + count; i++)
+	{
+		// Seeded by game so the corpus is the same every run
+		std::mt19937 rng(i);
+		std::string path = StringFromFormat("%sGame_%05d.slp", corpusDirectory.c_str(), i);
+		if (!File::WriteStringToFile(makeReplay(rng, options.frames), path))
+		{
+			std::cout << "Could not write " << path << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::vector<std::string> SlippiReplayIndexBench::findCorpus()
+{
+	auto replays = DoFileSearch({".slp"}, {options.directory + "corpus"}, false);
+	std::sort(replays.begin(), replays.end());
+	return replays;
+}
+
+SlippiReplayIndexBench::QueryResult SlippiReplayIndexBench::queryByParsing(const std::vector<std::string> &replays)
+{
+	QueryResult result;
+	for (auto &path : replays)
+	{
+		auto game = Slippi::SlippiGame::FromFile(path);
+		if (!game || !game->AreSettingsLoaded())
+			continue;
+
+		Slippi::GameSettings *settings = game->GetSettings();
+		bool isMatch = false;
+		for (auto &player : settings->players)
+			isMatch = isMatch || player.second.characterId == QUERY_CHARACTER;
+		if (!isMatch || settings->stage != QUERY_STAGE)
+			continue;
+
+		result.games++;
+		Slippi::FrameData *previous = nullptr;
+		for (s32 i = Slippi::GAME_FIRST_FRAME; i <= game->GetLatestIndex(); i++)
+		{
+			Slippi::FrameData *frame = game->GetFrame(i);
+			if (!frame)
+				continue;
+
+			for (u8 port = 0; previous && port < 4; port++)
+			{
+				if (frame->HasPlayer(port, false) && previous->HasPlayer(port, false) &&
+				    frame->players[port].stocks != previous->players[port].stocks)
+					result.stockChanges++;
+			}
+			previous = frame;
+		}
+	}
+
+	return result;
+}
+
+SlippiReplayIndexBench::QueryResult SlippiReplayIndexBench::queryIndex(const std::string &indexPath)
+{
+	QueryResult result;
+	auto index = Slippi::SlippiReplayIndex::Open(indexPath);
+	if (!index)
+		return result;
+
+	for (u32 game : index->FindGames(QUERY_CHARACTER, QUERY_STAGE))
+	{
+		result.games++;
+		result.stockChanges += index->FindStockChanges(game).size();
+	}
+
+	return result;
+}
+
+int SlippiReplayIndexBench::Run()
+{
+	if (options.directory.empty() || options.games <= 0 || options.frames <= 0)
+	{
+		std::cout << "Nothing to benchmark" << std::endl;
+		return 1;
+	}
+
+	// A tenth of the corpus lands after the first index build to measure an incremental update
+	int lateGames = std::max(1, options.games / 10);
+	int earlyGames = std::max(1, options.games - lateGames);
+	std::string indexPath = options.directory + "replays.slpx";
+	File::Delete(indexPath);
+	File::DeleteDirRecursively(options.directory + "corpus");
+
+	u64 startUs = Common::Timer::GetTimeUs();
+	if (!writeCorpus(0, earlyGames))
+		return 1;
+	std::vector<std::string> replays = findCorpus();
+	std::cout << StringFromFormat("[INDEX_BENCH] wrote %u games of %d frames in %.2f s", (u32)replays.size(),
+	                              options.frames, (Common::Timer::GetTimeUs() - startUs) / 1000000.0)
+	          << std::endl;
+
+	startUs = Common::Timer::GetTimeUs();
+	QueryResult parsed = queryByParsing(replays);
+	u64 parseUs = Common::Timer::GetTimeUs() - startUs;
+	std::cout << StringFromFormat("[INDEX_BENCH] query by parsing every replay: %.1f ms (%u games, %llu stock "
+	                              "changes)",
+	                              parseUs / 1000.0, parsed.games, (unsigned long long)parsed.stockChanges)
+	          << std::endl;
+
+	// One thread first to show what the pool buys, the index is removed in between so both start from nothing
+	int threadCounts[] = {1, options.threads};
+	Slippi::IndexUpdateStats stats;
+	for (int threads : threadCounts)
+	{
+		File::Delete(indexPath);
+		startUs = Common::Timer::GetTimeUs();
+		if (!Slippi::SlippiReplayIndex::Update(indexPath, replays, threads, &stats))
+		{
+			std::cout << "Could not write " << indexPath << std::endl;
+			return 1;
+		}
+		std::cout << StringFromFormat("[INDEX_BENCH] build on %s thread(s): %.1f ms (%u games, %llu frames, %.1f "
+		                              "MB)",
+		                              threads ? std::to_string(threads).c_str() : "all",
+		                              (Common::Timer::GetTimeUs() - startUs) / 1000.0, stats.games,
+		                              (unsigned long long)stats.frames, stats.indexBytes / (1024.0 * 1024.0))
+		          << std::endl;
+	}
+
+	startUs = Common::Timer::GetTimeUs();
+	QueryResult indexed = queryIndex(indexPath);
+	u64 queryUs = Common::Timer::GetTimeUs() - startUs;
+	std::cout << StringFromFormat("[INDEX_BENCH] query from index: %.3f ms (%u games, %llu stock changes), %.0fx "
+	                              "faster than parsing",
+	                              queryUs / 1000.0, indexed.games, (unsigned long long)indexed.stockChanges,
+	                              queryUs ? (double)parseUs / queryUs : 0.0)
+	          << std::endl;
+
+	if (!writeCorpus(earlyGames, lateGames))
+		return 1;
+	replays = findCorpus();
+
+	startUs = Common::Timer::GetTimeUs();
+	Slippi::SlippiReplayIndex::Update(indexPath, replays, options.threads, &stats);
+	std::cout << StringFromFormat("[INDEX_BENCH] update after %d new games: %.1f ms (%u parsed, %u carried over)",
+	                              lateGames, (Common::Timer::GetTimeUs() - startUs) / 1000.0, stats.parsedGames,
+	                              stats.games - stats.parsedGames)
+	          << std::endl;
+
+	QueryResult parsedAll = queryByParsing(replays);
+	QueryResult indexedAll = queryIndex(indexPath);
+	bool isMatch = parsedAll.games == indexedAll.games && parsedAll.stockChanges == indexedAll.stockChanges;
+	std::cout << StringFromFormat("[INDEX_BENCH] index %s parsing after the update (%u games, %llu stock changes)",
+	                              isMatch ? "matches" : "DOES NOT MATCH", indexedAll.games,
+	                              (unsigned long long)indexedAll.stockChanges)
+	          << std::endl;
+
+	return isMatch ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	SlippiReplayIndexBench::Options options;
+	struct option longopts[] = {{"games", required_argument, nullptr, 'g'},
+	                            {"frames", required_argument, nullptr, 'f'},
+	                            {"threads", required_argument, nullptr, 't'},
+	                            {"help", no_argument, nullptr, 'h'},
+	                            {nullptr, 0, nullptr, 0}};
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "g:f:t:h?", longopts, nullptr)) != -1)
+	{
+		switch (ch)
+		{
+		case 'g':
+			options.games = std::max(1, atoi(optarg));
+			break;
+		case 'f':
+			options.frames = std::max(1, atoi(optarg));
+			break;
+		case 't':
+			options.threads = std::max(0, atoi(optarg));
+			break;
+		default:
+			optind = argc + 1;
+			break;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "Usage: %s [options] <dir>\n", argv[0]);
+		fprintf(stderr, "Write a synthetic replay corpus to a directory and compare queries by parsing against\n"
+		                "the replay index\n\n");
+		fprintf(stderr, "  -g, --games <count>    Games in the corpus (default: 200)\n");
+		fprintf(stderr, "  -f, --frames <count>   Frames per game (default: 3600)\n");
+		fprintf(stderr, "  -t, --threads <count>  Threads to build the index on, 0 for one per core (default: 0)\n");
+		return 1;
+	}
+	options.directory = argv[optind];
+
+	return SlippiReplayIndexBench(options).Run();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Benchmark for Slippi::SlippiReplayIndex. Writes a synthetic corpus of replays, then compares
+// answering queries by parsing every replay against building the index (on one and on all threads),
+// updating it after more replays land and answering the same queries from it
+class SlippiReplayIndexBench
+{
+  public:
+	typedef struct
+	{
+		// The corpus and the index are written here
+		std::string directory;
+		int games = 200;
+		int frames = 3600;
+		// Threads to build the index on, 0 for one per core
+		int threads = 0;
+	} Options;
+
+	SlippiReplayIndexBench(const Options &benchOptions);
+
+	// Returns a process exit code
+	int Run();
+
+  private:
+	typedef struct
+	{
+		u32 games = 0;
+		u64 stockChanges = 0;
+	} QueryResult;
+
+	bool writeCorpus(int firstGame, int count);
+	std::vector<std::string> findCorpus();
+
+	QueryResult queryByParsing(const std::vector<std::string> &replays);
+	QueryResult queryIndex(const std::string &indexPath);
+
+	Options options;
+};
@@ -0,0 +1,472 @@
+#include "SlippiSpectateBench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <thread>
+
+#include <enet/enet.h>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include "Common/FileUtil.h"
+#include "Common/StringUtil.h"
+#include "Common/Timer.h"
+#include "Core/ConfigManager.h"
+#include "Core/Slippi/SlippiSpectate.h"
+#include "UICommon/UICommon.h"
+
+#define REPLAY_RAW_MARKER "raw[$U#l"
+#define EVENT_PAYLOAD_SIZES 0x35
+#define EVENT_GAME_INIT 0x36
+#define EVENT_GAME_END 0x39
+#define EVENT_FRAME_END 0x3C
+#define EVENT_SPLIT_MESSAGE 0x10
+
+struct SlippiSpectateBench::Client
+{
+	int index;
+	bool isLate;
+	std::thread thread;
+	std::atomic<bool> shouldConnect{false};
+	std::atomic<bool> isConnected{false};
+	std::atomic<bool> isDone{false};
+	std::atomic<bool> isRefused{false};
+
+	// Only touched by the client thread until it has been joined
+	u32 messages = 0;
+	u64 bytes = 0;
+	u64 requestTimeUs = 0;
+	u64 firstReceiveUs = 0;
+	u64 lastReceiveUs = 0;
+	u32 catchUpCursor = 0;
+	u64 catchUpUs = 0;
+	std::vector<u32> latenciesUs;
+};
+
+static u32 readBE32(const u8 *data)
+{
+	return data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+}
+
+static bool isFlushEvent(u8 command)
+{
+	// Same set of events that make the server send out everything it has gathered
+	return command == EVENT_GAME_INIT || command == EVENT_FRAME_END || command == EVENT_GAME_END ||
+	       command == EVENT_SPLIT_MESSAGE;
+}
+
+static double percentileMs(std::vector<u32> &sorted, double percentile)
+{
+	if (sorted.empty())
+		return 0.0;
+
+	size_t idx = std::min(sorted.size() - 1, (size_t)(percentile / 100.0 * sorted.size()));
+	return sorted[idx] / 1000.0;
+}
+
+SlippiSpectateBench::SlippiSpectateBench(const Options &benchOptions) : options(benchOptions) {}
+
+SlippiSpectateBench::~SlippiSpectateBench()
+{
+	isStopping = true;
+	for (auto &client : clients)
+	{
+		if (client->thread.joinable())
+			client->thread.join();
+	}
+}
+
+bool SlippiSpectateBench::loadReplay()
+{
+	std::string contents;
+	if (!File::ReadFileToString(options.replayPath, contents))
+	{
+		std::cout << "Could not read " << options.replayPath << std::endl;
+		return false;
+	}
+	replay.assign(contents.begin(), contents.end());
+
+	size_t markerPos = contents.find(REPLAY_RAW_MARKER);
+	size_t rawStart = markerPos + strlen(REPLAY_RAW_MARKER) + 4;
+	if (markerPos == std::string::npos || rawStart > replay.size())
+	{
+		std::cout << "Not a Slippi replay: " << options.replayPath << std::endl;
+		return false;
+	}
+
+	// A replay that was never closed has a length of 0, it then runs to the end of the file
+	size_t rawEnd = rawStart + readBE32(&replay[rawStart - 4]);
+	if (rawEnd == rawStart || rawEnd > replay.size())
+		rawEnd = replay.size();
+
+	if (rawStart + 2 > rawEnd || replay[rawStart] != EVENT_PAYLOAD_SIZES)
+	{
+		std::cout << "Replay doesn't start with the payload sizes event" << std::endl;
+		return false;
+	}
+
+	u32 payloadSizes[256] = {};
+	u8 sizesLength = replay[rawStart + 1];
+	payloadSizes[EVENT_PAYLOAD_SIZES] = sizesLength;
+	for (size_t pos = rawStart + 2; pos + 3 <= rawStart + 1 + sizesLength && pos + 3 <= rawEnd; pos += 3)
+		payloadSizes[replay[pos]] = replay[pos + 1] << 8 | replay[pos + 2];
+
+	u32 frameCount = 0;
+	size_t pos = rawStart;
+	while (pos < rawEnd)
+	{
+		u8 command = replay[pos];
+		u32 length = payloadSizes[command] + 1;
+		if (payloadSizes[command] == 0 || pos + length > rawEnd)
+			break;
+
+		events.push_back({command, (u32)pos, length});
+		if (isFlushEvent(command))
+			messageCount++;
+		if (command == EVENT_FRAME_END)
+			frameCount++;
+		pos += length;
+	}
+
+	if (frameCount == 0)
+	{
+		std::cout << "Replay has no frame end events, it needs to be from Slippi 3.0.0 or later" << std::endl;
+		return false;
+	}
+
+	// Plus the start_game and end_game messages
+	messageCount += 2;
+	messageWriteTimes.reset(new std::atomic<u64>[messageCount]);
+	for (u32 i = 0; i < messageCount; i++)
+		messageWriteTimes[i] = 0;
+
+	return true;
+}
+
+void SlippiSpectateBench::clientThread(Client *client)
+{
+	while (!client->shouldConnect && !isStopping)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	ENetHost *host = enet_host_create(nullptr, 1, 2, 0, 0);
+	if (!host)
+	{
+		client->isRefused = true;
+		return;
+	}
+
+	ENetAddress address;
+	enet_address_set_host(&address, "127.0.0.1");
+	address.port = SConfig::GetInstance().m_spectator_local_port;
+	ENetPeer *peer = enet_host_connect(host, &address, 2, 0);
+
+	ENetEvent event;
+	while (peer && !isStopping && !client->isDone && !client->isRefused)
+	{
+		if (enet_host_service(host, &event, 1) <= 0)
+			continue;
+
+		switch (event.type)
+		{
+		case ENET_EVENT_TYPE_CONNECT:
+		{
+			client->catchUpCursor = messagesWritten;
+			client->requestTimeUs = Common::Timer::GetTimeUs();
+
+			std::string request = json({{"type", "connect_request"}, {"cursor", 0}}).dump();
+			ENetPacket *packet = enet_packet_create(request.data(), request.length(), ENET_PACKET_FLAG_RELIABLE);
+			enet_peer_send(peer, 0, packet);
+			break;
+		}
+		case ENET_EVENT_TYPE_RECEIVE:
+		{
+			u64 now = Common::Timer::GetTimeUs();
+			json message = json::parse(event.packet->data, event.packet->data + event.packet->dataLength, nullptr, false);
+			size_t length = event.packet->dataLength;
+			enet_packet_destroy(event.packet);
+
+			if (message.is_discarded() || !message["type"].is_string())
+				break;
+
+			std::string type = message["type"];
+			if (type == "connect_reply")
+			{
+				client->isConnected = true;
+				break;
+			}
+			if (!message["cursor"].is_number_unsigned())
+				break;
+
+			u32 cursor = message["cursor"];
+			client->messages++;
+			client->bytes += length;
+			if (!client->firstReceiveUs)
+				client->firstReceiveUs = now;
+			client->lastReceiveUs = now;
+
+			// Anything written before the client asked to connect is catch-up, not live latency
+			u64 writeTimeUs = cursor < messageCount ? messageWriteTimes[cursor].load() : 0;
+			if (cursor >= client->catchUpCursor && writeTimeUs)
+				client->latenciesUs.push_back((u32)(now - writeTimeUs));
+			if (client->catchUpCursor && !client->catchUpUs && cursor + 1 >= client->catchUpCursor)
+				client->catchUpUs = now - client->requestTimeUs;
+
+			if (type == "end_game")
+				client->isDone = true;
+			break;
+		}
+		case ENET_EVENT_TYPE_DISCONNECT:
+			// The server had no room for another peer, or the connection attempt timed out
+			client->isRefused = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (peer)
+		enet_peer_disconnect_now(peer, 0);
+	enet_host_flush(host);
+	enet_host_destroy(host);
+}
+
+bool SlippiSpectateBench::waitForClients(int first, int count, u64 timeoutUs)
+{
+	u64 deadline = Common::Timer::GetTimeUs() + timeoutUs;
+	while (Common::Timer::GetTimeUs() < deadline)
+	{
+		int settled = 0;
+		for (int i = first; i < first + count; i++)
+		{
+			if (clients[i]->isConnected || clients[i]->isRefused)
+				settled++;
+		}
+		if (settled == count)
+			return true;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	return false;
+}
+
+int SlippiSpectateBench::Run()
+{
+	if (!loadReplay())
+		return 1;
+
+	if (enet_initialize() != 0)
+	{
+		std::cout << "Could not initialize ENet" << std::endl;
+		return 1;
+	}
+
+	SConfig::GetInstance().m_enableSpectator = true;
+	SlippiSpectateServer *server = SlippiSpectateServer::getInstance();
+
+	int totalClients = options.clients + options.lateClients;
+	for (int i = 0; i < totalClients; i++)
+	{
+		std::unique_ptr<Client> client = std::make_unique<Client>();
+		client->index = i;
+		client->isLate = i >= options.clients;
+		client->shouldConnect = !client->isLate;
+		clients.push_back(std::move(client));
+	}
+	for (auto &client : clients)
+		client->thread = std::thread(&SlippiSpectateBench::clientThread, this, client.get());
+
+	// The server may still be claiming its port, give everyone a moment to shake hands
+	waitForClients(0, options.clients, 10000000);
+
+	u32 frameCount = 0;
+	for (auto &event : events)
+	{
+		if (event.command == EVENT_FRAME_END)
+			frameCount++;
+	}
+
+	SpectateServerStats startStats = server->getStats();
+	u64 startTimeUs = Common::Timer::GetTimeUs();
+
+	messageWriteTimes[0] = Common::Timer::GetTimeUs();
+	server->startGame();
+	messagesWritten = 1;
+
+	bool hasEnded = false;
+	u32 framesWritten = 0;
+	for (auto &event : events)
+	{
+		if (isFlushEvent(event.command) && messagesWritten < messageCount)
+			messageWriteTimes[messagesWritten] = Common::Timer::GetTimeUs();
+		server->write(&replay[event.offset], event.length);
+		if (isFlushEvent(event.command))
+			messagesWritten++;
+
+		if (event.command == EVENT_GAME_END)
+		{
+			messageWriteTimes[messagesWritten] = Common::Timer::GetTimeUs();
+			server->endGame();
+			messagesWritten++;
+			hasEnded = true;
+			break;
+		}
+
+		if (event.command != EVENT_FRAME_END)
+			continue;
+
+		framesWritten++;
+		if (framesWritten == frameCount / 2)
+		{
+			for (auto &client : clients)
+			{
+				if (client->isLate)
+					client->shouldConnect = true;
+			}
+		}
+
+		if (options.rate > 0)
+		{
+			u64 targetUs = startTimeUs + (u64)(framesWritten * 1000000.0 / options.rate);
+			u64 nowUs = Common::Timer::GetTimeUs();
+			if (targetUs > nowUs)
+				std::this_thread::sleep_for(std::chrono::microseconds(targetUs - nowUs));
+		}
+	}
+
+	if (!hasEnded)
+	{
+		messageWriteTimes[messagesWritten] = Common::Timer::GetTimeUs();
+		server->endGame();
+		messagesWritten++;
+	}
+
+	u64 playTimeUs = Common::Timer::GetTimeUs() - startTimeUs;
+
+	// Let the clients drain whatever is still in flight
+	u64 deadline = Common::Timer::GetTimeUs() + 10000000;
+	while (Common::Timer::GetTimeUs() < deadline)
+	{
+		bool isDrained = std::all_of(clients.begin(), clients.end(), [](const std::unique_ptr<Client> &client) {
+			return client->isDone || client->isRefused || !client->isConnected;
+		});
+		if (isDrained)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	u64 wallTimeUs = Common::Timer::GetTimeUs() - startTimeUs;
+	SpectateServerStats endStats = server->getStats();
+	isStopping = true;
+	for (auto &client : clients)
+		client->thread.join();
+
+	printReport(playTimeUs, wallTimeUs, endStats.thread_cpu_us - startStats.thread_cpu_us);
+	std::cout << StringFromFormat("[SPECTATE_BENCH] server: packets: %llu, MB: %.2f, overflowed events: %u",
+	                              (unsigned long long)(endStats.packets_sent - startStats.packets_sent),
+	                              (endStats.bytes_sent - startStats.bytes_sent) / 1000000.0,
+	                              endStats.overflowed_events - startStats.overflowed_events)
+	          << std::endl;
+
+	enet_deinitialize();
+
+	bool isComplete = std::all_of(clients.begin(), clients.end(),
+	                              [](const std::unique_ptr<Client> &client) { return client->isDone.load(); });
+	return isComplete ? 0 : 1;
+}
+
+void SlippiSpectateBench::printReport(u64 playTimeUs, u64 wallTimeUs, u64 cpuTimeUs)
+{
+	std::cout << StringFromFormat("[SPECTATE_BENCH] replay: %s, messages: %u, clients: %d + %d late, rate: %.1f Hz",
+	                              options.replayPath.c_str(), messageCount, options.clients, options.lateClients,
+	                              options.rate)
+	          << std::endl;
+
+	std::vector<u32> allLatencies;
+	for (auto &client : clients)
+	{
+		// Peers past MAX_CLIENTS are never let in, ENet just lets their connection attempt time out
+		std::string status = client->isDone ? "ok" : !client->isConnected ? "refused" : "incomplete";
+		double seconds = (client->lastReceiveUs - client->firstReceiveUs) / 1000000.0;
+
+		std::vector<u32> &latencies = client->latenciesUs;
+		std::sort(latencies.begin(), latencies.end());
+		allLatencies.insert(allLatencies.end(), latencies.begin(), latencies.end());
+
+		std::string line = StringFromFormat(
+		    "[SPECTATE_CLIENT] %d %s%s: messages: %u/%u, MB/s: %.2f, latency ms p50: %.3f, p90: %.3f, p99: %.3f, "
+		    "max: %.3f",
+		    client->index, status.c_str(), client->isLate ? " (late)" : "", client->messages, messageCount,
+		    seconds > 0 ? client->bytes / 1000000.0 / seconds : 0.0, percentileMs(latencies, 50),
+		    percentileMs(latencies, 90), percentileMs(latencies, 99), latencies.empty() ? 0.0 : latencies.back() / 1000.0);
+		if (client->isLate)
+			line += StringFromFormat(", catch-up ms: %.3f", client->catchUpUs / 1000.0);
+		std::cout << line << std::endl;
+	}
+
+	std::sort(allLatencies.begin(), allLatencies.end());
+	std::cout << StringFromFormat("[SPECTATE_BENCH] latency ms p50: %.3f, p90: %.3f, p99: %.3f, max: %.3f, "
+	                              "play time s: %.2f, drained s: %.2f, server thread CPU ms: %.1f (%.1f%%)",
+	                              percentileMs(allLatencies, 50), percentileMs(allLatencies, 90),
+	                              percentileMs(allLatencies, 99),
+	                              allLatencies.empty() ? 0.0 : allLatencies.back() / 1000.0, playTimeUs / 1000000.0,
+	                              wallTimeUs / 1000000.0, cpuTimeUs / 1000.0, wallTimeUs ? cpuTimeUs * 100.0 / wallTimeUs : 0.0)
+	          << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	SlippiSpectateBench::Options options;
+	struct option longopts[] = {{"clients", required_argument, nullptr, 'c'},
+	                            {"late-clients", required_argument, nullptr, 'l'},
+	                            {"rate", required_argument, nullptr, 'r'},
+	                            {"help", no_argument, nullptr, 'h'},
+	                            {nullptr, 0, nullptr, 0}};
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "c:l:r:h?", longopts, nullptr)) != -1)
+	{
+		switch (ch)
+		{
+		case 'c':
+			options.clients = std::max(0, atoi(optarg));
+			break;
+		case 'l':
+			options.lateClients = std::max(0, atoi(optarg));
+			break;
+		case 'r':
+			options.rate = std::max(0.0, atof(optarg));
+			break;
+		default:
+			optind = argc + 1;
+			break;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "Usage: %s [options] <replay>\n", argv[0]);
+		fprintf(stderr, "Stream a replay through the spectator server to local clients and report latency,\n"
+		                "throughput and CPU use\n\n");
+		fprintf(stderr, "  -c, --clients <count>       Clients connected from the start (default: 4)\n");
+		fprintf(stderr, "  -l, --late-clients <count>  Clients that join halfway through the game (default: 0)\n");
+		fprintf(stderr, "  -r, --rate <hz>             Frames per second to stream, 0 for unthrottled (default: 60)\n");
+		return 1;
+	}
+	options.replayPath = argv[optind];
+
+	UICommon::SetUserDirectory("");  // Auto-detect user folder
+	UICommon::Init();
+
+	int result = SlippiSpectateBench(options).Run();
+
+	// The bench turns the spectator server on, don't save that over the user's config
+	SConfig::GetInstance().LoadSettings();
+	UICommon::Shutdown();
+	return result;
+}
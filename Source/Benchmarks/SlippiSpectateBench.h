@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Stress harness for SlippiSpectateServer. Feeds the events of a recorded .slp into the server the
+// same way EXI_DeviceSlippi does while a number of local ENet clients handshake and consume them,
+// then reports per client latency, throughput and how much CPU the server thread used
+class SlippiSpectateBench
+{
+  public:
+	typedef struct
+	{
+		std::string replayPath;
+		int clients = 4;
+		// Clients that only connect halfway through the game and have to be caught up
+		int lateClients = 0;
+		// Frames written per second, 0 writes as fast as possible
+		double rate = 60.0;
+	} Options;
+
+	SlippiSpectateBench(const Options &benchOptions);
+	~SlippiSpectateBench();
+
+	// Returns a process exit code
+	int Run();
+
+  private:
+	typedef struct
+	{
+		u8 command;
+		u32 offset;
+		u32 length;
+	} ReplayEvent;
+
+	struct Client;
+
+	bool loadReplay();
+	void clientThread(Client *client);
+	bool waitForClients(int first, int count, u64 timeoutUs);
+	// playTimeUs covers writing the game, wallTimeUs also covers the clients draining it afterwards
+	void printReport(u64 playTimeUs, u64 wallTimeUs, u64 cpuTimeUs);
+
+	Options options;
+	std::vector<u8> replay;
+	std::vector<ReplayEvent> events;
+
+	// Time each game_event message was written, indexed by cursor. The start_game message is cursor 0
+	std::unique_ptr<std::atomic<u64>[]> messageWriteTimes;
+	u32 messageCount = 0;
+	std::atomic<u32> messagesWritten{0};
+	std::atomic<bool> isStopping{false};
+
+	std::vector<std::unique_ptr<Client>> clients;
+};
@@ -0,0 +1,186 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "StateSlotCacheBench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <lzo/lzo1x.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/StringUtil.h"
+#include "Common/Timer.h"
+#include "Core/StateSlotCache.h"
+
+namespace State
+{
+// About the size of a GameCube state, most of which is MEM1
+static const size_t STATE_SIZE = 26 * 1024 * 1024;
+// The chunk size State.cpp compresses with
+static const size_t CHUNK_SIZE = 128 * 1024;
+
+static std::vector<u8> MakeState(u32 seed)
+{
+	std::vector<u8> state(STATE_SIZE);
+	std::mt19937 rng(seed);
+	// Mostly zeroes with some noise, so it compresses about like a real state would
+	for (size_t i = 0; i < state.size(); i += 16)
+		state[i] = static_cast<u8>(rng());
+	return state;
+}
+
+static void TouchPages(std::vector<u8>& state, u32 seed, int pages)
+{
+	std::mt19937 rng(seed);
+	for (int i = 0; i < pages; i++)
+	{
+		const size_t page = rng() % (state.size() / SlotCache::PAGE_SIZE);
+		for (size_t j = 0; j < SlotCache::PAGE_SIZE; j += 8)
+			state[page * SlotCache::PAGE_SIZE + j] ^= static_cast<u8>(rng() | 1);
+	}
+}
+
+static std::vector<u8> Compress(const std::vector<u8>& state, std::vector<lzo_align_t>& wrkmem)
+{
+	std::vector<u8> compressed;
+	std::vector<u8> chunk(CHUNK_SIZE + CHUNK_SIZE / 16 + 64 + 3);
+	for (size_t offset = 0; offset < state.size(); offset += CHUNK_SIZE)
+	{
+		lzo_uint out_len = 0;
+		lzo1x_1_compress(&state[offset], std::min(CHUNK_SIZE, state.size() - offset), chunk.data(), &out_len,
+		                 wrkmem.data());
+		const u32 size = static_cast<u32>(out_len);
+		compressed.insert(compressed.end(), reinterpret_cast<const u8*>(&size),
+		                  reinterpret_cast<const u8*>(&size) + sizeof(size));
+		compressed.insert(compressed.end(), chunk.begin(), chunk.begin() + out_len);
+	}
+	return compressed;
+}
+
+static void Decompress(const std::vector<u8>& compressed, std::vector<u8>& state)
+{
+	state.resize(STATE_SIZE);
+	size_t in = 0;
+	for (size_t offset = 0; offset < state.size();)
+	{
+		u32 size;
+		memcpy(&size, &compressed[in], sizeof(size));
+		lzo_uint out_len = state.size() - offset;
+		lzo1x_decompress_safe(&compressed[in + sizeof(size)], size, &state[offset], &out_len, nullptr);
+		in += sizeof(size) + size;
+		offset += out_len;
+	}
+}
+
+int SlotCacheBench::Run()
+{
+	if (m_options.states <= 0 || lzo_init() != LZO_E_OK)
+	{
+		std::cout << "Nothing to benchmark" << std::endl;
+		return 1;
+	}
+
+	const int count = m_options.states;
+	std::vector<std::vector<u8>> states(1, MakeState(1));
+	for (int i = 1; i < count; i++)
+	{
+		states.push_back(states.back());
+		TouchPages(states.back(), i, m_options.pages_touched);
+	}
+
+	std::vector<lzo_align_t> wrkmem((LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t));
+	std::vector<std::vector<u8>> compressed(count);
+	SlotCache cache;
+
+	// Saving always writes the compressed file, the cache is extra work on top of it
+	u64 start_us = Common::Timer::GetTimeUs();
+	for (int i = 0; i < count; i++)
+		compressed[i] = Compress(states[i], wrkmem);
+	const u64 compress_us = Common::Timer::GetTimeUs() - start_us;
+
+	start_us = Common::Timer::GetTimeUs();
+	for (int i = 0; i < count; i++)
+		cache.Put(std::to_string(i), {compressed[i].size(), 0}, states[i]);
+	const u64 put_us = Common::Timer::GetTimeUs() - start_us;
+
+	std::vector<u8> loaded;
+	bool is_valid = true;
+	start_us = Common::Timer::GetTimeUs();
+	for (int i = 0; i < count; i++)
+		Decompress(compressed[i], loaded);
+	const u64 decompress_us = Common::Timer::GetTimeUs() - start_us;
+	is_valid &= loaded == states.back();
+
+	// The oldest states may have been dropped to stay within the memory limit, the last one never is
+	int hits = 0;
+	start_us = Common::Timer::GetTimeUs();
+	for (int i = 0; i < count; i++)
+		hits += cache.Get(std::to_string(i), {compressed[i].size(), 0}, loaded);
+	const u64 get_us = Common::Timer::GetTimeUs() - start_us;
+	is_valid &= loaded == states.back();
+
+	size_t compressed_bytes = 0;
+	for (const auto& state : compressed)
+		compressed_bytes += state.size();
+
+	std::cout << StringFromFormat("[STATE_CACHE_BENCH] %d states of %.1f MB, %d pages touched in between", count,
+	                              STATE_SIZE / (1024.0 * 1024.0), m_options.pages_touched)
+	          << std::endl;
+	std::cout << StringFromFormat("[STATE_CACHE_BENCH] save: LZO %.2f ms, LZO + cache %.2f ms per state",
+	                              compress_us / 1000.0 / count, (compress_us + put_us) / 1000.0 / count)
+	          << std::endl;
+	std::cout << StringFromFormat("[STATE_CACHE_BENCH] load: LZO %.2f ms, cache %.2f ms per state (%d of %d cached)",
+	                              decompress_us / 1000.0 / count, get_us / 1000.0 / count, hits, count)
+	          << std::endl;
+	std::cout << StringFromFormat("[STATE_CACHE_BENCH] files %.1f MB, cache %.1f MB in memory",
+	                              compressed_bytes / (1024.0 * 1024.0), cache.GetMemoryUsage() / (1024.0 * 1024.0))
+	          << std::endl;
+
+	if (!is_valid)
+	{
+		std::cout << "[STATE_CACHE_BENCH] loaded states don't match what was saved" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+}  // namespace State
+
+int main(int argc, char* argv[])
+{
+	State::SlotCacheBench::Options options;
+	struct option longopts[] = {{"states", required_argument, nullptr, 's'},
+	                            {"pages", required_argument, nullptr, 'p'},
+	                            {"help", no_argument, nullptr, 'h'},
+	                            {nullptr, 0, nullptr, 0}};
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "s:p:h?", longopts, nullptr)) != -1)
+	{
+		switch (ch)
+		{
+		case 's':
+			options.states = std::max(1, atoi(optarg));
+			break;
+		case 'p':
+			options.pages_touched = std::max(0, atoi(optarg));
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+			fprintf(stderr, "Save and load synthetic states with and without the savestate slot cache\n\n");
+			fprintf(stderr, "  -s, --states <count>  States to save and load (default: 10)\n");
+			fprintf(stderr, "  -p, --pages <count>   Pages touched between two saves (default: 256)\n");
+			return 1;
+		}
+	}
+
+	return State::SlotCacheBench(options).Run();
+}
@@ -0,0 +1,31 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+namespace State
+{
+// Benchmark for SlotCache on synthetic states the size of a GameCube state. A save compresses the
+// state with LZO in the chunks State.cpp writes, with and without also putting it in the cache. A load
+// decompresses it again or gets it from the cache. Compression runs on one thread here, State.cpp
+// spreads the chunks over several
+class SlotCacheBench
+{
+public:
+	struct Options
+	{
+		int states = 10;
+		// Pages the game touches between two saves
+		int pages_touched = 256;
+	};
+
+	explicit SlotCacheBench(const Options& options) : m_options(options) {}
+
+	// Returns a process exit code
+	int Run();
+
+private:
+	Options m_options;
+};
+}  // namespace State
@@ -65,9 +65,11 @@ public:
 
 	u8** ptr;
 	Mode mode;
+	// Writes stop at end and switch to MODE_MEASURE, so *ptr still ends up at the size the state needs
+	u8* end;
 
 public:
-	PointerWrap(u8** ptr_, Mode mode_) : ptr(ptr_), mode(mode_) {}
+	PointerWrap(u8** ptr_, Mode mode_, u8* end_ = nullptr) : ptr(ptr_), mode(mode_), end(end_) {}
 	void SetMode(Mode mode_) { mode = mode_; }
 	Mode GetMode() const { return mode; }
 	template <typename K, class V>
@@ -279,6 +281,11 @@ private:
 			break;
 
 		case MODE_WRITE:
+			if (end && size > static_cast<size_t>(end - *ptr))
+			{
+				mode = MODE_MEASURE;
+				break;
+			}
 			memcpy(*ptr, data, size);
 			break;
 
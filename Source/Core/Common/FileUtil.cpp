@@ -590,6 +590,32 @@ u64 GetFileModTime(const std::string &filename)
 	return file_info.st_mtime;
 }
 
+u64 GetFileModTimeNs(const std::string &filename)
+{
+	std::string copy(filename);
+	StripTailDirSlashes(copy);
+
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA file_info;
+	if (!GetFileAttributesEx(UTF8ToTStr(copy).c_str(), GetFileExInfoStandard, &file_info))
+		return 0;
+
+	// FILETIME counts 100ns intervals
+	return (((u64)file_info.ftLastWriteTime.dwHighDateTime << 32) |
+		file_info.ftLastWriteTime.dwLowDateTime) * 100;
+#else
+	struct stat file_info;
+	if (stat(copy.c_str(), &file_info) < 0)
+		return 0;
+
+#ifdef __APPLE__
+	return (u64)file_info.st_mtimespec.tv_sec * 1000000000 + file_info.st_mtimespec.tv_nsec;
+#else
+	return (u64)file_info.st_mtim.tv_sec * 1000000000 + file_info.st_mtim.tv_nsec;
+#endif
+#endif
+}
+
 // Create directory and copy contents (does not overwrite existing files)
 void CopyDir(const std::string &source_path, const std::string &dest_path)
 {
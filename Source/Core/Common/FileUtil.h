@@ -128,6 +128,10 @@ std::string GetCurrentDir();
 // Gets the mod time of a file
 u64 GetFileModTime(const std::string &path);
 
+// Gets the mod time of a file in nanoseconds, as precise as the file system keeps it. The epoch
+// differs between platforms, so it is only good for telling whether a file changed
+u64 GetFileModTimeNs(const std::string &path);
+
 // Create directory and copy contents (does not overwrite existing files)
 void CopyDir(const std::string& source_path, const std::string& dest_path);
 
@@ -0,0 +1,123 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Common/FramePacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "Common/Thread.h"
+#include "Common/Timer.h"
+
+namespace Common
+{
+constexpr u64 FramePacer::MIN_SPIN_NS;
+constexpr u64 FramePacer::MAX_SPIN_NS;
+
+void FramePacer::Calibrate()
+{
+	// The worst of a run of 1 ms sleeps, plus some room for scheduling noise
+	u64 worst_ns = 0;
+	for (int i = 0; i < 20; i++)
+	{
+		const u64 start = Timer::GetTimeNs();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		const u64 slept = Timer::GetTimeNs() - start;
+		if (slept > 1000 * 1000)
+			worst_ns = std::max(worst_ns, slept - 1000 * 1000);
+	}
+
+	m_calibrated_spin_ns = std::min(MAX_SPIN_NS, std::max(MIN_SPIN_NS, worst_ns + worst_ns / 4));
+	m_spin_ns = m_calibrated_spin_ns;
+}
+
+void FramePacer::WaitUntil(u64 deadline_ns)
+{
+	u64 now = Timer::GetTimeNs();
+	if (now + m_spin_ns < deadline_ns)
+	{
+		const u64 wake_ns = deadline_ns - m_spin_ns;
+		std::this_thread::sleep_for(std::chrono::nanoseconds(wake_ns - now));
+		now = Timer::GetTimeNs();
+
+		// Slept past the deadline, wake up earlier from now on. Otherwise drift back to the calibrated
+		// margin so one bad wakeup doesn't keep the thread spinning
+		if (now > deadline_ns)
+			m_spin_ns = std::min(MAX_SPIN_NS, m_spin_ns + (now - deadline_ns));
+		else if (m_spin_ns > m_calibrated_spin_ns)
+			m_spin_ns -= std::max<u64>(1, (m_spin_ns - m_calibrated_spin_ns) / 64);
+	}
+
+	while (now < deadline_ns)
+	{
+		YieldCPU();
+		now = Timer::GetTimeNs();
+	}
+
+	RecordWait(now, deadline_ns);
+}
+
+void FramePacer::SleepUntil(u64 deadline_ns)
+{
+	u64 now = Timer::GetTimeNs();
+	if (now < deadline_ns)
+	{
+		std::this_thread::sleep_for(std::chrono::nanoseconds(deadline_ns - now));
+		now = Timer::GetTimeNs();
+	}
+
+	RecordWait(now, deadline_ns);
+}
+
+void FramePacer::RecordWait(u64 now_ns, u64 deadline_ns)
+{
+	const u64 late_ns = now_ns > deadline_ns ? now_ns - deadline_ns : 0;
+
+	std::lock_guard<std::mutex> lk(m_stats_mutex);
+	m_waits++;
+	m_late_total_ns += late_ns;
+	m_late_max_ns = std::max(m_late_max_ns, late_ns);
+}
+
+void FramePacer::RecordFrame()
+{
+	const u64 now = Timer::GetTimeNs();
+
+	std::lock_guard<std::mutex> lk(m_stats_mutex);
+	if (m_last_frame_ns)
+	{
+		const u64 frame_ns = now - m_last_frame_ns;
+		m_frames++;
+		const double delta = frame_ns - m_frame_mean_ns;
+		m_frame_mean_ns += delta / m_frames;
+		m_frame_m2 += delta * (frame_ns - m_frame_mean_ns);
+		m_frame_max_ns = std::max(m_frame_max_ns, frame_ns);
+	}
+	m_last_frame_ns = now;
+}
+
+FramePacer::Stats FramePacer::TakeStats()
+{
+	std::lock_guard<std::mutex> lk(m_stats_mutex);
+
+	Stats stats;
+	stats.frames = m_frames;
+	stats.mean_frame_ms = m_frame_mean_ns / 1000000.0;
+	stats.stddev_frame_ms = m_frames > 1 ? std::sqrt(m_frame_m2 / (m_frames - 1)) / 1000000.0 : 0;
+	stats.max_frame_ms = m_frame_max_ns / 1000000.0;
+	stats.mean_late_us = m_waits ? m_late_total_ns / 1000.0 / m_waits : 0;
+	stats.max_late_us = m_late_max_ns / 1000.0;
+
+	m_frames = 0;
+	m_frame_mean_ns = 0;
+	m_frame_m2 = 0;
+	m_frame_max_ns = 0;
+	m_waits = 0;
+	m_late_total_ns = 0;
+	m_late_max_ns = 0;
+	return stats;
+}
+}  // namespace Common
@@ -0,0 +1,67 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <mutex>
+
+#include "Common/CommonTypes.h"
+
+namespace Common
+{
+// Waits for deadlines on the monotonic clock. WaitUntil() does better than OS sleep precision: the
+// thread sleeps until shortly before the deadline, then spins for the rest. How early it wakes up is
+// measured once by Calibrate() and adjusted whenever a sleep overshoots. SleepUntil() only sleeps.
+class FramePacer
+{
+public:
+	struct Stats
+	{
+		u32 frames = 0;
+		double mean_frame_ms = 0;
+		double stddev_frame_ms = 0;
+		double max_frame_ms = 0;
+		// How late WaitUntil() returned, over the same window
+		double mean_late_us = 0;
+		double max_late_us = 0;
+	};
+
+	// Measures how much the OS oversleeps. Takes a few dozen milliseconds
+	void Calibrate();
+
+	// Returns once Timer::GetTimeNs() reaches deadline_ns
+	void WaitUntil(u64 deadline_ns);
+
+	// Sleeps until deadline_ns without spinning, returns as late as the OS wakes the thread up
+	void SleepUntil(u64 deadline_ns);
+
+	// Adds the time since the previous call to the frame time statistics
+	void RecordFrame();
+
+	// Statistics since the previous call, which starts a new window. Safe to call from any thread
+	Stats TakeStats();
+
+	u64 GetSpinThresholdNs() const { return m_spin_ns; }
+
+private:
+	static constexpr u64 MIN_SPIN_NS = 50 * 1000;
+	static constexpr u64 MAX_SPIN_NS = 2 * 1000 * 1000;
+
+	void RecordWait(u64 now_ns, u64 deadline_ns);
+
+	u64 m_calibrated_spin_ns = MIN_SPIN_NS;
+	u64 m_spin_ns = MIN_SPIN_NS;
+
+	std::mutex m_stats_mutex;
+	u64 m_last_frame_ns = 0;
+	// Welford's running mean and sum of squared differences
+	u32 m_frames = 0;
+	double m_frame_mean_ns = 0;
+	double m_frame_m2 = 0;
+	u64 m_frame_max_ns = 0;
+	u32 m_waits = 0;
+	u64 m_late_total_ns = 0;
+	u64 m_late_max_ns = 0;
+};
+}  // namespace Common
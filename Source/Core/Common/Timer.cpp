@@ -2,6 +2,7 @@
 // Licensed under GPLv2+
 // Refer to the license.txt file included.
 
+#include <chrono>
 #include <cinttypes>
 #include <ctime>
 #include <string>
@@ -67,6 +68,12 @@ u64 Timer::GetTimeUs()
 #endif
 }
 
+u64 Timer::GetTimeNs()
+{
+	return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
 // --------------------------------------------
 // Initiate, Start, Stop, and Update the time
 // --------------------------------------------
@@ -37,6 +37,8 @@ public:
 
 	static u32 GetTimeMs();
 	static u64 GetTimeUs();
+	// Monotonic, for deadlines that need better than microsecond precision
+	static u64 GetTimeNs();
 
 	// Arbitrarily chosen value (38 years) that is subtracted in GetDoubleTime()
 	// to increase sub-second precision of the resulting double timestamp
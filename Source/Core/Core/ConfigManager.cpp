@@ -279,10 +279,21 @@ void SConfig::SaveCoreSettings(IniFile &ini)
 	core->Set("RSHACK", bRSHACK);
 	core->Set("Latency", iLatency);
 	core->Set("ReduceTimingDispersion", bReduceTimingDispersion);
+	core->Set("PreciseFramePacing", bPreciseFramePacing);
 	core->Set("SlippiOnlineDelay", m_slippiOnlineDelay);
 	core->Set("SlippiEnableSpectator", m_enableSpectator);
 	core->Set("SlippiSpectatorLocalPort", m_spectator_local_port);
 	core->Set("SlippiSaveReplays", m_slippiSaveReplays);
+	core->Set("SlippiCompressReplays", m_slippiCompressReplays);
+	core->Set("SlippiContinuousTimeSync", m_slippiContinuousTimeSync);
+	core->Set("SlippiNetplayBusyPoll", m_slippiNetplayBusyPoll);
+	core->Set("SlippiNetplayBusyPollCore", m_slippiNetplayBusyPollCore);
+	core->Set("SlippiCompactPads", m_slippiCompactPads);
+	core->Set("SlippiPadRedundancy", m_slippiPadRedundancy);
+	core->Set("SlippiLinkSimulator", m_slippiLinkSimulator);
+	core->Set("SlippiOnlineTracePath", m_slippiOnlineTracePath);
+	core->Set("SlippiWriteTimeline", m_slippiWriteTimeline);
+	core->Set("SlippiShowRollbackStats", m_slippiShowRollbackStats);
 	core->Set("SlippiEnableQuickChat", m_slippiEnableQuickChat);
 	core->Set("SlippiForceNetplayPort", m_slippiForceNetplayPort);
 	core->Set("SlippiNetplayPort", m_slippiNetplayPort);
@@ -291,6 +302,7 @@ void SConfig::SaveCoreSettings(IniFile &ini)
 	core->Set("SlippiReplayMonthFolders", m_slippiReplayMonthFolders);
 	core->Set("SlippiReplayDir", m_strSlippiReplayDir);
 	core->Set("SlippiPlaybackDisplayFrameIndex", m_slippiEnableFrameIndex);
+	core->Set("SlippiPlaybackSeekInterval", m_slippiPlaybackSeekInterval);
 	core->Set("BlockingPipes", m_blockingPipes);
 	core->Set("MemcardAPath", m_strMemoryCardA);
 	core->Set("MemcardBPath", m_strMemoryCardB);
@@ -618,10 +630,21 @@ void SConfig::LoadCoreSettings(IniFile &ini)
 	core->Get("RSHACK", &bRSHACK, false);
 	core->Get("Latency", &iLatency, 0);
 	core->Get("ReduceTimingDispersion", &bReduceTimingDispersion, false);
+	core->Get("PreciseFramePacing", &bPreciseFramePacing, false);
 	core->Get("SlippiEnableSpectator", &m_enableSpectator, true);
 	core->Get("SlippiSpectatorLocalPort", &m_spectator_local_port, 51441);
 	core->Get("SlippiOnlineDelay", &m_slippiOnlineDelay, 2);
 	core->Get("SlippiSaveReplays", &m_slippiSaveReplays, true);
+	core->Get("SlippiCompressReplays", &m_slippiCompressReplays, false);
+	core->Get("SlippiContinuousTimeSync", &m_slippiContinuousTimeSync, false);
+	core->Get("SlippiNetplayBusyPoll", &m_slippiNetplayBusyPoll, false);
+	core->Get("SlippiNetplayBusyPollCore", &m_slippiNetplayBusyPollCore, -1);
+	core->Get("SlippiCompactPads", &m_slippiCompactPads, true);
+	core->Get("SlippiPadRedundancy", &m_slippiPadRedundancy, 0);
+	core->Get("SlippiLinkSimulator", &m_slippiLinkSimulator, "");
+	core->Get("SlippiOnlineTracePath", &m_slippiOnlineTracePath, "");
+	core->Get("SlippiWriteTimeline", &m_slippiWriteTimeline, false);
+	core->Get("SlippiShowRollbackStats", &m_slippiShowRollbackStats, false);
 	core->Get("SlippiEnableQuickChat", &m_slippiEnableQuickChat, true);
 	core->Get("SlippiForceNetplayPort", &m_slippiForceNetplayPort, false);
 	core->Get("SlippiNetplayPort", &m_slippiNetplayPort, 2626);
@@ -633,6 +656,7 @@ void SConfig::LoadCoreSettings(IniFile &ini)
 	if (m_strSlippiReplayDir.empty())
 		m_strSlippiReplayDir = default_replay_dir;
 	core->Get("SlippiPlaybackDisplayFrameIndex", &m_slippiEnableFrameIndex, false);
+	core->Get("SlippiPlaybackSeekInterval", &m_slippiPlaybackSeekInterval, 900);
 	core->Get("BlockingPipes", &m_blockingPipes, false);
 	core->Get("MemcardAPath", &m_strMemoryCardA);
 	core->Get("MemcardBPath", &m_strMemoryCardB);
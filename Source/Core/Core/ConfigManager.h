@@ -135,6 +135,7 @@ struct SConfig : NonCopyable
 	bool bAdapterWarning = true;
 
 	bool bReduceTimingDispersion = false;
+	bool bPreciseFramePacing = false;
 
 	MeleeLagReductionCode iLagReductionCode = MELEE_LAG_REDUCTION_CODE_UNSET;
 	bool bHasShownLagReductionWarning = false;
@@ -142,6 +143,16 @@ struct SConfig : NonCopyable
 
 	// Slippi
 	bool m_slippiSaveReplays = true;
+	bool m_slippiCompressReplays = false;
+	bool m_slippiContinuousTimeSync = false;
+	bool m_slippiNetplayBusyPoll = false;
+	int m_slippiNetplayBusyPollCore = -1;
+	bool m_slippiCompactPads = true;
+	int m_slippiPadRedundancy = 0;
+	std::string m_slippiLinkSimulator;
+	std::string m_slippiOnlineTracePath;
+	bool m_slippiWriteTimeline = false;
+	bool m_slippiShowRollbackStats = false;
 	bool m_slippiEnableQuickChat = true;
 	bool m_slippiReplayMonthFolders = false;
 	std::string m_strSlippiReplayDir;
@@ -155,6 +166,7 @@ struct SConfig : NonCopyable
 
 	// Slippi Playback
 	bool m_slippiEnableFrameIndex = false;
+	int m_slippiPlaybackSeekInterval = 900;
 
 	bool bDPL2Decoder = false;
 	bool bTimeStretching = false;
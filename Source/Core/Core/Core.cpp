@@ -870,6 +870,7 @@ void VideoThrottle()
 	}
 
 	s_drawn_video++;
+	SystemTimers::RecordFrame();
 	bool update_ss_speed = true;
 	if (SConfig::GetInstance().iVideoRate > 8)
 	{
@@ -921,6 +922,7 @@ void UpdateTitle()
 	float VPS = (float)(s_drawn_video.load() * 1000.0 / ElapseTime);
 	float Speed = (float)(s_drawn_video.load() * (100 * 1000.0) /
 		(VideoInterface::GetTargetRefreshRate() * ElapseTime));
+	const Common::FramePacer::Stats pacing = SystemTimers::TakeFramePacingStats();
 
 	// Settings are shown the same for both extended and summary info
 	std::string SSettings = StringFromFormat(
@@ -962,6 +964,9 @@ void UpdateTitle()
 			SFPS += StringFromFormat(" | CPU: ~%i MHz [Real: %i + IdleSkip: %i] / %i MHz (~%3.0f%%)",
 				(int)(diff), (int)(diff - idleDiff), (int)(idleDiff),
 				SystemTimers::GetTicksPerSecond() / 1000000, TicksPercentage);
+			SFPS += StringFromFormat(" | Frame: %.2f ms (sd %.3f, max %.2f) Late: %.0f us (max %.0f)",
+				pacing.mean_frame_ms, pacing.stddev_frame_ms, pacing.max_frame_ms,
+				pacing.mean_late_us, pacing.max_late_us);
 		}
 	}
 	// This is our final "frame counter" string
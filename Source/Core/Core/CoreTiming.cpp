@@ -19,6 +19,7 @@
 #include "Core/ConfigManager.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
+#include "Core/CoreTimingQueue.h"
 #include "Core/PowerPC/PowerPC.h"
 
 #include "VideoCommon/Fifo.h"
@@ -32,34 +33,13 @@ struct EventType
 	const std::string* name;
 };
 
-struct Event
-{
-	s64 time;
-	u64 fifo_order;
-	u64 userdata;
-	EventType* type;
-};
-
-// Sort by time, unless the times are the same, in which case sort by the order added to the queue
-static bool operator>(const Event& left, const Event& right)
-{
-	return std::tie(left.time, left.fifo_order) > std::tie(right.time, right.fifo_order);
-}
-static bool operator<(const Event& left, const Event& right)
-{
-	return std::tie(left.time, left.fifo_order) < std::tie(right.time, right.fifo_order);
-}
-
 // unordered_map stores each element separately as a linked list node so pointers to elements
 // remain stable regardless of rehashes/resizing.
 static std::unordered_map<std::string, EventType> s_event_types;
 
 // STATE_TO_SAVE
-// The queue is a min-heap using std::make_heap/push_heap/pop_heap.
-// We don't use std::priority_queue because we need to be able to serialize, unserialize and
-// erase arbitrary events (RemoveEvent()) regardless of the queue order. These aren't accomodated
-// by the standard adaptor class.
-static std::vector<Event> s_event_queue;
+// See CoreTimingQueue.h, events pop in (time, fifo_order) order.
+static EventQueue s_event_queue;
 static u64 s_event_fifo_id;
 static std::mutex s_ts_write_lock;
 static Common::FifoQueue<Event, false> s_ts_queue;
@@ -120,7 +100,7 @@ EventType* RegisterEvent(const std::string& name, TimedCallback callback)
 
 void UnregisterAllEvents()
 {
-	_assert_msg_(POWERPC, s_event_queue.empty(), "Cannot unregister events with events pending");
+	_assert_msg_(POWERPC, s_event_queue.Empty(), "Cannot unregister events with events pending");
 	s_event_types.clear();
 }
 
@@ -168,7 +148,11 @@ void DoState(PointerWrap& p)
 	p.DoMarker("CoreTimingData");
 
 	MoveEvents();
-	p.DoEachElement(s_event_queue, [](PointerWrap& pw, Event& ev) {
+	// Saved in pop order so the same queue always makes the same state
+	std::vector<Event> events;
+	if (p.GetMode() != PointerWrap::MODE_READ)
+		events = s_event_queue.GetSortedEvents();
+	p.DoEachElement(events, [](PointerWrap& pw, Event& ev) {
 		pw.Do(ev.time);
 		pw.Do(ev.fifo_order);
 		// this is why we can't have (nice things) pointers as userdata
@@ -201,10 +185,13 @@ void DoState(PointerWrap& p)
 	p.DoMarker("CoreTimingEvents");
 
 	// When loading from a save state, we must assume the Event order is random and meaningless.
-	// The exact layout of the heap in memory is implementation defined, therefore it is platform
-	// and library version specific.
+	// Older states hold the heap in its memory layout, which is platform and library version specific.
 	if (p.GetMode() == PointerWrap::MODE_READ)
-		std::make_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
+	{
+		s_event_queue.Clear();
+		for (const Event& ev : events)
+			s_event_queue.Push(ev);
+	}
 }
 
 // This should only be called from the CPU thread. If you are calling
@@ -227,7 +214,7 @@ u64 GetIdleTicks()
 
 void ClearPendingEvents()
 {
-	s_event_queue.clear();
+	s_event_queue.Clear();
 }
 
 void ScheduleEvent(s64 cycles_into_future, EventType* event_type, u64 userdata, FromThread from)
@@ -254,8 +241,7 @@ void ScheduleEvent(s64 cycles_into_future, EventType* event_type, u64 userdata,
 		if (!s_is_global_timer_sane)
 			ForceExceptionCheck(cycles_into_future);
 
-		s_event_queue.emplace_back(Event{ timeout, s_event_fifo_id++, userdata, event_type });
-		std::push_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
+		s_event_queue.Push(Event{ timeout, s_event_fifo_id++, userdata, event_type });
 	}
 	else
 	{
@@ -273,15 +259,7 @@ void ScheduleEvent(s64 cycles_into_future, EventType* event_type, u64 userdata,
 
 void RemoveEvent(EventType* event_type)
 {
-	auto itr = std::remove_if(s_event_queue.begin(), s_event_queue.end(),
-		[&](const Event& e) { return e.type == event_type; });
-
-	// Removing random items breaks the invariant so we have to re-establish it.
-	if (itr != s_event_queue.end())
-	{
-		s_event_queue.erase(itr, s_event_queue.end());
-		std::make_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
-	}
+	s_event_queue.Remove(event_type);
 }
 
 void RemoveAllEvents(EventType* event_type)
@@ -294,11 +272,9 @@ void RemoveAllEvents(EventType* event_type)
 void ProcessFifoWaitEvents()
 {
 	MoveEvents();
-	while (!s_event_queue.empty() && s_event_queue.front().time <= g_global_timer)
+	while (!s_event_queue.Empty() && s_event_queue.Top().time <= g_global_timer)
 	{
-		Event evt = std::move(s_event_queue.front());
-		std::pop_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
-		s_event_queue.pop_back();
+		Event evt = s_event_queue.Pop();
 		// NOTICE_LOG(POWERPC, "[Scheduler] %-20s (%lld, %lld)", evt.type->name->c_str(),
 		//            g_global_timer, evt.time);
 		evt.type->callback(evt.userdata, g_global_timer - evt.time);
@@ -322,8 +298,7 @@ void MoveEvents()
 	for (Event ev; s_ts_queue.Pop(ev);)
 	{
 		ev.fifo_order = s_event_fifo_id++;
-		s_event_queue.emplace_back(std::move(ev));
-		std::push_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
+		s_event_queue.Push(ev);
 	}
 }
 
@@ -339,11 +314,9 @@ void Advance()
 
 	s_is_global_timer_sane = true;
 
-	while (!s_event_queue.empty() && s_event_queue.front().time <= g_global_timer)
+	while (!s_event_queue.Empty() && s_event_queue.Top().time <= g_global_timer)
 	{
-		Event evt = std::move(s_event_queue.front());
-		std::pop_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
-		s_event_queue.pop_back();
+		Event evt = s_event_queue.Pop();
 		// NOTICE_LOG(POWERPC, "[Scheduler] %-20s (%lld, %lld)", evt.type->name->c_str(),
 		//            g_global_timer, evt.time);
 		evt.type->callback(evt.userdata, g_global_timer - evt.time);
@@ -352,10 +325,10 @@ void Advance()
 	s_is_global_timer_sane = false;
 
 	// Still events left (scheduled in the future)
-	if (!s_event_queue.empty())
+	if (!s_event_queue.Empty())
 	{
 		g_slice_length = static_cast<int>(
-			std::min<s64>(s_event_queue.front().time - g_global_timer, MAX_SLICE_LENGTH));
+			std::min<s64>(s_event_queue.Top().time - g_global_timer, MAX_SLICE_LENGTH));
 	}
 
 	PowerPC::ppcState.downcount = CyclesToDowncount(g_slice_length);
@@ -369,9 +342,7 @@ void Advance()
 
 void LogPendingEvents()
 {
-	auto clone = s_event_queue;
-	std::sort(clone.begin(), clone.end());
-	for (const Event& ev : clone)
+	for (const Event& ev : s_event_queue.GetSortedEvents())
 	{
 		INFO_LOG(POWERPC, "PENDING: Now: %" PRId64 " Pending: %" PRId64 " Type: %s", g_global_timer,
 			ev.time, ev.type->name->c_str());
@@ -397,9 +368,7 @@ std::string GetScheduledEventsSummary()
 	std::string text = "Scheduled events\n";
 	text.reserve(1000);
 
-	auto clone = s_event_queue;
-	std::sort(clone.begin(), clone.end());
-	for (const Event& ev : clone)
+	for (const Event& ev : s_event_queue.GetSortedEvents())
 	{
 		text += StringFromFormat("%s : %" PRIi64 " %016" PRIx64 "\n", ev.type->name->c_str(), ev.time,
 			ev.userdata);
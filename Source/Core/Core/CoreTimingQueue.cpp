@@ -0,0 +1,101 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/CoreTimingQueue.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace CoreTiming
+{
+void EventQueue::Push(const Event& event)
+{
+	m_heap.push_back(event);
+	std::push_heap(m_heap.begin(), m_heap.end(), std::greater<Event>());
+}
+
+Event EventQueue::Pop()
+{
+	std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<Event>());
+	Event event = m_heap.back();
+	m_heap.pop_back();
+	return event;
+}
+
+size_t EventQueue::Remove(EventType* event_type)
+{
+	// Each match is replaced by the last event, which is then sifted into place. Usually only one
+	// event of the type is pending, so this avoids rebuilding the whole heap
+	size_t removed = 0;
+	size_t i = 0;
+	while (i < m_heap.size())
+	{
+		if (m_heap[i].type != event_type)
+		{
+			i++;
+			continue;
+		}
+
+		// The replacement must not be a match itself, sifting could move it before i
+		while (m_heap.back().type == event_type && m_heap.size() - 1 > i)
+		{
+			m_heap.pop_back();
+			removed++;
+		}
+
+		removed++;
+		m_heap[i] = m_heap.back();
+		m_heap.pop_back();
+		if (i == m_heap.size())
+			break;
+
+		// Sifting up only swaps with earlier events, which didn't match. Sifting down brings up a later
+		// event that hasn't been checked yet, so i is looked at again either way
+		if (i > 0 && m_heap[i] < m_heap[(i - 1) / 2])
+			SiftUp(i);
+		else
+			SiftDown(i);
+	}
+
+	return removed;
+}
+
+void EventQueue::SiftUp(size_t index)
+{
+	while (index > 0)
+	{
+		const size_t parent = (index - 1) / 2;
+		if (!(m_heap[index] < m_heap[parent]))
+			break;
+		std::swap(m_heap[index], m_heap[parent]);
+		index = parent;
+	}
+}
+
+void EventQueue::SiftDown(size_t index)
+{
+	const size_t size = m_heap.size();
+	while (true)
+	{
+		const size_t left = 2 * index + 1;
+		if (left >= size)
+			break;
+		size_t smallest = left;
+		if (left + 1 < size && m_heap[left + 1] < m_heap[left])
+			smallest = left + 1;
+		if (!(m_heap[smallest] < m_heap[index]))
+			break;
+		std::swap(m_heap[index], m_heap[smallest]);
+		index = smallest;
+	}
+}
+
+std::vector<Event> EventQueue::GetSortedEvents() const
+{
+	std::vector<Event> events = m_heap;
+	std::sort(events.begin(), events.end());
+	return events;
+}
+}  // namespace CoreTiming
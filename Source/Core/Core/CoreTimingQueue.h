@@ -0,0 +1,63 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstddef>
+#include <tuple>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+namespace CoreTiming
+{
+struct EventType;
+
+struct Event
+{
+	s64 time;
+	u64 fifo_order;
+	u64 userdata;
+	EventType* type;
+};
+
+// Sort by time, unless the times are the same, in which case sort by the order added to the queue
+inline bool operator>(const Event& left, const Event& right)
+{
+	return std::tie(left.time, left.fifo_order) > std::tie(right.time, right.fifo_order);
+}
+inline bool operator<(const Event& left, const Event& right)
+{
+	return std::tie(left.time, left.fifo_order) < std::tie(right.time, right.fifo_order);
+}
+
+// Min-heap of pending events, kept with std::push_heap/pop_heap on a vector. At the few dozen events
+// CoreTiming has pending that beats anything fancier. It isn't a std::priority_queue because events
+// have to be serialized and erased by type regardless of the queue order.
+class EventQueue
+{
+public:
+	void Push(const Event& event);
+	// Both require the queue not to be empty
+	const Event& Top() const { return m_heap.front(); }
+	Event Pop();
+
+	bool Empty() const { return m_heap.empty(); }
+	size_t Size() const { return m_heap.size(); }
+	void Clear() { m_heap.clear(); }
+
+	// Removes every event of the type, returns how many were removed
+	size_t Remove(EventType* event_type);
+
+	// Every pending event in pop order
+	std::vector<Event> GetSortedEvents() const;
+
+private:
+	// Restore the heap around an element that was replaced
+	void SiftUp(size_t index);
+	void SiftDown(size_t index);
+
+	std::vector<Event> m_heap;
+};
+}  // namespace CoreTiming
@@ -4,11 +4,14 @@
 
 #include "Core/Debugger/Debugger_SymbolMap.h"
 
+#include "Core/Slippi/SlippiBatchStats.h"
 #include "Core/Slippi/SlippiPlayback.h"
 #include "Core/Slippi/SlippiPremadeText.h"
 #include "Core/Slippi/SlippiReplayComm.h"
 #include <SlippiGame.h>
+#include <open-vcdiff/src/google/vcencoder.h>
 #include <semver/include/semver200.h>
+#include <future>
 #include <utility> // std::move
 
 #include "Common/CommonPaths.h"
@@ -28,6 +31,7 @@
 #include "Core/HW/EXI_DeviceSlippi.h"
 #include "Core/HW/SystemTimers.h"
 #include "Core/State.h"
+#include "VideoCommon/OnScreenDisplay.h"
 
 #include "Core/GeckoCode.h"
 //#include "Core/PatchEngine.h"
@@ -39,8 +43,13 @@
 
 #define FRAME_INTERVAL 900
 #define SLEEP_TIME_MS 8
+#define LIVE_REPLAY_WAIT_MS 8
 #define WRITE_FILE_SLEEP_TIME_MS 85
 
+// Wake the write thread early once this much replay data is waiting
+#define WRITE_FLUSH_THRESHOLD (64 * 1024)
+#define WRITE_BUFFER_RESERVE (256 * 1024)
+
 //#define LOCAL_TESTING
 //#define CREATE_DIFF_FILES
 
@@ -49,6 +58,7 @@ static std::unordered_map<u8, std::string> slippi_connect_codes;
 
 extern std::unique_ptr<SlippiPlaybackStatus> g_playbackStatus;
 extern std::unique_ptr<SlippiReplayComm> g_replayComm;
+extern std::unique_ptr<SlippiBatchStats> g_batchStats;
 
 #ifdef LOCAL_TESTING
 bool isLocalConnected = false;
@@ -133,6 +143,7 @@ CEXISlippi::CEXISlippi()
 	g_playbackStatus = std::make_unique<SlippiPlaybackStatus>();
 	matchmaking = std::make_unique<SlippiMatchmaking>(user.get());
 	gameFileLoader = std::make_unique<SlippiGameFileLoader>();
+	gameFileLoader->Prefetch(SConfig::GetInstance().m_LastFilename);
 	gameReporter = std::make_unique<SlippiGameReporter>(user.get());
 	g_replayComm = std::make_unique<SlippiReplayComm>();
 	directCodes = std::make_unique<SlippiDirectCodes>("direct-codes.json");
@@ -265,8 +276,12 @@ CEXISlippi::~CEXISlippi()
 	// Closes file gracefully to prevent file corruption when emulation
 	// suddenly stops. This would happen often on netplay when the opponent
 	// would close the emulation before the file successfully finished writing
-	writeToFileAsync(&empty[0], 0, "close");
-	writeThreadRunning = false;
+	writeToFileAsync(&empty[0], 0, WRITE_OP_CLOSE);
+	{
+		std::lock_guard<std::mutex> lk(writeMutex);
+		writeThreadRunning = false;
+	}
+	writeEvent.Set();
 	if (m_fileWriteThread.joinable())
 	{
 		m_fileWriteThread.join();
@@ -432,16 +447,19 @@ std::vector<u8> CEXISlippi::generateMetadata()
 	return metadata;
 }
 
-void CEXISlippi::writeToFileAsync(u8 *payload, u32 length, std::string fileOption)
+void CEXISlippi::writeToFileAsync(u8 *payload, u32 length, WriteOperation operation)
 {
 	if (!SConfig::GetInstance().m_slippiSaveReplays)
 	{
 		return;
 	}
 
-	if (fileOption == "create" && !writeThreadRunning)
+	if (operation == WRITE_OP_CREATE && !writeThreadRunning)
 	{
 		WARN_LOG(SLIPPI, "Creating file write thread...");
+		pendingWrites.reserve(WRITE_BUFFER_RESERVE);
+		processingWrites.reserve(WRITE_BUFFER_RESERVE);
+		fileWriteBuffer.reserve(WRITE_BUFFER_RESERVE);
 		writeThreadRunning = true;
 		m_fileWriteThread = std::thread(&CEXISlippi::FileWriteThread, this);
 	}
@@ -451,59 +469,75 @@ void CEXISlippi::writeToFileAsync(u8 *payload, u32 length, std::string fileOptio
 		return;
 	}
 
-	std::vector<u8> payloadData;
-	payloadData.insert(payloadData.end(), payload, payload + length);
+	bool shouldWake;
+	{
+		std::lock_guard<std::mutex> lk(writeMutex);
 
-	auto writeMsg = std::make_unique<WriteMessage>();
-	writeMsg->data = payloadData;
-	writeMsg->operation = fileOption;
+		size_t pos = pendingWrites.size();
+		pendingWrites.resize(pos + 5 + length);
+		pendingWrites[pos] = operation;
+		memcpy(&pendingWrites[pos + 1], &length, 4);
+		if (length)
+			memcpy(&pendingWrites[pos + 5], payload, length);
 
-	fileWriteQueue.Push(std::move(writeMsg));
+		shouldWake = operation != WRITE_OP_DATA || pendingWrites.size() >= WRITE_FLUSH_THRESHOLD;
+	}
+
+	if (shouldWake)
+		writeEvent.Set();
 }
 
 void CEXISlippi::FileWriteThread(void)
 {
-	while (writeThreadRunning || !fileWriteQueue.Empty())
+	Common::SetCurrentThreadName("Slippi replay writer");
+
+	bool isRunning = true;
+	while (isRunning)
 	{
-		// Process all messages
-		while (!fileWriteQueue.Empty())
+		// Partial games still get written out regularly so tools reading the file live keep up
+		writeEvent.WaitFor(std::chrono::milliseconds(WRITE_FILE_SLEEP_TIME_MS));
+
 		{
-			writeToFile(std::move(fileWriteQueue.Front()));
-			fileWriteQueue.Pop();
+			std::lock_guard<std::mutex> lk(writeMutex);
+			std::swap(pendingWrites, processingWrites);
+			isRunning = writeThreadRunning;
+		}
 
-			Common::SleepCurrentThread(0);
+		size_t pos = 0;
+		while (pos + 5 <= processingWrites.size())
+		{
+			auto operation = (WriteOperation)processingWrites[pos];
+			u32 length;
+			memcpy(&length, &processingWrites[pos + 1], 4);
+
+			writeToFile(length ? &processingWrites[pos + 5] : nullptr, length, operation);
+			pos += 5 + length;
 		}
 
-		Common::SleepCurrentThread(WRITE_FILE_SLEEP_TIME_MS);
+		processingWrites.clear();
+		flushFileWriteBuffer();
 	}
 }
 
-void CEXISlippi::writeToFile(std::unique_ptr<WriteMessage> msg)
+void CEXISlippi::writeToFile(u8 *payload, u32 length, WriteOperation operation)
 {
-	if (!msg)
-	{
-		ERROR_LOG(SLIPPI, "Unexpected error: write message is falsy.");
-		return;
-	}
-
-	u8 *payload = &msg->data[0];
-	u32 length = (u32)msg->data.size();
-	std::string fileOption = msg->operation;
-
-	std::vector<u8> dataToWrite;
-	if (fileOption == "create")
+	if (operation == WRITE_OP_CREATE)
 	{
 		// If the game sends over option 1 that means a file should be created
+		flushFileWriteBuffer();
 		createNewFile();
 
 		// Start ubjson file and prepare the "raw" element that game
 		// data output will be dumped into. The size of the raw output will
 		// be initialized to 0 until all of the data has been received
 		std::vector<u8> headerBytes({'{', 'U', 3, 'r', 'a', 'w', '[', '$', 'U', '#', 'l', 0, 0, 0, 0});
-		dataToWrite.insert(dataToWrite.end(), headerBytes.begin(), headerBytes.end());
+		if (isCompressingReplay)
+			replayCompressor.Start(fileWriteBuffer);
+		appendFileData(&headerBytes[0], (u32)headerBytes.size(), SlippiReplayCompressor::NO_FRAME);
 
 		// Used to keep track of how many bytes have been written to the file
 		writtenByteCount = 0;
+		fileWriteCount = 0;
 
 		// Used to track character usage (sheik/zelda)
 		characterUsage.clear();
@@ -533,41 +567,82 @@ void CEXISlippi::writeToFile(std::unique_ptr<WriteMessage> msg)
 	// Update fields relevant to generating metadata at the end
 	updateMetadataFields(payload, length);
 
-	// Add the payload to data to write
-	dataToWrite.insert(dataToWrite.end(), payload, payload + length);
+	// Add the payload to data to write, the compressed container indexes blocks by frame
+	s32 frame = SlippiReplayCompressor::NO_FRAME;
+	if (length >= 5 && (payload[0] == CMD_RECEIVE_PRE_FRAME_UPDATE || payload[0] == CMD_RECEIVE_POST_FRAME_UPDATE ||
+	                    payload[0] == CMD_FRAME_BOOKEND))
+	{
+		frame = payload[1] << 24 | payload[2] << 16 | payload[3] << 8 | payload[4];
+	}
+	appendFileData(payload, length, frame);
 	writtenByteCount += length;
 
 	// If we are going to close the file, generate data to complete the UBJSON file
-	if (fileOption == "close")
+	if (operation == WRITE_OP_CLOSE)
 	{
 		// This option indicates we are done sending over body
 		std::vector<u8> closingBytes = generateMetadata();
 		closingBytes.push_back('}');
-		dataToWrite.insert(dataToWrite.end(), closingBytes.begin(), closingBytes.end());
+		appendFileData(&closingBytes[0], (u32)closingBytes.size(), SlippiReplayCompressor::NO_FRAME);
 
 		// Reset display names and connect codes retrieved from netplay client
 		slippi_names.clear();
 		slippi_connect_codes.clear();
+
+		// Compressed replays can't be patched afterwards, the block index holds the raw length instead
+		if (isCompressingReplay)
+			replayCompressor.Finish(writtenByteCount, fileWriteBuffer);
+
+		flushFileWriteBuffer();
+
+		if (!isCompressingReplay)
+		{
+			// Write the number of bytes for the raw output
+			std::vector<u8> sizeBytes = uint32ToVector(writtenByteCount);
+			m_file.Seek(11, 0);
+			m_file.WriteBytes(&sizeBytes[0], sizeBytes.size());
+		}
+
+		u32 frameCount = std::max(1, lastFrame - Slippi::GAME_FIRST_FRAME + 1);
+		INFO_LOG(SLIPPI, "Replay writer: %u bytes in %u writes over %u frames (%.1f bytes, %.3f writes per frame)",
+		         writtenByteCount, fileWriteCount, frameCount, (double)writtenByteCount / frameCount,
+		         (double)fileWriteCount / frameCount);
+
+		// Close file
+		closeFile();
 	}
+}
 
-	// Write data to file
-	bool result = m_file.WriteBytes(&dataToWrite[0], dataToWrite.size());
-	if (!result)
+void CEXISlippi::appendFileData(const u8 *data, u32 length, s32 frame)
+{
+	if (isCompressingReplay)
 	{
-		ERROR_LOG(EXPANSIONINTERFACE, "Failed to write data to file.");
+		replayCompressor.Append(data, length, frame, fileWriteBuffer);
+		return;
 	}
 
-	// If file should be closed, close it
-	if (fileOption == "close")
+	fileWriteBuffer.insert(fileWriteBuffer.end(), data, data + length);
+}
+
+void CEXISlippi::flushFileWriteBuffer()
+{
+	if (fileWriteBuffer.empty())
 	{
-		// Write the number of bytes for the raw output
-		std::vector<u8> sizeBytes = uint32ToVector(writtenByteCount);
-		m_file.Seek(11, 0);
-		m_file.WriteBytes(&sizeBytes[0], sizeBytes.size());
+		return;
+	}
 
-		// Close file
-		closeFile();
+	if (m_file)
+	{
+		bool result = m_file.WriteBytes(&fileWriteBuffer[0], fileWriteBuffer.size());
+		if (!result)
+		{
+			ERROR_LOG(EXPANSIONINTERFACE, "Failed to write data to file.");
+		}
+
+		fileWriteCount++;
 	}
+
+	fileWriteBuffer.clear();
 }
 
 void CEXISlippi::createNewFile()
@@ -614,6 +689,9 @@ void CEXISlippi::createNewFile()
 		File::CreateDir(dirpath);
 	}
 
+	// Only look at the setting when a file gets created so a game never switches format halfway through
+	isCompressingReplay = SConfig::GetInstance().m_slippiCompressReplays;
+
 	std::string filepath = dirpath + DIR_SEP + generateFileName();
 	INFO_LOG(SLIPPI, "EXI_DeviceSlippi.cpp: Creating new replay file %s", filepath.c_str());
 
@@ -642,7 +720,7 @@ std::string CEXISlippi::generateFileName()
 	strftime(&dateTimeBuf[0], dateTimeStrLength, "%Y%m%dT%H%M%S", localtime(&gameStartTime));
 
 	std::string str(&dateTimeBuf[0]);
-	return StringFromFormat("Game_%s.slp", str.c_str());
+	return StringFromFormat("Game_%s.%s", str.c_str(), isCompressingReplay ? "slpz" : "slp");
 }
 
 void CEXISlippi::closeFile()
@@ -789,23 +867,12 @@ void CEXISlippi::prepareGameInfo(u8 *payload)
 	if (replayCommSettings.rollbackDisplayMethod != "off")
 	{
 		// Prepare savestates
-		availableSavestates.clear();
-		activeSavestates.clear();
-
-		// Prepare savestates for online play
-		for (int i = 0; i < ROLLBACK_MAX_FRAMES; i++)
-		{
-			availableSavestates.push_back(std::make_unique<SlippiSavestate>());
-		}
+		savestates = std::make_unique<SlippiSavestate>(ROLLBACK_MAX_FRAMES);
 	}
 	else
 	{
-		// Prepare savestates
-		availableSavestates.clear();
-		activeSavestates.clear();
-
 		// Add savestate for testing
-		availableSavestates.push_back(std::make_unique<SlippiSavestate>());
+		savestates = std::make_unique<SlippiSavestate>(1);
 	}
 
 	// Reset playback frame to begining
@@ -813,7 +880,7 @@ void CEXISlippi::prepareGameInfo(u8 *payload)
 
 	// Initialize replay related threads if not viewing rollback versions of relays
 	if (replayCommSettings.rollbackDisplayMethod == "off" &&
-	    (replayCommSettings.mode == "normal" || replayCommSettings.mode == "queue"))
+	    (replayCommSettings.mode == "normal" || replayCommSettings.mode == "queue") && !g_batchStats)
 	{
 		g_playbackStatus->startThreads();
 	}
@@ -1186,14 +1253,11 @@ void CEXISlippi::prepareGeckoList()
 
 void CEXISlippi::prepareCharacterFrameData(Slippi::FrameData *frame, u8 port, u8 isFollower)
 {
-	std::unordered_map<uint8_t, Slippi::PlayerFrameData> source;
-	source = isFollower ? frame->followers : frame->players;
-
 	// This must be updated if new data is added
 	int characterDataLen = 49;
 
 	// Check if player exists
-	if (!source.count(port))
+	if (!frame->HasPlayer(port, isFollower))
 	{
 		// If player does not exist, insert blank section
 		m_read_queue.insert(m_read_queue.end(), characterDataLen, 0);
@@ -1201,7 +1265,7 @@ void CEXISlippi::prepareCharacterFrameData(Slippi::FrameData *frame, u8 port, u8
 	}
 
 	// Get data for this player
-	Slippi::PlayerFrameData data = source[port];
+	const Slippi::PlayerFrameData &data = isFollower ? frame->followers[port] : frame->players[port];
 
 	// log << frameIndex << "\t" << port << "\t" << data.locationX << "\t" << data.locationY << "\t" <<
 	// data.animation
@@ -1292,15 +1356,29 @@ void CEXISlippi::prepareFrameData(u8 *payload)
 		return;
 	}
 
-	auto isProcessingComplete = m_current_game->IsProcessingComplete();
+	auto commSettings = g_replayComm->getSettings();
+
 	// Wait until frame exists in our data before reading it. We also wait until
 	// next frame has been found to ensure we have actually received all of the
 	// data from this frame. Don't wait until next frame is processing is complete
 	// (this is the last frame, in that case)
-	auto isFrameFound = m_current_game->DoesFrameExist(frameIndex);
+	bool isProcessingComplete, isFrameFound, isFrameReady;
+	u64 liveWaitEndUs = Common::Timer::GetTimeUs() + LIVE_REPLAY_WAIT_MS * 1000;
+	while (true)
+	{
+		isProcessingComplete = m_current_game->IsProcessingComplete();
+		isFrameFound = m_current_game->DoesFrameExist(frameIndex);
+		isFrameReady = isFrameFound && (isProcessingComplete || checkFrameFullyFetched(frameIndex));
+		if (isFrameReady || isProcessingComplete || commSettings.mode != "mirror")
+			break;
+
+		// A mirrored game is usually only a moment away from having the frame, waiting for the writer here
+		// is a lot sooner than the game asking again next frame
+		u64 nowUs = Common::Timer::GetTimeUs();
+		if (nowUs >= liveWaitEndUs || !m_current_game->WaitForData((u32)((liveWaitEndUs - nowUs + 999) / 1000)))
+			break;
+	}
 	g_playbackStatus->latestFrame = m_current_game->GetLatestIndex();
-	auto isFrameComplete = checkFrameFullyFetched(frameIndex);
-	auto isFrameReady = isFrameFound && (isProcessingComplete || isFrameComplete);
 
 	// If there is a startFrame configured, manage the fast-forward flag
 	if (watchSettings.startFrame > Slippi::GAME_FIRST_FRAME)
@@ -1316,7 +1394,6 @@ void CEXISlippi::prepareFrameData(u8 *payload)
 		}
 	}
 
-	auto commSettings = g_replayComm->getSettings();
 	if (commSettings.rollbackDisplayMethod == "normal")
 	{
 		auto nextFrame = m_current_game->GetFrameAt(frameSeqIdx);
@@ -1355,13 +1432,15 @@ void CEXISlippi::prepareFrameData(u8 *payload)
 		g_playbackStatus->setHardFFW(false);
 	}
 
-	bool shouldFFW = g_playbackStatus->shouldFFWFrame(frameIndex);
+	// Batch playback fast forwards every frame so the game skips rendering entirely
+	bool shouldFFW = g_batchStats || g_playbackStatus->shouldFFWFrame(frameIndex);
 	u8 requestResultCode = shouldFFW ? FRAME_RESP_FASTFORWARD : FRAME_RESP_CONTINUE;
 	if (!isFrameReady)
 	{
 		// If processing is complete, the game has terminated early. Tell our playback
-		// to end the game as well.
-		auto shouldTerminateGame = isProcessingComplete;
+		// to end the game as well. Batch replays are never still being written so a
+		// missing frame there means the file is truncated
+		auto shouldTerminateGame = isProcessingComplete || g_batchStats;
 		requestResultCode = shouldTerminateGame ? FRAME_RESP_TERMINATE : FRAME_RESP_WAIT;
 		m_read_queue.push_back(requestResultCode);
 
@@ -1404,6 +1483,9 @@ void CEXISlippi::prepareFrameData(u8 *payload)
 	// Return success code
 	m_read_queue.push_back(requestResultCode);
 
+	if (g_batchStats)
+		g_batchStats->FramePlayed();
+
 	// Get frame
 	Slippi::FrameData *frame = m_current_game->GetFrame(frameIndex);
 	if (commSettings.rollbackDisplayMethod != "off")
@@ -1474,9 +1556,8 @@ void CEXISlippi::prepareIsStockSteal(u8 *payload)
 
 	// Load the data from this frame into the read buffer
 	Slippi::FrameData *frame = m_current_game->GetFrame(frameIndex);
-	auto players = frame->players;
 
-	u8 playerIsBack = players.count(playerIndex) ? 1 : 0;
+	u8 playerIsBack = frame->HasPlayer(playerIndex, false) ? 1 : 0;
 	m_read_queue.push_back(playerIsBack);
 }
 
@@ -1487,6 +1568,13 @@ void CEXISlippi::prepareIsFileReady()
 	auto isNewReplay = g_replayComm->isNewReplay();
 	if (!isNewReplay)
 	{
+		if (g_batchStats)
+		{
+			g_batchStats->EndGame();
+			if (g_replayComm->getSettings().queue.empty())
+				g_batchStats->Finish();
+		}
+
 		g_replayComm->nextReplay();
 		m_read_queue.push_back(0);
 		return;
@@ -1494,15 +1582,28 @@ void CEXISlippi::prepareIsFileReady()
 
 	// Attempt to load game if there is a new replay file
 	// this can come pack falsy if the replay file does not exist
+	u64 loadStartTime = Common::Timer::GetTimeUs();
 	m_current_game = g_replayComm->loadGame();
 	if (!m_current_game)
 	{
 		// Do not start if replay file doesn't exist
 		// TODO: maybe display error message?
 		INFO_LOG(SLIPPI, "EXI_DeviceSlippi.cpp: Replay file does not exist?");
+
+		// A batch can't wait for the file to show up, skip to the next replay instead
+		if (g_batchStats && !g_replayComm->getSettings().queue.empty())
+		{
+			g_batchStats->FailGame(g_replayComm->getSettings().queue.front().path);
+			g_replayComm->nextReplay();
+		}
+
 		m_read_queue.push_back(0);
 		return;
 	}
+
+	if (g_batchStats)
+		g_batchStats->StartGame(g_replayComm->current.path, m_current_game.get(),
+		                        Common::Timer::GetTimeUs() - loadStartTime);
 #ifdef IS_PLAYBACK
 	if (shouldOutput)
 	{
@@ -1545,17 +1646,12 @@ void CEXISlippi::handleOnlineInputs(u8 *payload)
 	m_read_queue.clear();
 
 	int32_t frame = payload[0] << 24 | payload[1] << 16 | payload[2] << 8 | payload[3];
+	u64 inputsStartUs = Common::Timer::GetTimeUs();
 
 	if (frame == 1)
 	{
-		availableSavestates.clear();
-		activeSavestates.clear();
-
 		// Prepare savestates for online play
-		for (int i = 0; i < ROLLBACK_MAX_FRAMES; i++)
-		{
-			availableSavestates.push_back(std::make_unique<SlippiSavestate>());
-		}
+		savestates = std::make_unique<SlippiSavestate>(ROLLBACK_MAX_FRAMES);
 
 		// Reset stall counter
 		isConnectionStalled = false;
@@ -1565,6 +1661,37 @@ void CEXISlippi::handleOnlineInputs(u8 *payload)
 		localSelections.Reset();
 		if (slippi_netplay)
 			slippi_netplay->StartSlippiGame();
+
+		const SConfig &config = SConfig::GetInstance();
+		if (!config.m_slippiOnlineTracePath.empty())
+		{
+			if (!onlineTrace)
+				onlineTrace =
+				    std::make_unique<SlippiOnlineTrace>(config.m_slippiOnlineTracePath, config.m_slippiLinkSimulator);
+			onlineTrace->StartGame();
+		}
+
+		if (!frameTimeline)
+			frameTimeline = std::make_unique<SlippiFrameTimeline>();
+		frameTimeline->StartGame();
+	}
+
+	if (onlineTrace)
+		onlineTrace->Frame(frame);
+
+	if (frameTimeline)
+	{
+		frameTimeline->InputsRequested(frame, inputsStartUs);
+
+		if (SConfig::GetInstance().m_slippiShowRollbackStats && frame % ROLLBACK_STATS_DISPLAY_INTERVAL == 0)
+		{
+			std::string summary = frameTimeline->TakeRollbackSummary();
+			if (!summary.empty())
+			{
+				OSD::AddTypedMessage(OSD::MessageType::RollbackStats, summary, OSD::Duration::VERY_LONG,
+				                     OSD::Color::CYAN);
+			}
+		}
 	}
 
 	if (isDisconnected())
@@ -1582,7 +1709,26 @@ void CEXISlippi::handleOnlineInputs(u8 *payload)
 	}
 
 	handleSendInputs(payload);
+	u64 sendEndUs = Common::Timer::GetTimeUs();
 	prepareOpponentInputs(payload);
+
+	if (frameTimeline)
+	{
+		frameTimeline->Record(SlippiFrameTimeline::PHASE_SEND_INPUTS, frame, inputsStartUs, sendEndUs);
+		frameTimeline->Record(SlippiFrameTimeline::PHASE_PREPARE_INPUTS, frame, sendEndUs, Common::Timer::GetTimeUs());
+	}
+}
+
+void CEXISlippi::writeFrameTimeline()
+{
+	if (!frameTimeline || !SConfig::GetInstance().m_slippiWriteTimeline)
+		return;
+
+	std::string path = File::GetUserPath(D_LOGS_IDX) + StringFromFormat("SlippiTimeline-%lld.json", (long long)time(0));
+	if (frameTimeline->WriteChromeTrace(path))
+		INFO_LOG(SLIPPI_ONLINE, "Wrote frame timeline to %s", path.c_str());
+	else
+		ERROR_LOG(SLIPPI_ONLINE, "Failed to write frame timeline to %s", path.c_str());
 }
 
 bool CEXISlippi::shouldSkipOnlineFrame(s32 frame)
@@ -1615,11 +1761,31 @@ bool CEXISlippi::shouldSkipOnlineFrame(s32 frame)
 
 		WARN_LOG(SLIPPI_ONLINE, "Halting for one frame due to rollback limit (frame: %d | latest: %d)...", frame,
 		         latestRemoteFrame);
+		if (onlineTrace)
+			onlineTrace->Stall(frame, latestRemoteFrame);
 		return true;
 	}
 
 	stallFrameCount = 0;
 
+	// In continuous mode the frame pacer is held back by a few microseconds every frame to stay in step.
+	// Whole frames are still skipped at the start of the game and when the offset is too big to steer
+	SlippiTimeSync &timeSync = slippi_netplay->GetTimeSync();
+	bool isContinuousSync = SConfig::GetInstance().m_slippiContinuousTimeSync && frame > 120;
+	if (isContinuousSync && !isCurrentlySkipping)
+	{
+		SystemTimers::NudgeThrottle(timeSync.Update());
+
+		if (frame % SLIPPI_ONLINE_LOCKSTEP_INTERVAL == 0)
+		{
+			auto state = timeSync.GetState();
+			INFO_LOG(SLIPPI_ONLINE, "[Frame %d] Time sync offset: %d us (+/- %d), noise: %d us, nudge: %d us, "
+			                        "total: %lld us",
+			         frame, state.errorUs, state.deviationUs[0], state.noiseUs[0], state.nudgeUs,
+			         (long long)state.totalNudgeUs);
+		}
+	}
+
 	// Return true if we are over 60% of a frame ahead of our opponent. Currently limiting how
 	// often this happens because I'm worried about jittery data causing a lot of unneccesary delays.
 	// Only skip once for a given frame because our time detection method doesn't take into consideration
@@ -1628,20 +1794,24 @@ bool CEXISlippi::shouldSkipOnlineFrame(s32 frame)
 	auto isTimeSyncFrame = frame % SLIPPI_ONLINE_LOCKSTEP_INTERVAL; // Only time sync every 30 frames
 	if (isTimeSyncFrame == 0 && !isCurrentlySkipping)
 	{
-		auto offsetUs = slippi_netplay->CalcTimeOffsetUs();
+		auto offsetUs = isContinuousSync ? timeSync.GetOffsetUs() : slippi_netplay->CalcTimeOffsetUs();
+		auto skipThresholdUs = isContinuousSync ? 25000 : 10000;
 		//INFO_LOG(SLIPPI_ONLINE, "[Frame %d] Offset is: %d us", frame, offsetUs);
 
 		// TODO: figure out a better solution here for doubles?
-		if (offsetUs > 10000)
+		if (offsetUs > skipThresholdUs)
 		{
 			isCurrentlySkipping = true;
 
 			int maxSkipFrames = frame <= 120 ? 5 : 1; // On early frames, support skipping more frames
-			framesToSkip = ((offsetUs - 10000) / 16683) + 1;
+			framesToSkip = ((offsetUs - skipThresholdUs) / 16683) + 1;
 			framesToSkip = framesToSkip > maxSkipFrames ? maxSkipFrames : framesToSkip; // Only skip 5 frames max
+			timeSync.ShiftLocalTime(framesToSkip * 16683);
 
 			WARN_LOG(SLIPPI_ONLINE, "Halting on frame %d due to time sync. Offset: %d us. Frames: %d...", frame,
 			         offsetUs, framesToSkip);
+			if (onlineTrace)
+				onlineTrace->TimeSyncSkip(frame, offsetUs, framesToSkip);
 		}
 	}
 
@@ -1673,20 +1843,18 @@ void CEXISlippi::handleSendInputs(u8 *payload)
 	{
 		for (int i = 1; i <= delay; i++)
 		{
-			auto empty = std::make_unique<SlippiPad>(i);
-			slippi_netplay->SendSlippiPad(std::move(empty));
+			SlippiPad empty(i);
+			slippi_netplay->SendSlippiPad(&empty);
 		}
 	}
 
-	auto pad = std::make_unique<SlippiPad>(frame + delay, &payload[5]);
+	SlippiPad pad(frame + delay, &payload[5]);
 
-	slippi_netplay->SendSlippiPad(std::move(pad));
+	slippi_netplay->SendSlippiPad(&pad);
 }
 
 void CEXISlippi::prepareOpponentInputs(u8 *payload)
 {
-	m_read_queue.clear();
-
 	u8 frameResult = 1; // Indicates to continue frame
 
 	auto state = slippi_netplay->GetSlippiConnectStatus();
@@ -1695,59 +1863,41 @@ void CEXISlippi::prepareOpponentInputs(u8 *payload)
 		frameResult = 3; // Indicates we have disconnected
 	}
 
-	m_read_queue.push_back(frameResult); // Indicate a continue frame
-
 	u8 remotePlayerCount = matchmaking->RemotePlayerCount();
-	m_read_queue.push_back(remotePlayerCount); // Indicate the number of remote players
 
 	int32_t frame = payload[0] << 24 | payload[1] << 16 | payload[2] << 8 | payload[3];
 
-	std::unique_ptr<SlippiRemotePadOutput> results[SLIPPI_REMOTE_PLAYER_MAX];
-	int offset[SLIPPI_REMOTE_PLAYER_MAX];
+	// Layout is the frame result, the remote player count, the latest frame of each remote player and then
+	// ROLLBACK_MAX_FRAMES pads for each of them. Everything is written in place so nothing gets allocated
+	const size_t framesPos = 2;
+	const size_t padsPos = framesPos + 4 * SLIPPI_REMOTE_PLAYER_MAX;
+	const size_t padsSize = SLIPPI_PAD_FULL_SIZE * ROLLBACK_MAX_FRAMES;
+	m_read_queue.resize(padsPos + padsSize * SLIPPI_REMOTE_PLAYER_MAX);
+	m_read_queue[0] = frameResult;       // Indicate a continue frame
+	m_read_queue[1] = remotePlayerCount; // Indicate the number of remote players
 	//INFO_LOG(SLIPPI_ONLINE, "Preparing pad data for frame %d", frame);
 
 	int32_t latestFrameRead[SLIPPI_REMOTE_PLAYER_MAX]{};
 
 	// Get pad data for each remote player and write each of their latest frame nums to the buf
-	for (int i = 0; i < remotePlayerCount; i++)
-	{
-		results[i] = slippi_netplay->GetSlippiRemotePad(frame, i);
-
-		// determine offset from which to copy data
-		offset[i] = (results[i]->latestFrame - frame) * SLIPPI_PAD_FULL_SIZE;
-		offset[i] = offset[i] < 0 ? 0 : offset[i];
-
-		// add latest frame we are transfering to begining of return buf
-		int32_t latestFrame = results[i]->latestFrame;
-		if (latestFrame > frame)
-			latestFrame = frame;
-		latestFrameRead[i] = latestFrame;
-		appendWordToBuffer(&m_read_queue, *(u32 *)&latestFrame);
-		// INFO_LOG(SLIPPI_ONLINE, "Sending frame num %d for pIdx %d (offset: %d)", latestFrame, i, offset[i]);
-	}
-	// Send the current frame for any unused player slots.
-	for (int i = remotePlayerCount; i < SLIPPI_REMOTE_PLAYER_MAX; i++)
-	{
-		latestFrameRead[i] = frame;
-		appendWordToBuffer(&m_read_queue, *(u32 *)&frame);
-	}
-
-	// copy pad data over
 	for (int i = 0; i < SLIPPI_REMOTE_PLAYER_MAX; i++)
 	{
-		std::vector<u8> tx;
+		u8 *pads = &m_read_queue[padsPos + i * padsSize];
 
-		// Get pad data if this remote player exists
+		// Send the current frame and no inputs for any unused player slots
+		int32_t latestFrame = frame;
 		if (i < remotePlayerCount)
-		{
-			auto txStart = results[i]->data.begin() + offset[i];
-			auto txEnd = results[i]->data.end();
-			tx.insert(tx.end(), txStart, txEnd);
-		}
-
-		tx.resize(SLIPPI_PAD_FULL_SIZE * ROLLBACK_MAX_FRAMES, 0);
+			latestFrame = slippi_netplay->GetSlippiRemotePad(frame, i, pads, ROLLBACK_MAX_FRAMES);
+		else
+			memset(pads, 0, padsSize);
 
-		m_read_queue.insert(m_read_queue.end(), tx.begin(), tx.end());
+		latestFrameRead[i] = latestFrame;
+		u8 *framePos = &m_read_queue[framesPos + i * 4];
+		framePos[0] = latestFrame >> 24;
+		framePos[1] = (latestFrame >> 16) & 0xFF;
+		framePos[2] = (latestFrame >> 8) & 0xFF;
+		framePos[3] = latestFrame & 0xFF;
+		// INFO_LOG(SLIPPI_ONLINE, "Sending frame num %d for pIdx %d", latestFrame, i);
 	}
 
 	// the latest read frame instead of the current frame must be passed to avoid nuking inputs
@@ -1770,32 +1920,17 @@ void CEXISlippi::handleCaptureSavestate(u8 *payload)
 
 	u64 startTime = Common::Timer::GetTimeUs();
 
-	// Grab an available savestate
-	std::unique_ptr<SlippiSavestate> ss;
-	if (!availableSavestates.empty())
-	{
-		ss = std::move(availableSavestates.back());
-		availableSavestates.pop_back();
-	}
-	else
-	{
-		// If there were no available savestates, use the oldest one
-		auto it = activeSavestates.begin();
-		ss = std::move(it->second);
-		activeSavestates.erase(it->first);
-	}
+	savestates->Capture(frame);
 
-	// If there is already a savestate for this frame, remove it and add it to available
-	if (activeSavestates.count(frame))
+	u64 endTime = Common::Timer::GetTimeUs();
+	u32 timeDiff = (u32)(endTime - startTime);
+	if (onlineTrace)
+		onlineTrace->Capture(timeDiff);
+	if (frameTimeline)
 	{
-		availableSavestates.push_back(std::move(activeSavestates[frame]));
-		activeSavestates.erase(frame);
+		frameTimeline->Captured(frame, startTime);
+		frameTimeline->Record(SlippiFrameTimeline::PHASE_CAPTURE, frame, startTime, endTime);
 	}
-
-	ss->Capture();
-	activeSavestates[frame] = std::move(ss);
-
-	u32 timeDiff = (u32)(Common::Timer::GetTimeUs() - startTime);
 	//INFO_LOG(SLIPPI_ONLINE, "SLIPPI ONLINE: Captured savestate for frame %d in: %f ms", frame,
 	//         ((double)timeDiff) / 1000);
 }
@@ -1805,7 +1940,7 @@ void CEXISlippi::handleLoadSavestate(u8 *payload)
 	s32 frame = payload[0] << 24 | payload[1] << 16 | payload[2] << 8 | payload[3];
 	u32 *preserveArr = (u32 *)(&payload[4]);
 
-	if (!activeSavestates.count(frame))
+	if (!savestates || !savestates->HasFrame(frame))
 	{
 		// This savestate does not exist... uhhh? What do we do?
 		ERROR_LOG(SLIPPI_ONLINE, "SLIPPI ONLINE: Savestate for frame %d does not exist.", frame);
@@ -1826,18 +1961,18 @@ void CEXISlippi::handleLoadSavestate(u8 *payload)
 		idx += 2;
 	}
 
-	// Load savestate
-	activeSavestates[frame]->Load(blocks);
+	// Load savestate, this also invalidates every other savestate
+	savestates->Load(frame, blocks);
 
-	// Move all active savestates to available
-	for (auto it = activeSavestates.begin(); it != activeSavestates.end(); ++it)
+	u64 endTime = Common::Timer::GetTimeUs();
+	u32 timeDiff = (u32)(endTime - startTime);
+	if (onlineTrace)
+		onlineTrace->Load(frame, timeDiff);
+	if (frameTimeline)
 	{
-		availableSavestates.push_back(std::move(it->second));
+		frameTimeline->Record(SlippiFrameTimeline::PHASE_LOAD, frame, startTime, endTime);
+		frameTimeline->RolledBack(frame, endTime);
 	}
-
-	activeSavestates.clear();
-
-	u32 timeDiff = (u32)(Common::Timer::GetTimeUs() - startTime);
 	//INFO_LOG(SLIPPI_ONLINE, "SLIPPI ONLINE: Loaded savestate for frame %d in: %f ms", frame, ((double)timeDiff) / 1000);
 }
 
@@ -2940,12 +3075,16 @@ void CEXISlippi::DMAWrite(u32 _uAddr, u32 _uSize)
 		time(&gameStartTime); // Store game start time
 		u8 receiveCommandsLen = memPtr[1];
 		configureCommands(&memPtr[1], receiveCommandsLen);
-		writeToFileAsync(&memPtr[0], receiveCommandsLen + 1, "create");
+		writeToFileAsync(&memPtr[0], receiveCommandsLen + 1, WRITE_OP_CREATE);
 		bufLoc += receiveCommandsLen + 1;
 		g_needInputForFrame = true;
 
 		m_slippiserver->startGame();
 		m_slippiserver->write(&memPtr[0], receiveCommandsLen + 1);
+
+		// Online games create a new timeline on their first frame, so one is only written at game end when
+		// the game ending was played online
+		frameTimeline.reset();
 	}
 
 	if (byte == CMD_MENU_FRAME)
@@ -2970,12 +3109,21 @@ void CEXISlippi::DMAWrite(u32 _uAddr, u32 _uSize)
 		}
 
 		u32 payloadLen = payloadSizes[byte];
+
+#ifdef IS_PLAYBACK
+		if (byte == CMD_RECEIVE_PRE_FRAME_UPDATE && g_batchStats && m_current_game)
+			g_batchStats->CheckPreFrame(&memPtr[bufLoc], m_current_game.get());
+#endif
+
 		switch (byte)
 		{
 		case CMD_RECEIVE_GAME_END:
-			writeToFileAsync(&memPtr[bufLoc], payloadLen + 1, "close");
+			writeToFileAsync(&memPtr[bufLoc], payloadLen + 1, WRITE_OP_CLOSE);
 			m_slippiserver->write(&memPtr[bufLoc], payloadLen + 1);
 			m_slippiserver->endGame();
+			if (onlineTrace)
+				onlineTrace->EndGame();
+			writeFrameTimeline();
 			break;
 		case CMD_PREPARE_REPLAY:
 			// log.open("log.txt");
@@ -2986,7 +3134,7 @@ void CEXISlippi::DMAWrite(u32 _uAddr, u32 _uSize)
 			break;
 		case CMD_FRAME_BOOKEND:
 			g_needInputForFrame = true;
-			writeToFileAsync(&memPtr[bufLoc], payloadLen + 1, "");
+			writeToFileAsync(&memPtr[bufLoc], payloadLen + 1, WRITE_OP_DATA);
 			m_slippiserver->write(&memPtr[bufLoc], payloadLen + 1);
 			break;
 		case CMD_IS_STOCK_STEAL:
@@ -3069,7 +3217,7 @@ void CEXISlippi::DMAWrite(u32 _uAddr, u32 _uSize)
 			prepareDelayResponse();
 			break;
 		default:
-			writeToFileAsync(&memPtr[bufLoc], payloadLen + 1, "");
+			writeToFileAsync(&memPtr[bufLoc], payloadLen + 1, WRITE_OP_DATA);
 			m_slippiserver->write(&memPtr[bufLoc], payloadLen + 1);
 			break;
 		}
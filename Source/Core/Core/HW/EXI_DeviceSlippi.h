@@ -5,21 +5,27 @@
 #pragma once
 
 #include <SlippiGame.h>
+#include <mutex>
 
 #include "Common/CommonTypes.h"
+#include "Common/Event.h"
 #include "Common/FileUtil.h"
 #include "Core/HW/EXI_Device.h"
 #include "Core/Slippi/SlippiDirectCodes.h"
+#include "Core/Slippi/SlippiFrameTimeline.h"
 #include "Core/Slippi/SlippiGameFileLoader.h"
 #include "Core/Slippi/SlippiGameReporter.h"
 #include "Core/Slippi/SlippiMatchmaking.h"
 #include "Core/Slippi/SlippiNetplay.h"
+#include "Core/Slippi/SlippiOnlineTrace.h"
 #include "Core/Slippi/SlippiReplayComm.h"
+#include "Core/Slippi/SlippiReplayCompressor.h"
 #include "Core/Slippi/SlippiSavestate.h"
 #include "Core/Slippi/SlippiSpectate.h"
 #include "Core/Slippi/SlippiUser.h"
 
 #define ROLLBACK_MAX_FRAMES 7
+#define ROLLBACK_STATS_DISPLAY_INTERVAL 600 // Frames between rollback stats in the OSD
 #define MAX_NAME_LENGTH 15
 #define CONNECT_CODE_LENGTH 8
 
@@ -45,6 +51,7 @@ class CEXISlippi : public IEXIDevice
 		// Recording
 		CMD_RECEIVE_COMMANDS = 0x35,
 		CMD_RECEIVE_GAME_INFO = 0x36,
+		CMD_RECEIVE_PRE_FRAME_UPDATE = 0x37,
 		CMD_RECEIVE_POST_FRAME_UPDATE = 0x38,
 		CMD_RECEIVE_GAME_END = 0x39,
 		CMD_FRAME_BOOKEND = 0x3C,
@@ -139,14 +146,18 @@ class CEXISlippi : public IEXIDevice
 	    {CMD_PREMADE_TEXT_LOAD, 0x2},
 	};
 
-	struct WriteMessage
+	enum WriteOperation : u8
 	{
-		std::vector<u8> data;
-		std::string operation;
+		WRITE_OP_DATA,
+		WRITE_OP_CREATE,
+		WRITE_OP_CLOSE,
 	};
 
 	// .slp File creation stuff
 	u32 writtenByteCount = 0;
+	u32 fileWriteCount = 0;
+	bool isCompressingReplay = false;
+	SlippiReplayCompressor replayCompressor;
 
 	// cout stuff
 	bool outputCurrentFrame = false;
@@ -159,8 +170,10 @@ class CEXISlippi : public IEXIDevice
 
 	void updateMetadataFields(u8 *payload, u32 length);
 	void configureCommands(u8 *payload, u8 length);
-	void writeToFileAsync(u8 *payload, u32 length, std::string fileOption);
-	void writeToFile(std::unique_ptr<WriteMessage> msg);
+	void writeToFileAsync(u8 *payload, u32 length, WriteOperation operation);
+	void writeToFile(u8 *payload, u32 length, WriteOperation operation);
+	void appendFileData(const u8 *data, u32 length, s32 frame);
+	void flushFileWriteBuffer();
 	std::vector<u8> generateMetadata();
 	void createNewFile();
 	void closeFile();
@@ -181,6 +194,7 @@ class CEXISlippi : public IEXIDevice
 	void handleSendInputs(u8 *payload);
 	void handleCaptureSavestate(u8 *payload);
 	void handleLoadSavestate(u8 *payload);
+	void writeFrameTimeline();
 	void handleNameEntryAutoComplete(u8 *payload);
 	void handleNameEntryLoad(u8 *payload);
 	void startFindMatch(u8 *payload);
@@ -223,7 +237,14 @@ class CEXISlippi : public IEXIDevice
 
 	void FileWriteThread(void);
 
-	Common::FifoQueue<std::unique_ptr<WriteMessage>, false> fileWriteQueue;
+	// Writes are recorded into pendingWrites by the CPU thread as [u8 operation][u32 length][payload].
+	// The write thread swaps it with processingWrites and turns everything that piled up into a
+	// single write to the file, both buffers keep their capacity so appending doesn't allocate
+	std::mutex writeMutex;
+	std::vector<u8> pendingWrites;
+	std::vector<u8> processingWrites;
+	std::vector<u8> fileWriteBuffer;
+	Common::Event writeEvent;
 	bool writeThreadRunning = false;
 	std::thread m_fileWriteThread;
 
@@ -276,8 +297,9 @@ class CEXISlippi : public IEXIDevice
 	std::unique_ptr<SlippiDirectCodes> directCodes;
 	std::unique_ptr<SlippiDirectCodes> teamsCodes;
 
-	std::map<s32, std::unique_ptr<SlippiSavestate>> activeSavestates;
-	std::deque<std::unique_ptr<SlippiSavestate>> availableSavestates;
+	std::unique_ptr<SlippiSavestate> savestates;
+	std::unique_ptr<SlippiOnlineTrace> onlineTrace;
+	std::unique_ptr<SlippiFrameTimeline> frameTimeline;
 
 	std::vector<u16> allowedStages;
 };
@@ -43,11 +43,14 @@ IPC_HLE_PERIOD: For the Wii Remote this is the call schedule:
 			CWII_IPC_HLE_WiiMote::Update()
 */
 
+#include <algorithm>
+#include <cstdlib>
+
 #include "Core/HW/SystemTimers.h"
 #include "Common/Atomic.h"
 #include "Common/CommonTypes.h"
+#include "Common/FramePacer.h"
 #include "Common/Logging/Log.h"
-#include "Common/Thread.h"
 #include "Common/Timer.h"
 #include "Core/ConfigManager.h"
 #include "Core/Core.h"
@@ -87,6 +90,13 @@ static int s_ipc_hle_period;
 // Custom RTC
 static s64 s_localtime_rtc_offset = 0;
 
+// Microseconds the throttle still has to add to (or take off of) its deadline. Nudges are spread
+// over several throttle events so that a big one doesn't turn into one long stall
+static s64 s_throttle_nudge_us = 0;
+constexpr s64 MAX_THROTTLE_NUDGE_PER_EVENT_US = 100;
+
+static Common::FramePacer s_frame_pacer;
+
 u32 GetTicksPerSecond()
 {
 	return s_cpu_core_clock;
@@ -178,9 +188,12 @@ static void ThrottleCallback(u64 last_time, s64 cyclesLate)
 	// Allow the GPU thread to sleep. Setting this flag here limits the wakeups to 1 kHz.
 	Fifo::GpuMaySleep();
 
-	u32 time = Common::Timer::GetTimeMs();
+	// Deadlines are kept in nanoseconds on the monotonic clock. With precise pacing the pacer spins
+	// through the end of every wait, which keeps a core busy for as long as the OS oversleeps, so
+	// otherwise it only sleeps
+	u64 time = Common::Timer::GetTimeNs();
 
-	int diff = (u32)last_time - time;
+	s64 diff = (s64)(last_time - time);
 	const SConfig& config = SConfig::GetInstance();
 	bool frame_limiter = config.m_EmulationSpeed > 0.0f && !Core::GetIsThrottlerTempDisabled();
 	u32 next_event = GetTicksPerSecond() / 1000;
@@ -188,17 +201,52 @@ static void ThrottleCallback(u64 last_time, s64 cyclesLate)
 	{
 		if (config.m_EmulationSpeed != 1.0f)
 			next_event = u32(next_event * config.m_EmulationSpeed);
-		const int max_fallback = config.iTimingVariance;
-		if (abs(diff) > max_fallback)
+
+		if (s_throttle_nudge_us != 0)
+		{
+			s64 step = std::max(-MAX_THROTTLE_NUDGE_PER_EVENT_US,
+				std::min(MAX_THROTTLE_NUDGE_PER_EVENT_US, s_throttle_nudge_us));
+			s_throttle_nudge_us -= step;
+			last_time += step * 1000;
+			diff += step * 1000;
+		}
+
+		const s64 max_fallback = config.iTimingVariance * 1000000LL;
+		if (std::abs(diff) > max_fallback)
 		{
 			DEBUG_LOG(COMMON, "system too %s, %d ms skipped", diff < 0 ? "slow" : "fast",
-				abs(diff) - max_fallback);
+				(int)((std::abs(diff) - max_fallback) / 1000000));
 			last_time = time - max_fallback;
+			// The deadline starts over, nudges meant for the old one would only drag the new one around
+			s_throttle_nudge_us = 0;
 		}
+		else if (diff > 0 && config.bPreciseFramePacing)
+			s_frame_pacer.WaitUntil(last_time);
 		else if (diff > 0)
-			Common::SleepCurrentThread(diff);
+			s_frame_pacer.SleepUntil(last_time);
 	}
-	CoreTiming::ScheduleEvent(next_event - cyclesLate, et_Throttle, last_time + 1);
+	else
+	{
+		// Nothing is being paced, so there's nothing to nudge. Keeping them around would turn into a long
+		// slowdown once the limiter is back on
+		s_throttle_nudge_us = 0;
+	}
+	CoreTiming::ScheduleEvent(next_event - cyclesLate, et_Throttle, last_time + 1000000);
+}
+
+void NudgeThrottle(s64 delay_us)
+{
+	s_throttle_nudge_us += delay_us;
+}
+
+void RecordFrame()
+{
+	s_frame_pacer.RecordFrame();
+}
+
+Common::FramePacer::Stats TakeFramePacingStats()
+{
+	return s_frame_pacer.TakeStats();
 }
 
 // split from Init to break a circular dependency between VideoInterface::Init and
@@ -228,6 +276,13 @@ void Init()
 	s_audio_dma_period = s_cpu_core_clock / (AudioInterface::GetAIDSampleRate() * 4 / 32);
 
 	Common::Timer::IncreaseResolution();
+	if (SConfig::GetInstance().bPreciseFramePacing)
+	{
+		s_frame_pacer.Calibrate();
+		INFO_LOG(COMMON, "Frame pacer spins for the last %.3f ms before a deadline",
+			s_frame_pacer.GetSpinThresholdNs() / 1000000.0);
+	}
+	s_frame_pacer.TakeStats();
 	// store and convert localtime at boot to timebase ticks
 	if (SConfig::GetInstance().bEnableCustomRTC)
 	{
@@ -252,7 +307,8 @@ void Init()
 	CoreTiming::ScheduleEvent(VideoInterface::GetTicksPerHalfLine(), et_VI);
 	CoreTiming::ScheduleEvent(0, et_DSP);
 	CoreTiming::ScheduleEvent(s_audio_dma_period, et_AudioDMA);
-	CoreTiming::ScheduleEvent(0, et_Throttle, Common::Timer::GetTimeMs());
+	s_throttle_nudge_us = 0;
+	CoreTiming::ScheduleEvent(0, et_Throttle, Common::Timer::GetTimeNs());
 
 	//CoreTiming::ScheduleEvent(VideoInterface::GetTicksPerField(), et_PatchEngine);
 
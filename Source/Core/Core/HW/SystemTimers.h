@@ -5,6 +5,7 @@
 #pragma once
 
 #include "Common/CommonTypes.h"
+#include "Common/FramePacer.h"
 
 namespace SystemTimers
 {
@@ -46,4 +47,13 @@ void TimeBaseSet();
 u64 GetFakeTimeBase();
 // Custom RTC
 s64 GetLocalTimeRTCOffset();
+
+// Shifts the frame limiter's schedule, a positive value makes emulation wait that many more
+// microseconds. Used to keep netplay peers in step without stalling whole frames
+void NudgeThrottle(s64 delay_us);
+
+// Called once per emulated frame, feeds the frame time statistics
+void RecordFrame();
+// Frame time statistics since the previous call
+Common::FramePacer::Stats TakeFramePacingStats();
 }
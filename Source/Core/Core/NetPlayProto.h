@@ -62,6 +62,7 @@ enum
 	NP_MSG_SLIPPI_MATCH_SELECTIONS = 0x82,
 	NP_MSG_SLIPPI_CONN_SELECTED = 0x83,
 	NP_MSG_SLIPPI_CHAT_MESSAGE = 0x84,
+	NP_MSG_SLIPPI_PAD_COMPACT = 0x85,
 
 	NP_MSG_START_GAME = 0xA0,
 	NP_MSG_CHANGE_GAME = 0xA1,
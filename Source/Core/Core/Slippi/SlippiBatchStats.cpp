@@ -0,0 +1,194 @@
+#include "SlippiBatchStats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include "Common/Common.h"
+#include "Common/FileSearch.h"
+#include "Common/FileUtil.h"
+#include "Common/Logging/Log.h"
+#include "Common/StringUtil.h"
+#include "Common/Timer.h"
+#include "Core/Host.h"
+
+std::unique_ptr<SlippiBatchStats> g_batchStats;
+
+static u32 readBE32(const u8 *data)
+{
+	return data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+}
+
+static u32 floatBits(float value)
+{
+	u32 bits;
+	memcpy(&bits, &value, 4);
+	return bits;
+}
+
+SlippiBatchStats::SlippiBatchStats(const std::string &outputPath)
+{
+	OpenFStream(output, outputPath, std::ios_base::out | std::ios_base::trunc);
+	if (!output.is_open())
+		ERROR_LOG(SLIPPI, "Failed to open batch output file: %s", outputPath.c_str());
+
+	batchStartTimeUs = Common::Timer::GetTimeUs();
+}
+
+SlippiBatchStats::~SlippiBatchStats() {}
+
+std::vector<std::string> SlippiBatchStats::FindReplays(const std::string &path)
+{
+	if (File::IsDirectory(path))
+	{
+		auto replays = DoFileSearch({".slp", ".slpz"}, {path}, true);
+		std::sort(replays.begin(), replays.end());
+		return replays;
+	}
+
+	std::vector<std::string> replays;
+	std::ifstream manifest;
+	OpenFStream(manifest, path, std::ios_base::in);
+
+	std::string line;
+	while (std::getline(manifest, line))
+	{
+		line = StripSpaces(line);
+		if (!line.empty() && line[0] != '#')
+			replays.push_back(line);
+	}
+
+	return replays;
+}
+
+bool SlippiBatchStats::WriteQueueFile(const std::string &commPath, const std::vector<std::string> &replays)
+{
+	json queue = json::array();
+	for (auto &replay : replays)
+		queue.push_back({{"path", replay}});
+
+	// Rollback display has to stay off so the played frames line up with the final frames of the replay
+	json comm = {{"mode", "queue"}, {"rollbackDisplayMethod", "off"}, {"queue", queue}};
+	return File::WriteStringToFile(comm.dump(), commPath);
+}
+
+void SlippiBatchStats::StartGame(const std::string &path, Slippi::SlippiGame *game, u64 loadTimeUs)
+{
+	EndGame();
+
+	current = std::make_unique<GameResult>();
+	current->path = path;
+	current->isLoaded = true;
+	current->lastFrame = game->GetLatestIndex();
+	current->gameEndMethod = game->getGameEndMethod();
+	current->loadTimeUs = loadTimeUs;
+	current->startTimeUs = Common::Timer::GetTimeUs();
+}
+
+void SlippiBatchStats::FailGame(const std::string &path)
+{
+	EndGame();
+
+	GameResult result;
+	result.path = path;
+	writeResult(result, 0);
+}
+
+void SlippiBatchStats::FramePlayed()
+{
+	if (current)
+		current->framesPlayed++;
+}
+
+void SlippiBatchStats::CheckPreFrame(const u8 *payload, Slippi::SlippiGame *game)
+{
+	if (!current || current->desyncPort >= 0)
+		return;
+
+	s32 frameIndex = (s32)readBE32(&payload[1]);
+	u8 port = payload[5];
+	bool isFollower = payload[6] != 0;
+
+	Slippi::FrameData *frame = game->GetFrame(frameIndex);
+	if (!frame || !frame->HasPlayer(port, isFollower))
+		return;
+
+	const Slippi::PlayerFrameData &recorded = isFollower ? frame->followers[port] : frame->players[port];
+
+	// Everything here is deterministic so any difference at all means the playback went off the rails
+	bool isMatch = readBE32(&payload[7]) == recorded.randomSeed &&
+	               (u16)(payload[11] << 8 | payload[12]) == recorded.animation &&
+	               readBE32(&payload[13]) == floatBits(recorded.locationX) &&
+	               readBE32(&payload[17]) == floatBits(recorded.locationY) &&
+	               readBE32(&payload[21]) == floatBits(recorded.facingDirection);
+	if (isMatch)
+		return;
+
+	WARN_LOG(SLIPPI, "Batch playback desynced on frame %d for port %d: %s", frameIndex, port + 1,
+	         current->path.c_str());
+	current->desyncFrame = frameIndex;
+	current->desyncPort = port;
+}
+
+void SlippiBatchStats::EndGame()
+{
+	if (!current)
+		return;
+
+	writeResult(*current, Common::Timer::GetTimeUs() - current->startTimeUs);
+	current.reset();
+}
+
+void SlippiBatchStats::Finish()
+{
+	if (isFinished)
+		return;
+
+	EndGame();
+	isFinished = true;
+
+	double seconds = (Common::Timer::GetTimeUs() - batchStartTimeUs) / 1000000.0;
+	std::cout << "[BATCH_DONE] games: " << gameCount << ", failed: " << failedCount << ", desynced: " << desyncCount
+	          << ", frames: " << totalFrames << ", seconds: " << seconds << std::endl;
+
+	Host_Message(WM_USER_STOP);
+}
+
+void SlippiBatchStats::writeResult(const GameResult &result, u64 playTimeUs)
+{
+	gameCount++;
+	totalFrames += result.framesPlayed;
+
+	std::string status = "ok";
+	if (!result.isLoaded)
+	{
+		status = "failed";
+		failedCount++;
+	}
+	else if (result.desyncPort >= 0)
+	{
+		status = "desync";
+		desyncCount++;
+	}
+
+	json line = {{"path", result.path},
+	             {"status", status},
+	             {"lastFrame", result.lastFrame},
+	             {"framesPlayed", result.framesPlayed},
+	             {"gameEndMethod", result.gameEndMethod},
+	             {"loadMs", result.loadTimeUs / 1000.0},
+	             {"playMs", playTimeUs / 1000.0},
+	             {"fps", playTimeUs ? result.framesPlayed * 1000000.0 / playTimeUs : 0.0}};
+	if (result.desyncPort >= 0)
+	{
+		line["desyncFrame"] = result.desyncFrame;
+		line["desyncPort"] = result.desyncPort + 1;
+	}
+
+	output << line.dump() << std::endl;
+
+	std::cout << "[BATCH_GAME] " << status << " " << result.path << std::endl;
+}
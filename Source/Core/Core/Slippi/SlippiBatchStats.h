@@ -0,0 +1,66 @@
+#pragma once
+
+#include <SlippiLib/SlippiGame.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Collects per-game results while a batch of replays is played back headlessly. Every game
+// is written as one json line to the output file as soon as it finishes so that a crashed
+// or killed instance still leaves the results of the games it got through
+class SlippiBatchStats
+{
+  public:
+	SlippiBatchStats(const std::string &outputPath);
+	~SlippiBatchStats();
+
+	// Expands a directory (searched recursively for .slp and .slpz files) or a manifest with one replay
+	// path per line into the list of replays to play
+	static std::vector<std::string> FindReplays(const std::string &path);
+
+	// Writes a playback comm file that queues up every replay
+	static bool WriteQueueFile(const std::string &commPath, const std::vector<std::string> &replays);
+
+	void StartGame(const std::string &path, Slippi::SlippiGame *game, u64 loadTimeUs);
+	void FailGame(const std::string &path);
+	void FramePlayed();
+
+	// Compares a pre-frame update sent by the game against the one in the replay
+	void CheckPreFrame(const u8 *payload, Slippi::SlippiGame *game);
+
+	void EndGame();
+
+	// Called once the queue runs dry, prints a summary and stops emulation
+	void Finish();
+
+	bool IsFinished() const { return isFinished; }
+
+  private:
+	typedef struct
+	{
+		std::string path;
+		bool isLoaded = false;
+		s32 lastFrame = 0;
+		u8 gameEndMethod = 0;
+		u32 framesPlayed = 0;
+		s32 desyncFrame = 0;
+		s32 desyncPort = -1;
+		u64 loadTimeUs = 0;
+		u64 startTimeUs = 0;
+	} GameResult;
+
+	void writeResult(const GameResult &result, u64 playTimeUs);
+
+	std::ofstream output;
+	std::unique_ptr<GameResult> current;
+	bool isFinished = false;
+
+	u32 gameCount = 0;
+	u32 failedCount = 0;
+	u32 desyncCount = 0;
+	u64 totalFrames = 0;
+	u64 batchStartTimeUs = 0;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Lock free ring of variable length records for exactly one producer thread and one consumer
+// thread. Records are stored as [u8 type][u32 length][data] in a fixed buffer, pushing never
+// allocates or blocks. Push returns false for a record that doesn't fit, it's up to the caller
+// to keep it somewhere else
+class SlippiEventRing
+{
+  public:
+	// capacity has to be a power of two
+	SlippiEventRing(size_t capacity) : m_buffer(capacity), m_mask(capacity - 1) {}
+
+	bool Push(u8 type, const u8 *data, u32 length)
+	{
+		u64 write_pos = m_write_pos.load(std::memory_order_relaxed);
+		u64 read_pos = m_read_pos.load(std::memory_order_acquire);
+		if (m_buffer.size() - (write_pos - read_pos) < RECORD_HEADER_SIZE + (u64)length)
+			return false;
+
+		copyIn(write_pos, &type, 1);
+		copyIn(write_pos + 1, &length, 4);
+		copyIn(write_pos + RECORD_HEADER_SIZE, data, length);
+
+		m_write_pos.store(write_pos + RECORD_HEADER_SIZE + length, std::memory_order_release);
+		return true;
+	}
+
+	// Copies the oldest record into data, which keeps its capacity between calls
+	bool Pop(u8 &type, std::string &data)
+	{
+		u64 read_pos = m_read_pos.load(std::memory_order_relaxed);
+		if (read_pos == m_write_pos.load(std::memory_order_acquire))
+			return false;
+
+		u32 length;
+		copyOut(read_pos, &type, 1);
+		copyOut(read_pos + 1, &length, 4);
+		data.resize(length);
+		copyOut(read_pos + RECORD_HEADER_SIZE, &data[0], length);
+
+		m_read_pos.store(read_pos + RECORD_HEADER_SIZE + length, std::memory_order_release);
+		return true;
+	}
+
+  private:
+	static const u64 RECORD_HEADER_SIZE = 5;
+
+	void copyIn(u64 pos, const void *src, size_t length)
+	{
+		if (!length)
+			return;
+
+		size_t offset = pos & m_mask;
+		size_t first = std::min(length, m_buffer.size() - offset);
+		memcpy(&m_buffer[offset], src, first);
+		if (first < length)
+			memcpy(&m_buffer[0], static_cast<const u8 *>(src) + first, length - first);
+	}
+
+	void copyOut(u64 pos, void *dst, size_t length) const
+	{
+		if (!length)
+			return;
+
+		size_t offset = pos & m_mask;
+		size_t first = std::min(length, m_buffer.size() - offset);
+		memcpy(dst, &m_buffer[offset], first);
+		if (first < length)
+			memcpy(static_cast<u8 *>(dst) + first, &m_buffer[0], length - first);
+	}
+
+	std::vector<u8> m_buffer;
+	const size_t m_mask;
+
+	// Both positions only ever grow, the record at a position lives at (position & m_mask)
+	std::atomic<u64> m_read_pos{0};
+	std::atomic<u64> m_write_pos{0};
+};
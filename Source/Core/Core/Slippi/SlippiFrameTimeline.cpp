@@ -0,0 +1,118 @@
+#include "SlippiFrameTimeline.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "Common/FileUtil.h"
+#include "Common/StringUtil.h"
+
+static const char *phaseNames[SlippiFrameTimeline::PHASE_COUNT] = {
+    "frame", "send_inputs", "prepare_inputs", "capture_savestate", "load_savestate", "resim",
+};
+
+static u32 percentile(std::vector<u32> &sorted, double p)
+{
+	return sorted[std::min(sorted.size() - 1, (size_t)(p / 100.0 * sorted.size()))];
+}
+
+SlippiFrameTimeline::SlippiFrameTimeline() : spans(new Span[SLIPPI_TIMELINE_SIZE])
+{
+}
+
+void SlippiFrameTimeline::StartGame()
+{
+	spanCount = 0;
+	currentFrame = 0;
+	frameStartUs = 0;
+	isResimulating = false;
+	rollbackDepths.clear();
+	resimUs.clear();
+}
+
+void SlippiFrameTimeline::Record(Phase phase, s32 frame, u64 startUs, u64 endUs)
+{
+	Span &span = spans[spanCount & (SLIPPI_TIMELINE_SIZE - 1)];
+	span.startUs = startUs;
+	span.durationUs = (u32)(endUs - startUs);
+	span.frame = frame;
+	span.phase = phase;
+	spanCount++;
+}
+
+void SlippiFrameTimeline::InputsRequested(s32 frame, u64 nowUs)
+{
+	// Resimulation that never got back to a capture of its frame can't be told apart from the rest of the
+	// frame and the frame limiter sleep, so it isn't counted
+	isResimulating = false;
+
+	if (frameStartUs)
+		Record(PHASE_FRAME, currentFrame, frameStartUs, nowUs);
+
+	currentFrame = frame;
+	frameStartUs = nowUs;
+}
+
+void SlippiFrameTimeline::RolledBack(s32 toFrame, u64 loadEndUs)
+{
+	rollbackDepths.push_back((u32)std::max(currentFrame - toFrame, 0));
+
+	isResimulating = true;
+	resimFromFrame = currentFrame;
+	resimStartUs = loadEndUs;
+}
+
+void SlippiFrameTimeline::Captured(s32 frame, u64 startUs)
+{
+	if (!isResimulating || frame < resimFromFrame)
+		return;
+
+	Record(PHASE_RESIM, resimFromFrame, resimStartUs, startUs);
+	resimUs.push_back((u32)(startUs - resimStartUs));
+	isResimulating = false;
+}
+
+bool SlippiFrameTimeline::WriteChromeTrace(const std::string &path) const
+{
+	std::ofstream output;
+	OpenFStream(output, path, std::ios_base::out | std::ios_base::trunc);
+	if (!output.is_open())
+		return false;
+
+	u64 first = spanCount > SLIPPI_TIMELINE_SIZE ? spanCount - SLIPPI_TIMELINE_SIZE : 0;
+	u64 baseUs = spanCount ? spans[first & (SLIPPI_TIMELINE_SIZE - 1)].startUs : 0;
+
+	output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for (u64 i = first; i < spanCount; i++)
+	{
+		const Span &span = spans[i & (SLIPPI_TIMELINE_SIZE - 1)];
+
+		// Every span of a frame nests inside its frame span so they all share one track
+		output << (i == first ? "" : ",\n") << "{\"name\":\"" << phaseNames[span.phase]
+		       << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << (span.startUs - baseUs)
+		       << ",\"dur\":" << span.durationUs << ",\"args\":{\"frame\":" << span.frame << "}}";
+	}
+	output << "\n]}\n";
+
+	return output.good();
+}
+
+std::string SlippiFrameTimeline::TakeRollbackSummary()
+{
+	if (rollbackDepths.empty())
+		return "";
+
+	std::sort(rollbackDepths.begin(), rollbackDepths.end());
+	std::sort(resimUs.begin(), resimUs.end());
+
+	std::string summary = StringFromFormat("Rollbacks: %u | Depth p50: %u p99: %u", (u32)rollbackDepths.size(),
+	                                       percentile(rollbackDepths, 50), percentile(rollbackDepths, 99));
+	if (!resimUs.empty())
+	{
+		summary += StringFromFormat(" | Resim p50: %.2f ms p99: %.2f ms", percentile(resimUs, 50) / 1000.0,
+		                            percentile(resimUs, 99) / 1000.0);
+	}
+
+	rollbackDepths.clear();
+	resimUs.clear();
+	return summary;
+}
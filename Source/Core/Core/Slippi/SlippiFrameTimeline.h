@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Number of spans the timeline keeps, a long game records around 150k of them. Has to be a power of two
+#define SLIPPI_TIMELINE_SIZE (1 << 18)
+
+// Records how long every phase of an online frame took in a fixed ring of spans. Recording is a couple of
+// stores per span so it is always on, the ring is only turned into a Chrome trace (chrome://tracing or
+// Perfetto) when asked to. Only ever touched from the CPU thread
+class SlippiFrameTimeline
+{
+  public:
+	enum Phase : u8
+	{
+		PHASE_FRAME,
+		PHASE_SEND_INPUTS,
+		PHASE_PREPARE_INPUTS,
+		PHASE_CAPTURE,
+		PHASE_LOAD,
+		PHASE_RESIM,
+		PHASE_COUNT,
+	};
+
+	SlippiFrameTimeline();
+
+	void StartGame();
+
+	void Record(Phase phase, s32 frame, u64 startUs, u64 endUs);
+
+	// The game asking for the inputs of frame marks the end of the previous frame
+	void InputsRequested(s32 frame, u64 nowUs);
+	// A savestate load that finished at loadEndUs, the game resimulates back up to the current frame next
+	void RolledBack(s32 toFrame, u64 loadEndUs);
+	// A savestate capture starting at startUs. Capturing the frame the rollback started from marks the end
+	// of the resimulation
+	void Captured(s32 frame, u64 startUs);
+
+	bool WriteChromeTrace(const std::string &path) const;
+
+	// p50/p99 rollback depth and resim time since the last call, empty if there were no rollbacks
+	std::string TakeRollbackSummary();
+
+  private:
+	typedef struct
+	{
+		u64 startUs;
+		u32 durationUs;
+		s32 frame;
+		Phase phase;
+	} Span;
+
+	std::unique_ptr<Span[]> spans;
+	u64 spanCount = 0;
+
+	s32 currentFrame = 0;
+	u64 frameStartUs = 0;
+
+	bool isResimulating = false;
+	s32 resimFromFrame = 0;
+	u64 resimStartUs = 0;
+
+	std::vector<u32> rollbackDepths;
+	std::vector<u32> resimUs;
+};
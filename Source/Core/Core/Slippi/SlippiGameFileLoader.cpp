@@ -1,21 +1,35 @@
 #include "SlippiGameFileLoader.h"
 
+#include <algorithm>
+
 #include "Common/Logging/Log.h"
 
 #include "Common/FileUtil.h"
+#include "Common/Hash.h"
+#include "Common/StringUtil.h"
+#include "Common/Thread.h"
 #include "DiscIO/FileMonitor.h"
+#include "DiscIO/Filesystem.h"
+#include "DiscIO/Volume.h"
+#include "DiscIO/VolumeCreator.h"
+
+static const std::string DIFF_EXTENSION = ".diff";
+
+static std::string getGameFilesDirectory()
+{
+	return File::GetSysDirectory() + "GameFiles/GALE01/"; // TODO: Handle other games?
+}
 
 std::string getFilePath(std::string fileName)
 {
-	std::string dirPath = File::GetSysDirectory();
-	std::string filePath = dirPath + "GameFiles/GALE01/" + fileName; // TODO: Handle other games?
+	std::string filePath = getGameFilesDirectory() + fileName;
 
 	if (File::Exists(filePath))
 	{
 		return filePath;
 	}
 
-	filePath = filePath + ".diff";
+	filePath = filePath + DIFF_EXTENSION;
 	if (File::Exists(filePath))
 	{
 		return filePath;
@@ -24,12 +38,183 @@ std::string getFilePath(std::string fileName)
 	return "";
 }
 
+static std::string getDecodedCacheDirectory()
+{
+	return File::GetUserPath(D_CACHE_IDX) + "Slippi/GameFiles/";
+}
+
+// The name changes whenever either the ISO copy of the file or the diff does, so a stale entry is never read
+static std::string getDecodedCachePath(const std::string &fileName, const std::vector<u8> &source,
+                                       const std::string &diff)
+{
+	u64 sourceHash = GetMurmurHash3(source.data(), (u32)source.size(), 0);
+	u64 diffHash = GetMurmurHash3((const u8 *)diff.data(), (u32)diff.size(), 0);
+	return StringFromFormat("%s%s.%016llx%016llx", getDecodedCacheDirectory().c_str(), fileName.c_str(),
+	                        (unsigned long long)sourceHash, (unsigned long long)diffHash);
+}
+
+SlippiGameFileLoader::~SlippiGameFileLoader()
+{
+	isPrefetchStopping = true;
+	if (prefetchThread.joinable())
+		prefetchThread.join();
+}
+
+void SlippiGameFileLoader::Prefetch(const std::string &isoPath)
+{
+	if (prefetchThread.joinable() || isoPath.empty())
+		return;
+
+	// Listed up front so a LoadFile right after boot already knows to wait for the prefetch
+	File::FSTEntry gameFiles = File::ScanDirectoryTree(getGameFilesDirectory(), false);
+	{
+		std::lock_guard<std::mutex> lk(fileCacheMutex);
+		for (auto &entry : gameFiles.children)
+		{
+			if (entry.isDirectory || !StringEndsWith(entry.virtualName, DIFF_EXTENSION))
+				continue;
+
+			std::string fileName = entry.virtualName.substr(0, entry.virtualName.length() - DIFF_EXTENSION.length());
+			if (!fileCache.count(fileName))
+				pendingFiles.insert(fileName);
+		}
+	}
+
+	if (pendingFiles.empty())
+		return;
+
+	prefetchThread = std::thread(&SlippiGameFileLoader::prefetchThreadFunc, this, isoPath);
+}
+
+void SlippiGameFileLoader::prefetchThreadFunc(std::string isoPath)
+{
+	Common::SetCurrentThreadName("Slippi Game File Prefetch");
+
+	std::vector<std::string> fileNames;
+	{
+		std::lock_guard<std::mutex> lk(fileCacheMutex);
+		fileNames.assign(pendingFiles.begin(), pendingFiles.end());
+	}
+
+	// The ISO is read through a volume of our own, the one FileMon keeps is only usable from the CPU thread
+	// once the game runs. Reads are sequential, only the decoding is spread over threads
+	std::vector<PrefetchJob> jobs;
+	std::unique_ptr<DiscIO::IVolume> volume = DiscIO::CreateVolumeFromFilename(isoPath);
+	std::unique_ptr<DiscIO::IFileSystem> fileSystem;
+	if (volume && volume->GetGameID() == "GALE01")
+		fileSystem = DiscIO::CreateFileSystem(volume.get());
+
+	if (fileSystem)
+	{
+		for (auto &fileName : fileNames)
+		{
+			PrefetchJob job;
+			job.fileName = fileName;
+			job.diffPath = getGameFilesDirectory() + fileName + DIFF_EXTENSION;
+			job.source.resize(fileSystem->GetFileSize(fileName));
+			if (job.source.empty() || fileSystem->ReadFile(fileName, job.source.data(), job.source.size()) == 0)
+				continue;
+
+			jobs.push_back(std::move(job));
+		}
+	}
+	else
+	{
+		WARN_LOG(SLIPPI, "Could not open %s to prefetch game files", isoPath.c_str());
+	}
+
+	// Files that couldn't be read from the ISO are left to LoadFile
+	{
+		std::lock_guard<std::mutex> lk(fileCacheMutex);
+		pendingFiles.clear();
+		for (auto &job : jobs)
+			pendingFiles.insert(job.fileName);
+	}
+	fileCacheCond.notify_all();
+
+	File::CreateFullPath(getDecodedCacheDirectory());
+
+	std::atomic<size_t> nextJob{0};
+	auto decodeWorker = [&]() {
+		open_vcdiff::VCDiffDecoder workerDecoder;
+		for (size_t i = nextJob++; i < jobs.size() && !isPrefetchStopping; i = nextJob++)
+			processJob(jobs[i], workerDecoder);
+	};
+
+	size_t workerCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), jobs.size());
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < workerCount; i++)
+		workers.emplace_back(decodeWorker);
+	decodeWorker();
+	for (auto &worker : workers)
+		worker.join();
+
+	INFO_LOG(SLIPPI, "Prefetched %u game files on %u threads", (u32)jobs.size(), (u32)workerCount);
+
+	// Anything else in the cache was decoded from an older diff or another ISO
+	if (!isPrefetchStopping && !jobs.empty())
+	{
+		std::unordered_set<std::string> usedPaths;
+		for (auto &job : jobs)
+			usedPaths.insert(job.cachePath);
+
+		std::string cacheDirectory = getDecodedCacheDirectory();
+		File::FSTEntry cachedFiles = File::ScanDirectoryTree(cacheDirectory, false);
+		for (auto &entry : cachedFiles.children)
+		{
+			if (!entry.isDirectory && !usedPaths.count(cacheDirectory + entry.virtualName))
+				File::Delete(cacheDirectory + entry.virtualName);
+		}
+	}
+
+	std::lock_guard<std::mutex> lk(fileCacheMutex);
+	pendingFiles.clear();
+	fileCacheCond.notify_all();
+}
+
+void SlippiGameFileLoader::processJob(PrefetchJob &job, open_vcdiff::VCDiffDecoder &jobDecoder)
+{
+	std::string diffContents;
+	std::string fileContents;
+	bool isDecoded = false;
+
+	if (File::ReadFileToString(job.diffPath, diffContents))
+	{
+		job.cachePath = getDecodedCachePath(job.fileName, job.source, diffContents);
+		const std::string &cachePath = job.cachePath;
+		if (File::ReadFileToString(cachePath, fileContents))
+		{
+			isDecoded = true;
+		}
+		else if (jobDecoder.Decode((char *)job.source.data(), job.source.size(), diffContents, &fileContents))
+		{
+			isDecoded = true;
+
+			// Written under a temporary name first so a launch that gets killed midway can't leave half a file
+			std::string tempPath = cachePath + ".tmp";
+			if (!File::WriteStringToFile(fileContents, tempPath) || !File::Rename(tempPath, cachePath))
+				WARN_LOG(SLIPPI, "Could not write decoded %s to the cache", job.fileName.c_str());
+		}
+	}
+
+	std::lock_guard<std::mutex> lk(fileCacheMutex);
+	if (isDecoded)
+		fileCache[job.fileName] = std::move(fileContents);
+	pendingFiles.erase(job.fileName);
+	fileCacheCond.notify_all();
+}
+
 u32 SlippiGameFileLoader::LoadFile(std::string fileName, std::string &data)
 {
-	if (fileCache.count(fileName))
 	{
-		data = fileCache[fileName];
-		return (u32)data.size();
+		std::unique_lock<std::mutex> lk(fileCacheMutex);
+		fileCacheCond.wait(lk, [&] { return !pendingFiles.count(fileName); });
+
+		if (fileCache.count(fileName))
+		{
+			data = fileCache[fileName];
+			return (u32)data.size();
+		}
 	}
 
 	INFO_LOG(SLIPPI, "Loading file: %s", fileName.c_str());
@@ -37,6 +222,7 @@ u32 SlippiGameFileLoader::LoadFile(std::string fileName, std::string &data)
 	std::string gameFilePath = getFilePath(fileName);
 	if (gameFilePath.empty())
 	{
+		std::lock_guard<std::mutex> lk(fileCacheMutex);
 		fileCache[fileName] = "";
 		data = "";
 		return 0;
@@ -45,7 +231,7 @@ u32 SlippiGameFileLoader::LoadFile(std::string fileName, std::string &data)
 	std::string fileContents;
 	File::ReadFileToString(gameFilePath, fileContents);
 
-	if (gameFilePath.substr(gameFilePath.length() - 5) == ".diff")
+	if (StringEndsWith(gameFilePath, DIFF_EXTENSION))
 	{
 		// If the file was a diff file, load the main file from ISO and apply patch
 		std::vector<u8> buf;
@@ -56,6 +242,7 @@ u32 SlippiGameFileLoader::LoadFile(std::string fileName, std::string &data)
 		decoder.Decode((char *)buf.data(), buf.size(), diffContents, &fileContents);
 	}
 
+	std::lock_guard<std::mutex> lk(fileCacheMutex);
 	fileCache[fileName] = fileContents;
 	data = fileCache[fileName];
 	INFO_LOG(SLIPPI, "File size: %d", (u32)data.size());
@@ -1,17 +1,48 @@
 #pragma once
 
 #include "Common/CommonTypes.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <open-vcdiff/src/google/vcdecoder.h>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class SlippiGameFileLoader
 {
   public:
+	~SlippiGameFileLoader();
+
+	// Decodes every diff in GameFiles/GALE01 against the given ISO on background threads so LoadFile doesn't
+	// have to. Decoded files are kept in the cache dir keyed by the hashes of both inputs, later launches
+	// only read them back
+	void Prefetch(const std::string &isoPath);
+
 	u32 LoadFile(std::string fileName, std::string &contents);
 
   protected:
+	typedef struct
+	{
+		std::string fileName;
+		std::string diffPath;
+		std::vector<u8> source;
+		std::string cachePath;
+	} PrefetchJob;
+
+	void prefetchThreadFunc(std::string isoPath);
+	void processJob(PrefetchJob &job, open_vcdiff::VCDiffDecoder &jobDecoder);
+
+	std::mutex fileCacheMutex;
+	std::condition_variable fileCacheCond;
 	std::unordered_map<std::string, std::string> fileCache;
+	// Files the prefetch will provide, LoadFile waits for those rather than decoding them a second time
+	std::unordered_set<std::string> pendingFiles;
+
+	std::thread prefetchThread;
+	std::atomic<bool> isPrefetchStopping{false};
+
 	open_vcdiff::VCDiffDecoder decoder;
 };
@@ -0,0 +1,187 @@
+#include "SlippiInputPredictor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Common/StringUtil.h"
+
+#define PAD_BUTTONS_OFFSET 0
+#define PAD_STICKS_OFFSET 2
+#define PAD_STICKS_SIZE 4
+
+static u16 readButtons(const u8 *pad)
+{
+	return pad[PAD_BUTTONS_OFFSET] << 8 | pad[PAD_BUTTONS_OFFSET + 1];
+}
+
+static void writeButtons(u8 *pad, u16 buttons)
+{
+	pad[PAD_BUTTONS_OFFSET] = buttons >> 8;
+	pad[PAD_BUTTONS_OFFSET + 1] = buttons & 0xFF;
+}
+
+void SlippiRepeatLastPredictor::Reset()
+{
+	memset(last, 0, sizeof(last));
+}
+
+void SlippiRepeatLastPredictor::Observe(const u8 *pad)
+{
+	memcpy(last, pad, SLIPPI_PAD_DATA_SIZE);
+}
+
+void SlippiRepeatLastPredictor::Predict(int steps, u8 *out)
+{
+	memcpy(out, last, SLIPPI_PAD_DATA_SIZE);
+}
+
+void SlippiStickVelocityPredictor::Reset()
+{
+	SlippiRepeatLastPredictor::Reset();
+	hasPrevious = false;
+}
+
+void SlippiStickVelocityPredictor::Observe(const u8 *pad)
+{
+	memcpy(previous, last, SLIPPI_PAD_DATA_SIZE);
+	hasPrevious = true;
+	SlippiRepeatLastPredictor::Observe(pad);
+}
+
+void SlippiStickVelocityPredictor::Predict(int steps, u8 *out)
+{
+	SlippiRepeatLastPredictor::Predict(steps, out);
+	if (!hasPrevious)
+		return;
+
+	for (int i = PAD_STICKS_OFFSET; i < PAD_STICKS_OFFSET + PAD_STICKS_SIZE; i++)
+	{
+		int velocity = last[i] - previous[i];
+		out[i] = (u8)std::max(0, std::min(255, last[i] + velocity * steps));
+	}
+}
+
+void SlippiButtonFrequencyPredictor::Reset()
+{
+	SlippiRepeatLastPredictor::Reset();
+	transitions.clear();
+	hasLast = false;
+}
+
+void SlippiButtonFrequencyPredictor::Observe(const u8 *pad)
+{
+	if (hasLast)
+	{
+		Transitions &from = transitions[readButtons(last)];
+		u16 next = readButtons(pad);
+		u32 count = ++from.nextCounts[next];
+		if (count > from.mostLikelyCount)
+		{
+			from.mostLikely = next;
+			from.mostLikelyCount = count;
+		}
+	}
+
+	hasLast = true;
+	SlippiRepeatLastPredictor::Observe(pad);
+}
+
+void SlippiButtonFrequencyPredictor::Predict(int steps, u8 *out)
+{
+	SlippiRepeatLastPredictor::Predict(steps, out);
+
+	u16 buttons = readButtons(last);
+	for (int i = 0; i < steps; i++)
+	{
+		auto it = transitions.find(buttons);
+		if (it == transitions.end())
+			break;
+		buttons = it->second.mostLikely;
+	}
+	writeButtons(out, buttons);
+}
+
+SlippiPredictionEvaluator::SlippiPredictionEvaluator()
+{
+	models.push_back(std::make_unique<SlippiRepeatLastPredictor>());
+	models.push_back(std::make_unique<SlippiStickVelocityPredictor>());
+	models.push_back(std::make_unique<SlippiButtonFrequencyPredictor>());
+
+	for (auto &model : models)
+	{
+		ModelStats modelStats;
+		modelStats.name = model->Name();
+		stats.push_back(modelStats);
+	}
+}
+
+void SlippiPredictionEvaluator::Reset()
+{
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		models[i]->Reset();
+		std::string name = stats[i].name;
+		stats[i] = ModelStats();
+		stats[i].name = name;
+	}
+	hasHistory = false;
+}
+
+void SlippiPredictionEvaluator::Observe(const u8 *const *pads, int count)
+{
+	if (hasHistory)
+	{
+		for (size_t m = 0; m < models.size(); m++)
+		{
+			ModelStats &modelStats = stats[m];
+			for (int i = 0; i < count; i++)
+			{
+				u8 predicted[SLIPPI_PAD_DATA_SIZE];
+				models[m]->Predict(i + 1, predicted);
+				bool isMispredicted = memcmp(predicted, pads[i], SLIPPI_PAD_DATA_SIZE) != 0;
+
+				int step = std::min(i, SLIPPI_PREDICTION_MAX_STEPS - 1);
+				modelStats.predictions++;
+				modelStats.stepPredictions[step]++;
+				if (isMispredicted)
+				{
+					modelStats.mispredictions++;
+					modelStats.stepMispredictions[step]++;
+				}
+			}
+		}
+	}
+
+	for (auto &model : models)
+	{
+		for (int i = 0; i < count; i++)
+			model->Observe(pads[i]);
+	}
+	hasHistory = hasHistory || count > 0;
+}
+
+std::string SlippiPredictionEvaluator::Summary() const
+{
+	std::string summary;
+	for (auto &modelStats : stats)
+	{
+		if (!modelStats.predictions)
+			continue;
+
+		summary += StringFromFormat("%s%s: %.1f%% of %llu", summary.empty() ? "" : " | ", modelStats.name.c_str(),
+		                            modelStats.mispredictions * 100.0 / modelStats.predictions,
+		                            (unsigned long long)modelStats.predictions);
+
+		// Misprediction rate by how far past the last received pad the frame was
+		summary += " [";
+		for (int i = 0; i < SLIPPI_PREDICTION_MAX_STEPS; i++)
+		{
+			if (!modelStats.stepPredictions[i])
+				continue;
+			summary += StringFromFormat("%s+%d: %.1f%%", i ? " " : "", i + 1,
+			                            modelStats.stepMispredictions[i] * 100.0 / modelStats.stepPredictions[i]);
+		}
+		summary += "]";
+	}
+	return summary;
+}
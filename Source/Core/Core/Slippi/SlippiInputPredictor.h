@@ -0,0 +1,112 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/Slippi/SlippiPad.h"
+
+// How many frames past the last received pad predictions are scored separately for
+#define SLIPPI_PREDICTION_MAX_STEPS 8
+
+// Guesses the pad of a remote player for frames that haven't arrived yet. Pads are the 8 bytes that go
+// over the wire: buttons (2), main stick (2), c-stick (2), triggers (2)
+class SlippiInputPredictor
+{
+  public:
+	virtual ~SlippiInputPredictor() {}
+
+	virtual const char *Name() const = 0;
+	virtual void Reset() = 0;
+
+	// Called with every received pad in frame order
+	virtual void Observe(const u8 *pad) = 0;
+
+	// Writes the pad expected steps frames after the last observed one. Only called after at least one
+	// pad has been observed
+	virtual void Predict(int steps, u8 *out) = 0;
+};
+
+// The prediction the game itself does, the last pad is held
+class SlippiRepeatLastPredictor : public SlippiInputPredictor
+{
+  public:
+	const char *Name() const override { return "repeat_last"; }
+	void Reset() override;
+	void Observe(const u8 *pad) override;
+	void Predict(int steps, u8 *out) override;
+
+  protected:
+	u8 last[SLIPPI_PAD_DATA_SIZE] = {};
+};
+
+// Holds the buttons but keeps both sticks moving the way they moved over the last frame
+class SlippiStickVelocityPredictor : public SlippiRepeatLastPredictor
+{
+  public:
+	const char *Name() const override { return "stick_velocity"; }
+	void Reset() override;
+	void Observe(const u8 *pad) override;
+	void Predict(int steps, u8 *out) override;
+
+  private:
+	u8 previous[SLIPPI_PAD_DATA_SIZE] = {};
+	bool hasPrevious = false;
+};
+
+// Learns which button state usually follows which for this opponent and follows the most common chain.
+// The analog values are held
+class SlippiButtonFrequencyPredictor : public SlippiRepeatLastPredictor
+{
+  public:
+	const char *Name() const override { return "button_frequency"; }
+	void Reset() override;
+	void Observe(const u8 *pad) override;
+	void Predict(int steps, u8 *out) override;
+
+  private:
+	typedef struct
+	{
+		std::map<u16, u32> nextCounts;
+		u16 mostLikely = 0;
+		u32 mostLikelyCount = 0;
+	} Transitions;
+
+	std::map<u16, Transitions> transitions;
+	bool hasLast = false;
+};
+
+// Runs every predictor side by side against the pads of one remote player and keeps score. The game does
+// its own prediction so none of them change what is played yet, this tells which one would have caused
+// the fewest rollbacks
+class SlippiPredictionEvaluator
+{
+  public:
+	typedef struct
+	{
+		std::string name;
+		u64 predictions = 0;
+		u64 mispredictions = 0;
+		// Index 0 is the frame right after the last received pad
+		u64 stepPredictions[SLIPPI_PREDICTION_MAX_STEPS] = {};
+		u64 stepMispredictions[SLIPPI_PREDICTION_MAX_STEPS] = {};
+	} ModelStats;
+
+	SlippiPredictionEvaluator();
+
+	void Reset();
+
+	// Pads for the count frames after the last observed one, oldest first. Each of them is predicted from
+	// the pads received before this batch, which is what the game had to go on as well
+	void Observe(const u8 *const *pads, int count);
+
+	const std::vector<ModelStats> &GetStats() const { return stats; }
+	std::string Summary() const;
+
+  private:
+	std::vector<std::unique_ptr<SlippiInputPredictor>> models;
+	std::vector<ModelStats> stats;
+	bool hasHistory = false;
+};
@@ -0,0 +1,249 @@
+#include "SlippiLinkSimulator.h"
+
+#include <algorithm>
+
+#include "Common/Logging/Log.h"
+#include "Common/StringUtil.h"
+#include "Common/Thread.h"
+#include "Common/Timer.h"
+
+// Larger than anything ENet sends with its default MTU
+#define LINK_SIM_MAX_DATAGRAM 4096
+
+// A link that can't keep up drops packets once they would sit in its queue for longer than this
+#define LINK_SIM_MAX_QUEUE_US 500000
+
+bool SlippiLinkSimulator::ParseConditions(const std::string &spec, Conditions &conditions)
+{
+	if (StripSpaces(spec).empty())
+		return false;
+
+	Conditions parsed;
+	std::vector<std::string> options;
+	SplitString(spec, ',', options);
+	for (auto &option : options)
+	{
+		std::vector<std::string> keyValue;
+		SplitString(option, '=', keyValue);
+		if (keyValue.size() != 2)
+		{
+			ERROR_LOG(SLIPPI_ONLINE, "[LinkSim] Invalid option: %s", option.c_str());
+			return false;
+		}
+
+		std::string key = StripSpaces(keyValue[0]);
+		std::string value = StripSpaces(keyValue[1]);
+		bool isValid = false;
+		if (key == "latency")
+			isValid = TryParse(value, &parsed.latencyMs);
+		else if (key == "jitter")
+			isValid = TryParse(value, &parsed.jitterMs);
+		else if (key == "loss")
+			isValid = TryParse(value, &parsed.lossPercent);
+		else if (key == "reorder")
+			isValid = TryParse(value, &parsed.reorderPercent);
+		else if (key == "up")
+			isValid = TryParse(value, &parsed.upKbps);
+		else if (key == "down")
+			isValid = TryParse(value, &parsed.downKbps);
+		else if (key == "seed")
+			isValid = TryParse(value, &parsed.seed);
+
+		if (!isValid)
+		{
+			ERROR_LOG(SLIPPI_ONLINE, "[LinkSim] Invalid option: %s", option.c_str());
+			return false;
+		}
+	}
+
+	conditions = parsed;
+	return true;
+}
+
+std::string SlippiLinkSimulator::DescribeConditions(const Conditions &conditions)
+{
+	return StringFromFormat("latency=%u,jitter=%u,loss=%g,reorder=%g,up=%u,down=%u,seed=%u", conditions.latencyMs,
+	                        conditions.jitterMs, conditions.lossPercent, conditions.reorderPercent, conditions.upKbps,
+	                        conditions.downKbps, conditions.seed);
+}
+
+SlippiLinkSimulator::SlippiLinkSimulator(const Conditions &linkConditions, const ENetAddress &remote)
+    : conditions(linkConditions), remoteAddress(remote), rng(linkConditions.seed)
+{
+	upstream.kbps = conditions.upKbps;
+	downstream.kbps = conditions.downKbps;
+
+	socket = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+	if (socket == ENET_SOCKET_NULL)
+	{
+		ERROR_LOG(SLIPPI_ONLINE, "[LinkSim] Could not create relay socket");
+		return;
+	}
+
+	ENetAddress bindAddress;
+	bindAddress.host = ENET_HOST_ANY;
+	bindAddress.port = 0;
+	if (enet_socket_bind(socket, &bindAddress) < 0 || enet_socket_get_address(socket, &localAddress) < 0)
+	{
+		ERROR_LOG(SLIPPI_ONLINE, "[LinkSim] Could not bind relay socket");
+		enet_socket_destroy(socket);
+		socket = ENET_SOCKET_NULL;
+		return;
+	}
+	enet_socket_set_option(socket, ENET_SOCKOPT_NONBLOCK, 1);
+	enet_address_set_host(&localAddress, "127.0.0.1");
+
+	INFO_LOG(SLIPPI_ONLINE, "[LinkSim] Relaying 127.0.0.1:%d to %x:%d with %s", localAddress.port, remoteAddress.host,
+	         remoteAddress.port, DescribeConditions(conditions).c_str());
+
+	isRunning = true;
+	thread = std::thread(&SlippiLinkSimulator::threadFunc, this);
+}
+
+SlippiLinkSimulator::~SlippiLinkSimulator()
+{
+	isRunning = false;
+	if (thread.joinable())
+		thread.join();
+
+	if (socket != ENET_SOCKET_NULL)
+		enet_socket_destroy(socket);
+
+	INFO_LOG(SLIPPI_ONLINE, "[LinkSim] Up: %llu forwarded, %llu dropped, %llu reordered. Down: %llu forwarded, %llu "
+	                        "dropped, %llu reordered",
+	         (unsigned long long)upstream.stats.forwarded, (unsigned long long)upstream.stats.dropped,
+	         (unsigned long long)upstream.stats.reordered, (unsigned long long)downstream.stats.forwarded,
+	         (unsigned long long)downstream.stats.dropped, (unsigned long long)downstream.stats.reordered);
+}
+
+SlippiLinkSimulator::DirectionStats SlippiLinkSimulator::GetStats(bool isUpstream)
+{
+	std::lock_guard<std::mutex> lk(statsMutex);
+	return isUpstream ? upstream.stats : downstream.stats;
+}
+
+void SlippiLinkSimulator::threadFunc()
+{
+	Common::SetCurrentThreadName("Slippi Link Simulator");
+
+	while (isRunning)
+	{
+		u64 nowUs = Common::Timer::GetTimeUs();
+		deliver(nowUs);
+
+		// Sleep until the next packet is due or something arrives, the last millisecond is spun away so
+		// the delays stay accurate
+		u32 waitMs = 5;
+		if (!inFlight.empty())
+		{
+			u64 dueUs = inFlight.top().deliverUs;
+			waitMs = dueUs <= nowUs + 1000 ? 0 : (u32)std::min<u64>(5, (dueUs - nowUs) / 1000 - 1);
+		}
+
+		enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+		if (enet_socket_wait(socket, &condition, waitMs) < 0)
+			break;
+
+		if (condition & ENET_SOCKET_WAIT_RECEIVE)
+			receive(Common::Timer::GetTimeUs());
+		else if (waitMs == 0)
+			Common::YieldCPU();
+	}
+}
+
+void SlippiLinkSimulator::receive(u64 nowUs)
+{
+	u8 buf[LINK_SIM_MAX_DATAGRAM];
+	while (true)
+	{
+		ENetAddress from;
+		ENetBuffer buffer;
+		buffer.data = buf;
+		buffer.dataLength = sizeof(buf);
+		int length = enet_socket_receive(socket, &from, &buffer, 1);
+		if (length <= 0)
+			break;
+
+		// Anything that doesn't come from the remote is the local client. Its address is only known once it
+		// sends something
+		bool isFromRemote = from.host == remoteAddress.host && from.port == remoteAddress.port;
+		if (!isFromRemote)
+		{
+			clientAddress = from;
+			hasClient = true;
+		}
+
+		schedule(!isFromRemote, buf, length, nowUs);
+	}
+}
+
+void SlippiLinkSimulator::schedule(bool isUpstream, const u8 *data, size_t length, u64 nowUs)
+{
+	Direction &direction = isUpstream ? upstream : downstream;
+	std::lock_guard<std::mutex> lk(statsMutex);
+
+	std::uniform_real_distribution<double> percent(0.0, 100.0);
+	if (percent(rng) < conditions.lossPercent)
+	{
+		direction.stats.dropped++;
+		return;
+	}
+
+	// Time the packet needs on the wire, it has to wait for the ones in front of it
+	u64 sendUs = nowUs;
+	if (direction.kbps)
+	{
+		u64 serializeUs = length * 8 * 1000 / direction.kbps;
+		sendUs = std::max(nowUs, direction.linkFreeUs) + serializeUs;
+		if (sendUs - nowUs > LINK_SIM_MAX_QUEUE_US)
+		{
+			direction.stats.dropped++;
+			return;
+		}
+		direction.linkFreeUs = sendUs;
+	}
+
+	u64 jitterUs = 0;
+	if (conditions.jitterMs)
+		jitterUs = std::uniform_int_distribution<u64>(0, conditions.jitterMs * 1000)(rng);
+	u64 deliverUs = sendUs + conditions.latencyMs * 1000 + jitterUs;
+
+	// Jitter alone doesn't reorder, a real link keeps packets in order unless they take a different route.
+	// A reordered packet is held back by at least another jitter window so the ones after it overtake it
+	if (percent(rng) < conditions.reorderPercent)
+	{
+		deliverUs += std::max<u64>(conditions.jitterMs * 1000, 1000) + jitterUs;
+		direction.stats.reordered++;
+	}
+	else
+	{
+		deliverUs = std::max(deliverUs, direction.lastDeliverUs);
+		direction.lastDeliverUs = deliverUs;
+	}
+
+	inFlight.push({deliverUs, nextSeq++, isUpstream, std::vector<u8>(data, data + length)});
+}
+
+void SlippiLinkSimulator::deliver(u64 nowUs)
+{
+	while (!inFlight.empty() && inFlight.top().deliverUs <= nowUs)
+	{
+		const Datagram &datagram = inFlight.top();
+
+		// Nowhere to send replies before the client has said anything
+		if (datagram.isUpstream || hasClient)
+		{
+			ENetBuffer buffer;
+			buffer.data = (void *)datagram.data.data();
+			buffer.dataLength = datagram.data.size();
+			enet_socket_send(socket, datagram.isUpstream ? &remoteAddress : &clientAddress, &buffer, 1);
+
+			std::lock_guard<std::mutex> lk(statsMutex);
+			Direction &direction = datagram.isUpstream ? upstream : downstream;
+			direction.stats.forwarded++;
+			direction.stats.bytes += datagram.data.size();
+		}
+
+		inFlight.pop();
+	}
+}
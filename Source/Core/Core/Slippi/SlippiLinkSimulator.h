@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <enet/enet.h>
+
+#include "Common/CommonTypes.h"
+
+// Local UDP relay that sits between SlippiNetplayClient and one remote player and makes the link behave
+// like a bad connection. The client connects to the relay instead of the remote, everything it sends is
+// forwarded upstream and everything coming back is forwarded to it, each with its own delay, loss and
+// bandwidth. Running it on every local instance puts every connection through a simulated link
+class SlippiLinkSimulator
+{
+  public:
+	typedef struct
+	{
+		// One way delay added in each direction
+		u32 latencyMs = 0;
+		// Uniformly spread on top of the latency
+		u32 jitterMs = 0;
+		double lossPercent = 0;
+		// Packets that are held back behind the ones sent after them
+		double reorderPercent = 0;
+		// 0 means unlimited. Up is what the local instance sends
+		u32 upKbps = 0;
+		u32 downKbps = 0;
+		u32 seed = 0;
+	} Conditions;
+
+	typedef struct
+	{
+		u64 forwarded = 0;
+		u64 dropped = 0;
+		u64 reordered = 0;
+		u64 bytes = 0;
+	} DirectionStats;
+
+	// Parses something like "latency=60,jitter=8,loss=2,reorder=1,up=512,down=2048,seed=1". Returns false
+	// when the spec is empty or invalid, the simulator is disabled in that case
+	static bool ParseConditions(const std::string &spec, Conditions &conditions);
+	static std::string DescribeConditions(const Conditions &conditions);
+
+	SlippiLinkSimulator(const Conditions &linkConditions, const ENetAddress &remote);
+	~SlippiLinkSimulator();
+
+	bool IsRunning() const { return isRunning; }
+
+	// Address the netplay client should connect to instead of the remote
+	ENetAddress GetLocalAddress() const { return localAddress; }
+
+	DirectionStats GetStats(bool isUpstream);
+
+  private:
+	typedef struct
+	{
+		u64 deliverUs;
+		u64 seq;
+		bool isUpstream;
+		std::vector<u8> data;
+	} Datagram;
+
+	struct LaterDatagram
+	{
+		bool operator()(const Datagram &a, const Datagram &b) const
+		{
+			return a.deliverUs != b.deliverUs ? a.deliverUs > b.deliverUs : a.seq > b.seq;
+		}
+	};
+
+	typedef struct
+	{
+		u32 kbps = 0;
+		// When the simulated link is done serializing the packets queued on it
+		u64 linkFreeUs = 0;
+		// Delivery time of the last packet that kept its order
+		u64 lastDeliverUs = 0;
+		DirectionStats stats;
+	} Direction;
+
+	void threadFunc();
+	void receive(u64 nowUs);
+	void schedule(bool isUpstream, const u8 *data, size_t length, u64 nowUs);
+	void deliver(u64 nowUs);
+
+	Conditions conditions;
+	ENetAddress remoteAddress;
+	ENetAddress localAddress = {};
+	ENetAddress clientAddress = {};
+	bool hasClient = false;
+
+	ENetSocket socket = ENET_SOCKET_NULL;
+	std::thread thread;
+	std::atomic<bool> isRunning{false};
+
+	std::mt19937 rng;
+	std::priority_queue<Datagram, std::vector<Datagram>, LaterDatagram> inFlight;
+	u64 nextSeq = 0;
+
+	std::mutex statsMutex;
+	Direction upstream;
+	Direction downstream;
+};
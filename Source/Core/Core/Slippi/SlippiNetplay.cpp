@@ -6,6 +6,7 @@
 #include "Common/CommonTypes.h"
 #include "Common/ENetUtil.h"
 #include "Common/MsgHandler.h"
+#include "Common/Thread.h"
 #include "Common/Timer.h"
 #include "Core/ConfigManager.h"
 #include "Core/Core.h"
@@ -13,6 +14,7 @@
 #include "VideoCommon/OnScreenDisplay.h"
 #include "VideoCommon/VideoConfig.h"
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <memory>
 #include <thread>
@@ -37,6 +39,121 @@ static std::mutex ack_mutex;
 
 SlippiNetplayClient *SLIPPI_NETPLAY = nullptr;
 
+// Compact pad packets hold the most recent frame in the packet as a zigzag varint, how many frames the sender is
+// past it as a varint, the player port, the number of pads, the most recent pad as is and then every older pad as
+// a mask of the bytes that differ from the pad after it followed by just those bytes. Held inputs only take a
+// single byte per frame that way. With a redundancy limit the pads in a packet can be older than the sender's
+// current frame, which is what time sync and ping have to go by
+#define COMPACT_PADS_MAX_SIZE (1 + 5 + 5 + 1 + 1 + SLIPPI_PAD_RING_SIZE * (1 + SLIPPI_PAD_DATA_SIZE))
+
+static u8 *writeVarint(u8 *out, u32 value)
+{
+	while (value >= 0x80)
+	{
+		*out++ = (u8)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (u8)value;
+	return out;
+}
+
+static bool readVarint(const u8 *&in, const u8 *end, u32 &value)
+{
+	value = 0;
+	for (int shift = 0;; shift += 7)
+	{
+		if (in == end || shift > 28)
+			return false;
+
+		u8 byte = *in++;
+		value |= (u32)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+}
+
+static void writeCompactPads(sf::Packet &packet, const SlippiPadRing &pads, u32 newestIdx, u32 count, u8 port)
+{
+	u8 buf[COMPACT_PADS_MAX_SIZE];
+	u8 *out = buf;
+
+	*out++ = NP_MSG_SLIPPI_PAD_COMPACT;
+
+	int32_t frame = pads.At(newestIdx).frame;
+	out = writeVarint(out, ((u32)frame << 1) ^ (u32)(frame >> 31));
+	out = writeVarint(out, (u32)(pads.Front().frame - frame));
+
+	*out++ = port;
+	*out++ = (u8)count;
+
+	memcpy(out, pads.At(newestIdx).padBuf, SLIPPI_PAD_DATA_SIZE);
+	out += SLIPPI_PAD_DATA_SIZE;
+
+	for (u32 i = newestIdx + 1; i < newestIdx + count; i++)
+	{
+		const u8 *newer = pads.At(i - 1).padBuf;
+		const u8 *older = pads.At(i).padBuf;
+
+		u8 *mask = out++;
+		*mask = 0;
+		for (int b = 0; b < SLIPPI_PAD_DATA_SIZE; b++)
+		{
+			if (older[b] == newer[b])
+				continue;
+
+			*mask |= 1 << b;
+			*out++ = older[b];
+		}
+	}
+
+	packet.append(buf, out - buf);
+}
+
+// Fills pads with count pads, most recent first. latestFrame is the frame the sender was on
+static bool readCompactPads(sf::Packet &packet, int32_t &frame, int32_t &latestFrame, u8 &port,
+                            u8 pads[][SLIPPI_PAD_DATA_SIZE], int &count)
+{
+	const u8 *in = (const u8 *)packet.getData() + 1;
+	const u8 *end = (const u8 *)packet.getData() + packet.getDataSize();
+
+	u32 zigzag, latestOffset;
+	if (!readVarint(in, end, zigzag) || !readVarint(in, end, latestOffset))
+		return false;
+	frame = (int32_t)((zigzag >> 1) ^ (0u - (zigzag & 1)));
+	latestFrame = frame + (int32_t)latestOffset;
+
+	if (end - in < 2 + SLIPPI_PAD_DATA_SIZE)
+		return false;
+
+	port = *in++;
+	count = *in++;
+	if (count == 0 || count > SLIPPI_PAD_RING_SIZE)
+		return false;
+
+	memcpy(pads[0], in, SLIPPI_PAD_DATA_SIZE);
+	in += SLIPPI_PAD_DATA_SIZE;
+
+	for (int i = 1; i < count; i++)
+	{
+		if (in == end)
+			return false;
+
+		u8 mask = *in++;
+		memcpy(pads[i], pads[i - 1], SLIPPI_PAD_DATA_SIZE);
+		for (int b = 0; b < SLIPPI_PAD_DATA_SIZE; b++)
+		{
+			if (!(mask & (1 << b)))
+				continue;
+
+			if (in == end)
+				return false;
+			pads[i][b] = *in++;
+		}
+	}
+
+	return true;
+}
+
 // called from ---GUI--- thread
 SlippiNetplayClient::~SlippiNetplayClient()
 {
@@ -44,6 +161,8 @@ SlippiNetplayClient::~SlippiNetplayClient()
 	if (m_thread.joinable())
 		m_thread.join();
 
+	logPredictionStats();
+
 	if (!m_server.empty())
 	{
 		Disconnect();
@@ -87,11 +206,12 @@ SlippiNetplayClient::SlippiNetplayClient(std::vector<std::string> addrs, std::ve
 		this->matchInfo.remotePlayerSelections[i] = SlippiPlayerSelections();
 		this->matchInfo.remotePlayerSelections[i].playerIdx = j;
 
-		this->remotePadQueue[i] = std::deque<std::unique_ptr<SlippiPad>>();
+		this->remotePadQueue[i].Clear();
 		this->frameOffsetData[i] = FrameOffsetData();
 		this->lastFrameTiming[i] = FrameTiming();
 		this->pingUs[i] = 0;
 		this->lastFrameAcked[i] = 0;
+		this->remoteNetplayFlags[i] = 0;
 	}
 
 	SLIPPI_NETPLAY = std::move(this);
@@ -121,11 +241,28 @@ SlippiNetplayClient::SlippiNetplayClient(std::vector<std::string> addrs, std::ve
 		PanicAlertT("Couldn't Create Client");
 	}
 
+	SlippiLinkSimulator::Conditions linkConditions;
+	bool isLinkSimulated =
+	    SlippiLinkSimulator::ParseConditions(SConfig::GetInstance().m_slippiLinkSimulator, linkConditions);
+
 	for (int i = 0; i < remotePlayerCount; i++)
 	{
 		ENetAddress addr;
 		enet_address_set_host(&addr, addrs[i].c_str());
 		addr.port = ports[i];
+
+		// Go through a local relay that degrades the link instead of talking to the remote directly
+		if (isLinkSimulated)
+		{
+			SlippiLinkSimulator::Conditions playerConditions = linkConditions;
+			playerConditions.seed += i;
+			auto simulator = std::make_unique<SlippiLinkSimulator>(playerConditions, addr);
+			if (simulator->IsRunning())
+			{
+				addr = simulator->GetLocalAddress();
+				m_link_simulators.push_back(std::move(simulator));
+			}
+		}
 		// INFO_LOG(SLIPPI_ONLINE, "Set ENet host, addr = %x, port = %d", addr.host, addr.port);
 
 		ENetPeer *peer = enet_host_connect(m_client, &addr, 3, 0);
@@ -189,21 +326,39 @@ unsigned int SlippiNetplayClient::OnData(sf::Packet &packet, ENetPeer *peer)
 	switch (mid)
 	{
 	case NP_MSG_SLIPPI_PAD:
+	case NP_MSG_SLIPPI_PAD_COMPACT:
 	{
 		// Fetch current time immediately for the most accurate timing calculations
 		u64 curTime = Common::Timer::GetTimeUs();
 
+		bool isCompact = mid == NP_MSG_SLIPPI_PAD_COMPACT;
+		u8 compactPads[SLIPPI_PAD_RING_SIZE][SLIPPI_PAD_DATA_SIZE];
+		int compactPadCount = 0;
+
 		int32_t frame;
-		if (!(packet >> frame))
+		int32_t latestFrame;
+		u8 packetPlayerPort;
+		if (isCompact)
 		{
-			ERROR_LOG(SLIPPI_ONLINE, "Netplay packet too small to read frame count");
-			break;
+			if (!readCompactPads(packet, frame, latestFrame, packetPlayerPort, compactPads, compactPadCount))
+			{
+				ERROR_LOG(SLIPPI_ONLINE, "Compact netplay pad packet is malformed. Size: %d", (int)packet.getDataSize());
+				break;
+			}
 		}
-		u8 packetPlayerPort;
-		if (!(packet >> packetPlayerPort))
+		else
 		{
-			ERROR_LOG(SLIPPI_ONLINE, "Netplay packet too small to read player index");
-			break;
+			if (!(packet >> frame))
+			{
+				ERROR_LOG(SLIPPI_ONLINE, "Netplay packet too small to read frame count");
+				break;
+			}
+			if (!(packet >> packetPlayerPort))
+			{
+				ERROR_LOG(SLIPPI_ONLINE, "Netplay packet too small to read player index");
+				break;
+			}
+			latestFrame = frame;
 		}
 		u8 pIdx = PlayerIdxFromPort(packetPlayerPort);
 		if (pIdx >= m_remotePlayerCount)
@@ -264,7 +419,7 @@ unsigned int SlippiNetplayClient::OnData(sf::Packet &packet, ENetPeer *peer)
 		}
 
 		s64 opponentSendTimeUs = curTime - (pingUs[pIdx] / 2);
-		s64 frameDiffOffsetUs = 16683 * (timing.frame - frame);
+		s64 frameDiffOffsetUs = 16683 * (timing.frame - latestFrame);
 		s64 timeOffsetUs = opponentSendTimeUs - timing.timeUs + frameDiffOffsetUs;
 
 		// INFO_LOG(SLIPPI_ONLINE, "[Offset] Opp Frame: %d, My Frame: %d. Time offset: %lld", frame, timing.frame,
@@ -277,6 +432,7 @@ unsigned int SlippiNetplayClient::OnData(sf::Packet &packet, ENetPeer *peer)
 			frameOffsetData[pIdx].buf[frameOffsetData[pIdx].idx] = (s32)timeOffsetUs;
 
 		frameOffsetData[pIdx].idx = (frameOffsetData[pIdx].idx + 1) % SLIPPI_ONLINE_LOCKSTEP_INTERVAL;
+		timeSync.AddSample(pIdx, timeOffsetUs, pingUs[pIdx]);
 
 		{
 			std::lock_guard<std::mutex> lk(pad_mutex); // TODO: Is this the correct lock?
@@ -287,11 +443,20 @@ unsigned int SlippiNetplayClient::OnData(sf::Packet &packet, ENetPeer *peer)
 			// pIdx,
 			//         frame);
 
-			int32_t headFrame = remotePadQueue[pIdx].empty() ? 0 : remotePadQueue[pIdx].front()->frame;
+			int32_t headFrame = remotePadQueue[pIdx].Empty() ? 0 : remotePadQueue[pIdx].Front().frame;
 			int inputsToCopy = frame - headFrame;
 
+			// Pads are always sent starting from the oldest unacked one, so a compact packet that doesn't
+			// reach back to the pads we have can only be a stale one
+			if (isCompact && inputsToCopy > compactPadCount)
+			{
+				ERROR_LOG(SLIPPI_ONLINE, "Compact netplay packet doesn't connect to received pads. Inputs: %d, Pads: %d",
+				          inputsToCopy, compactPadCount);
+				break;
+			}
+
 			// Check that the packet actually contains the data it claims to
-			if ((6 + inputsToCopy * SLIPPI_PAD_DATA_SIZE) > (int)packet.getDataSize())
+			if (!isCompact && (6 + inputsToCopy * SLIPPI_PAD_DATA_SIZE) > (int)packet.getDataSize())
 			{
 				ERROR_LOG(SLIPPI_ONLINE,
 				          "Netplay packet too small to read pad buffer. Size: %d, Inputs: %d, MinSize: %d",
@@ -299,15 +464,29 @@ unsigned int SlippiNetplayClient::OnData(sf::Packet &packet, ENetPeer *peer)
 				break;
 			}
 
-			for (int i = inputsToCopy - 1; i >= 0; i--)
+			// Anything older than what fits in the ring would be overwritten right away anyway
+			if (inputsToCopy > SLIPPI_PAD_RING_SIZE)
 			{
-				auto pad = std::make_unique<SlippiPad>(frame - i, pIdx, &packetData[6 + i * SLIPPI_PAD_DATA_SIZE]);
-				// INFO_LOG(SLIPPI_ONLINE, "Rcv [%d] -> %02X %02X %02X %02X %02X %02X %02X %02X", pad->frame,
-				//         pad->padBuf[0], pad->padBuf[1], pad->padBuf[2], pad->padBuf[3], pad->padBuf[4],
-				//         pad->padBuf[5], pad->padBuf[6], pad->padBuf[7]);
+				ERROR_LOG(SLIPPI_ONLINE, "Received %d inputs from player %d, more than fit in the pad ring", inputsToCopy,
+				          pIdx);
+				inputsToCopy = SLIPPI_PAD_RING_SIZE;
+			}
 
-				remotePadQueue[pIdx].push_front(std::move(pad));
+			const u8 *newPads[SLIPPI_PAD_RING_SIZE];
+			for (int i = inputsToCopy - 1; i >= 0; i--)
+			{
+				u8 *padData = isCompact ? compactPads[i] : &packetData[6 + i * SLIPPI_PAD_DATA_SIZE];
+				newPads[inputsToCopy - 1 - i] = padData;
+				SlippiPad pad(frame - i, pIdx, padData);
+				// INFO_LOG(SLIPPI_ONLINE, "Rcv [%d] -> %02X %02X %02X %02X %02X %02X %02X %02X", pad.frame,
+				//         pad.padBuf[0], pad.padBuf[1], pad.padBuf[2], pad.padBuf[3], pad.padBuf[4],
+				//         pad.padBuf[5], pad.padBuf[6], pad.padBuf[7]);
+
+				remotePadQueue[pIdx].PushFront(pad);
 			}
+
+			if (inputsToCopy > 0)
+				predictionEvaluators[pIdx].Observe(newPads, inputsToCopy);
 		}
 
 		// Send Ack
@@ -389,12 +568,17 @@ unsigned int SlippiNetplayClient::OnData(sf::Packet &packet, ENetPeer *peer)
 		u8 idx = PlayerIdxFromPort(s->playerIdx);
 		matchInfo.remotePlayerSelections[idx].Merge(*s);
 
+		// Older clients don't send any flags, reading past the end leaves this at 0
+		u8 netplayFlags = 0;
+		packet >> netplayFlags;
+		remoteNetplayFlags[idx] = netplayFlags;
+
 		// This might be a good place to reset some logic? Game can't start until we receive this msg
 		// so this should ensure that everything is initialized before the game starts
 		hasGameStarted = false;
 
 		// Reset remote pad queue such that next inputs that we get are not compared to inputs from last game
-		remotePadQueue[idx].clear();
+		remotePadQueue[idx].Clear();
 	}
 	break;
 
@@ -443,6 +627,9 @@ void SlippiNetplayClient::writeToPacket(sf::Packet &packet, SlippiPlayerSelectio
 	packet << s.stageId << s.isStageSelected;
 	packet << s.rngOffset;
 	packet << s.teamId;
+
+	u8 netplayFlags = SConfig::GetInstance().m_slippiCompactPads ? SLIPPI_NETPLAY_FLAG_COMPACT_PADS : 0;
+	packet << netplayFlags;
 }
 
 void SlippiNetplayClient::WriteChatMessageToPacket(sf::Packet &packet, int messageId, u8 playerIdx)
@@ -503,6 +690,21 @@ void SlippiNetplayClient::Send(sf::Packet &packet)
 	}
 }
 
+bool SlippiNetplayClient::IsCompactPadsNegotiated()
+{
+	if (!SConfig::GetInstance().m_slippiCompactPads)
+		return false;
+
+	// Pad packets go out to everyone at once so every remote player has to understand them
+	for (int i = 0; i < m_remotePlayerCount; i++)
+	{
+		if (!(remoteNetplayFlags[i] & SLIPPI_NETPLAY_FLAG_COMPACT_PADS))
+			return false;
+	}
+
+	return true;
+}
+
 void SlippiNetplayClient::Disconnect()
 {
 	ENetEvent netEvent;
@@ -555,7 +757,26 @@ void SlippiNetplayClient::SendAsync(std::unique_ptr<sf::Packet> packet)
 		std::lock_guard<std::recursive_mutex> lkq(m_crit.async_queue_write);
 		m_async_queue.Push(std::move(packet));
 	}
-	ENetUtil::WakeupThread(m_client);
+
+	// A busy polling thread picks the packet up on its own, no need for the extra syscall
+	if (!m_is_busy_polling)
+		ENetUtil::WakeupThread(m_client);
+}
+
+// called from ---NETPLAY--- thread
+void SlippiNetplayClient::FlushAsyncQueue()
+{
+	if (m_async_queue.Empty())
+		return;
+
+	while (!m_async_queue.Empty())
+	{
+		Send(*(m_async_queue.Front().get()));
+		m_async_queue.Pop();
+	}
+
+	// Put the packets on the wire now instead of on the next enet_host_service call
+	enet_host_flush(m_client);
 }
 
 // called from ---NETPLAY--- thread
@@ -771,16 +992,28 @@ void SlippiNetplayClient::ThreadFunc()
 	}
 #endif
 
+	// Busy polling keeps a core spinning on the socket for the whole session, which takes the thread
+	// wakeup out of the path between SendSlippiPad and the input leaving the machine
+	bool isBusyPoll = SConfig::GetInstance().m_slippiNetplayBusyPoll;
+	int busyPollCore = SConfig::GetInstance().m_slippiNetplayBusyPollCore;
+	if (isBusyPoll && busyPollCore >= 0 && busyPollCore < 32)
+		Common::SetCurrentThreadAffinity(1u << busyPollCore);
+	m_is_busy_polling = isBusyPoll;
+	INFO_LOG(SLIPPI_ONLINE, "[Netplay] Network thread mode: %s", isBusyPoll ? "busy poll" : "event driven");
+
 	while (m_do_loop.IsSet())
 	{
+		FlushAsyncQueue();
+
 		ENetEvent netEvent;
 		int net;
-		net = enet_host_service(m_client, &netEvent, 250);
-		while (!m_async_queue.Empty())
-		{
-			Send(*(m_async_queue.Front().get()));
-			m_async_queue.Pop();
-		}
+		net = enet_host_service(m_client, &netEvent, isBusyPoll ? 0 : 250);
+
+		// Whatever got queued while we were waiting goes out before the event is handled
+		FlushAsyncQueue();
+
+		if (net <= 0 && isBusyPoll)
+			Common::YieldCPU();
 
 		if (net > 0)
 		{
@@ -853,6 +1086,8 @@ void SlippiNetplayClient::ThreadFunc()
 		}
 	}
 
+	m_is_busy_polling = false;
+
 #ifdef _WIN32
 	if (m_qos_handle != 0)
 	{
@@ -897,7 +1132,15 @@ void SlippiNetplayClient::StartSlippiGame()
 	// Reset variables to start a new game
 	hasGameStarted = false;
 
-	localPadQueue.clear();
+	localPadQueue.Clear();
+	timeSync.Reset(m_remotePlayerCount);
+
+	logPredictionStats();
+	{
+		std::lock_guard<std::mutex> lk(pad_mutex);
+		for (auto &evaluator : predictionEvaluators)
+			evaluator.Reset();
+	}
 
 	for (int i = 0; i < m_remotePlayerCount; i++)
 	{
@@ -915,6 +1158,25 @@ void SlippiNetplayClient::StartSlippiGame()
 	matchInfo.Reset();
 }
 
+void SlippiNetplayClient::logPredictionStats()
+{
+	std::lock_guard<std::mutex> lk(pad_mutex);
+	for (int i = 0; i < m_remotePlayerCount; i++)
+	{
+		std::string summary = predictionEvaluators[i].Summary();
+		if (!summary.empty())
+			INFO_LOG(SLIPPI_ONLINE, "[Prediction] Remote player %d mispredictions: %s", i, summary.c_str());
+	}
+}
+
+std::string SlippiNetplayClient::GetPredictionSummary(int index)
+{
+	std::lock_guard<std::mutex> lk(pad_mutex);
+	if (index < 0 || index >= m_remotePlayerCount)
+		return "";
+	return predictionEvaluators[index].Summary();
+}
+
 void SlippiNetplayClient::SendConnectionSelected()
 {
 	isConnectionSelected = true;
@@ -924,7 +1186,7 @@ void SlippiNetplayClient::SendConnectionSelected()
 	SendAsync(std::move(spac));
 }
 
-void SlippiNetplayClient::SendSlippiPad(std::unique_ptr<SlippiPad> pad)
+void SlippiNetplayClient::SendSlippiPad(const SlippiPad *pad)
 {
 	auto status = slippiConnectStatus;
 	bool connectionFailed = status == SlippiNetplayClient::SlippiConnectStatus::NET_CONNECT_STATUS_FAILED;
@@ -943,7 +1205,8 @@ void SlippiNetplayClient::SendSlippiPad(std::unique_ptr<SlippiPad> pad)
 	if (pad)
 	{
 		// Add latest local pad report to queue
-		localPadQueue.push_front(std::move(pad));
+		if (!localPadQueue.PushFront(*pad))
+			ERROR_LOG(SLIPPI_ONLINE, "Local pad ring is full, dropped an unacked input");
 	}
 
 	// Remove pad reports that have been received and acked
@@ -954,34 +1217,67 @@ void SlippiNetplayClient::SendSlippiPad(std::unique_ptr<SlippiPad> pad)
 			minAckFrame = lastFrameAcked[i];
 	}
 	// INFO_LOG(SLIPPI_ONLINE, "Checking to drop local inputs, oldest frame: %d | minAckFrame: %d | %d, %d, %d",
-	//         localPadQueue.back()->frame, minAckFrame, lastFrameAcked[0], lastFrameAcked[1], lastFrameAcked[2]);
-	while (!localPadQueue.empty() && localPadQueue.back()->frame < minAckFrame)
+	//         localPadQueue.Back().frame, minAckFrame, lastFrameAcked[0], lastFrameAcked[1], lastFrameAcked[2]);
+	while (!localPadQueue.Empty() && localPadQueue.Back().frame < minAckFrame)
 	{
-		// INFO_LOG(SLIPPI_ONLINE, "Dropping local input for frame %d from queue", localPadQueue.back()->frame);
-		localPadQueue.pop_back();
+		// INFO_LOG(SLIPPI_ONLINE, "Dropping local input for frame %d from queue", localPadQueue.Back().frame);
+		localPadQueue.PopBack();
 	}
 
-	if (localPadQueue.empty())
+	if (localPadQueue.Empty())
 	{
 		// If pad queue is empty now, there's no reason to send anything
 		return;
 	}
 
-	auto frame = localPadQueue.front()->frame;
+	// With a redundancy limit only that many unacked pads are sent per packet. The oldest ones go first such
+	// that the remote side can always chain them onto the pads it already has. Only compact packets tell the
+	// remote side which frame the sender is on when that isn't the newest pad in the packet, so the limit only
+	// applies to them
+	bool isCompact = IsCompactPadsNegotiated();
+	u32 padCount = localPadQueue.Size();
+	int redundancy = SConfig::GetInstance().m_slippiPadRedundancy;
+	if (redundancy > 0 && isCompact)
+	{
+		// A packet has to reach the newest pad whenever nothing was lost, so the limit is never below the
+		// frames sent in a round trip. Otherwise new inputs would reach the remote at the limit per round trip
+		// and it would fall further behind for good
+		u64 maxPingUs = 0;
+		{
+			std::lock_guard<std::mutex> lk(ack_mutex);
+			for (int i = 0; i < m_remotePlayerCount; i++)
+				maxPingUs = std::max(maxPingUs, pingUs[i]);
+		}
+		int roundTripFrames = (int)(maxPingUs / 16683) + 2;
+		redundancy = std::max(redundancy, roundTripFrames);
+		if (padCount > (u32)redundancy)
+			padCount = redundancy;
+	}
+	u32 newestIdx = localPadQueue.Size() - padCount;
 
-	auto spac = std::make_unique<sf::Packet>();
-	*spac << static_cast<MessageId>(NP_MSG_SLIPPI_PAD);
-	*spac << frame;
-	*spac << this->playerIdx;
+	auto frame = localPadQueue.At(newestIdx).frame;
+	auto latestFrame = localPadQueue.Front().frame;
 
-	// INFO_LOG(SLIPPI_ONLINE, "Sending a packet of inputs [%d]...", frame);
-	for (auto it = localPadQueue.begin(); it != localPadQueue.end(); ++it)
+	auto spac = std::make_unique<sf::Packet>();
+	if (isCompact)
 	{
-		// INFO_LOG(SLIPPI_ONLINE, "Send [%d] -> %02X %02X %02X %02X %02X %02X %02X %02X", (*it)->frame,
-		// (*it)->padBuf[0],
-		//         (*it)->padBuf[1], (*it)->padBuf[2], (*it)->padBuf[3], (*it)->padBuf[4], (*it)->padBuf[5],
-		//         (*it)->padBuf[6], (*it)->padBuf[7]);
-		spac->append((*it)->padBuf, SLIPPI_PAD_DATA_SIZE); // only transfer 8 bytes per pad
+		writeCompactPads(*spac, localPadQueue, newestIdx, padCount, this->playerIdx);
+	}
+	else
+	{
+		*spac << static_cast<MessageId>(NP_MSG_SLIPPI_PAD);
+		*spac << frame;
+		*spac << this->playerIdx;
+
+		// INFO_LOG(SLIPPI_ONLINE, "Sending a packet of inputs [%d]...", frame);
+		for (u32 i = newestIdx; i < newestIdx + padCount; i++)
+		{
+			// INFO_LOG(SLIPPI_ONLINE, "Send [%d] -> %02X %02X %02X %02X %02X %02X %02X %02X", localPadQueue.At(i).frame,
+			//         localPadQueue.At(i).padBuf[0], localPadQueue.At(i).padBuf[1], localPadQueue.At(i).padBuf[2],
+			//         localPadQueue.At(i).padBuf[3], localPadQueue.At(i).padBuf[4], localPadQueue.At(i).padBuf[5],
+			//         localPadQueue.At(i).padBuf[6], localPadQueue.At(i).padBuf[7]);
+			spac->append(localPadQueue.At(i).padBuf, SLIPPI_PAD_DATA_SIZE); // only transfer 8 bytes per pad
+		}
 	}
 
 	SendAsync(std::move(spac));
@@ -993,11 +1289,15 @@ void SlippiNetplayClient::SendSlippiPad(std::unique_ptr<SlippiPad> pad)
 	for (int i = 0; i < m_remotePlayerCount; i++)
 	{
 		FrameTiming timing;
-		timing.frame = frame;
+		timing.frame = latestFrame;
 		timing.timeUs = time;
 		lastFrameTiming[i] = timing;
 
-		// Add send time to ack timers
+		// Add send time to ack timers. A packet held back by the redundancy limit repeats a frame that was
+		// first sent a while ago, its ack would make the ping look that much longer
+		if (frame != latestFrame)
+			continue;
+
 		FrameTiming sendTime;
 		sendTime.frame = frame;
 		sendTime.timeUs = time;
@@ -1050,36 +1350,27 @@ u8 SlippiNetplayClient::GetSlippiRemoteSentChatMessage()
 	return copiedMessageId;
 }
 
-std::unique_ptr<SlippiRemotePadOutput> SlippiNetplayClient::GetSlippiRemotePad(int32_t curFrame, int index)
+int32_t SlippiNetplayClient::GetSlippiRemotePad(int32_t curFrame, int index, u8 *out, int maxPads)
 {
 	std::lock_guard<std::mutex> lk(pad_mutex); // TODO: Is this the correct lock?
 
-	std::unique_ptr<SlippiRemotePadOutput> padOutput = std::make_unique<SlippiRemotePadOutput>();
-
-	if (remotePadQueue[index].empty())
-	{
-		auto emptyPad = std::make_unique<SlippiPad>(0);
-
-		padOutput->latestFrame = emptyPad->frame;
+	memset(out, 0, maxPads * SLIPPI_PAD_FULL_SIZE);
 
-		auto emptyIt = std::begin(emptyPad->padBuf);
-		padOutput->data.insert(padOutput->data.end(), emptyIt, emptyIt + SLIPPI_PAD_FULL_SIZE);
-
-		return std::move(padOutput);
-	}
+	SlippiPadRing &queue = remotePadQueue[index];
+	if (queue.Empty())
+		return 0;
 
-	padOutput->latestFrame = 0;
-	// Copy the entire remaining remote buffer
-	for (auto it = remotePadQueue[index].begin(); it != remotePadQueue[index].end(); ++it)
-	{
-		if ((*it)->frame > padOutput->latestFrame)
-			padOutput->latestFrame = (*it)->frame;
+	// Skip over the pads we've received for frames the game hasn't reached yet
+	int32_t firstFrame = std::min(queue.Front().frame, curFrame);
+	int firstIdx = queue.IndexOf(firstFrame);
+	if (firstIdx < 0)
+		return firstFrame;
 
-		auto padIt = std::begin((*it)->padBuf);
-		padOutput->data.insert(padOutput->data.end(), padIt, padIt + SLIPPI_PAD_FULL_SIZE);
-	}
+	int padCount = std::min(maxPads, (int)queue.Size() - firstIdx);
+	for (int i = 0; i < padCount; i++)
+		memcpy(&out[i * SLIPPI_PAD_FULL_SIZE], queue.At(firstIdx + i).padBuf, SLIPPI_PAD_FULL_SIZE);
 
-	return std::move(padOutput);
+	return firstFrame;
 }
 
 void SlippiNetplayClient::DropOldRemoteInputs(int32_t minFrameRead)
@@ -1091,12 +1382,12 @@ void SlippiNetplayClient::DropOldRemoteInputs(int32_t minFrameRead)
 	//         lowestCommonFrame, playerFrame[0], playerFrame[1], playerFrame[2]);
 	for (int i = 0; i < m_remotePlayerCount; i++)
 	{
-		// INFO_LOG(SLIPPI_ONLINE, "remotePadQueue[%d] size: %d", i, remotePadQueue[i].size());
-		while (remotePadQueue[i].size() > 1 && remotePadQueue[i].back()->frame < minFrameRead)
+		// INFO_LOG(SLIPPI_ONLINE, "remotePadQueue[%d] size: %d", i, remotePadQueue[i].Size());
+		while (remotePadQueue[i].Size() > 1 && remotePadQueue[i].Back().frame < minFrameRead)
 		{
 			// INFO_LOG(SLIPPI_ONLINE, "Popping inputs for frame %d from back of player %d queue",
-			//         remotePadQueue[i].back()->frame, i);
-			remotePadQueue[i].pop_back();
+			//         remotePadQueue[i].Back().frame, i);
+			remotePadQueue[i].PopBack();
 		}
 	}
 }
@@ -1114,12 +1405,12 @@ int32_t SlippiNetplayClient::GetSlippiLatestRemoteFrame()
 	int lowestFrame = 0;
 	for (int i = 0; i < m_remotePlayerCount; i++)
 	{
-		if (remotePadQueue[i].empty())
+		if (remotePadQueue[i].Empty())
 		{
 			return 0;
 		}
 
-		int f = remotePadQueue[i].front()->frame;
+		int f = remotePadQueue[i].Front().frame;
 		if (f < lowestFrame || lowestFrame == 0)
 		{
 			lowestFrame = f;
@@ -1129,6 +1420,11 @@ int32_t SlippiNetplayClient::GetSlippiLatestRemoteFrame()
 	return lowestFrame;
 }
 
+SlippiTimeSync &SlippiNetplayClient::GetTimeSync()
+{
+	return timeSync;
+}
+
 // return the largest time offset among all remote players
 s32 SlippiNetplayClient::CalcTimeOffsetUs()
 {
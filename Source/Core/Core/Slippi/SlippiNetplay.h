@@ -10,10 +10,14 @@
 #include "Common/Timer.h"
 #include "Common/TraversalClient.h"
 #include "Core/NetPlayProto.h"
+#include "Core/Slippi/SlippiInputPredictor.h"
+#include "Core/Slippi/SlippiLinkSimulator.h"
 #include "Core/Slippi/SlippiPad.h"
+#include "Core/Slippi/SlippiTimeSync.h"
 #include "InputCommon/GCPadStatus.h"
 #include <SFML/Network/Packet.hpp>
 #include <array>
+#include <atomic>
 #include <deque>
 #include <map>
 #include <memory>
@@ -31,12 +35,11 @@
 #define SLIPPI_REMOTE_PLAYER_MAX 3
 #define SLIPPI_REMOTE_PLAYER_COUNT 3
 
-struct SlippiRemotePadOutput
-{
-	int32_t latestFrame;
-	u8 playerIdx;
-	std::vector<u8> data;
-};
+// Features advertised to the other players along with the match selections. 0x01 was compact pads without
+// the sender's latest frame, peers that only have that fall back to regular pad packets
+#define SLIPPI_NETPLAY_FLAG_COMPACT_PADS 0x02
+
+static_assert(SLIPPI_TIME_SYNC_MAX_PLAYERS >= SLIPPI_REMOTE_PLAYER_MAX, "Time sync needs a filter per remote player");
 
 class SlippiPlayerSelections
 {
@@ -132,15 +135,20 @@ class SlippiNetplayClient
 	std::vector<int> GetFailedConnections();
 	void StartSlippiGame();
 	void SendConnectionSelected();
-	void SendSlippiPad(std::unique_ptr<SlippiPad> pad);
+	void SendSlippiPad(const SlippiPad *pad);
 	void SetMatchSelections(SlippiPlayerSelections &s);
-	std::unique_ptr<SlippiRemotePadOutput> GetSlippiRemotePad(int32_t curFrame, int index);
+	// Copies up to maxPads pads of a remote player into out, most recent first, starting at curFrame or at the
+	// latest pad received if that's older. Slots without a pad are zeroed. Returns the frame of the first slot
+	int32_t GetSlippiRemotePad(int32_t curFrame, int index, u8 *out, int maxPads);
 	void DropOldRemoteInputs(int32_t minFrameRead);
 	SlippiMatchInfo *GetMatchInfo();
 	int32_t GetSlippiLatestRemoteFrame();
 	SlippiPlayerSelections GetSlippiRemoteChatMessage();
 	u8 GetSlippiRemoteSentChatMessage();
 	s32 CalcTimeOffsetUs();
+	SlippiTimeSync &GetTimeSync();
+	// Misprediction rates of the input predictors against the pads of a remote player this game
+	std::string GetPredictionSummary(int index);
 
 	void WriteChatMessageToPacket(sf::Packet &packet, int messageId, u8 playerIdx);
 	std::unique_ptr<SlippiPlayerSelections> ReadChatMessageFromPacket(sf::Packet &packet);
@@ -159,9 +167,13 @@ class SlippiNetplayClient
 	} m_crit;
 
 	Common::FifoQueue<std::unique_ptr<sf::Packet>, false> m_async_queue;
+	// Set while the network thread spins on the socket instead of waiting for a wakeup
+	std::atomic<bool> m_is_busy_polling{false};
 
 	ENetHost *m_client = nullptr;
 	std::vector<ENetPeer *> m_server;
+	// Only used when SlippiLinkSimulator is set, one relay per remote player
+	std::vector<std::unique_ptr<SlippiLinkSimulator>> m_link_simulators;
 	std::thread m_thread;
 	u8 m_remotePlayerCount = 0;
 
@@ -194,13 +206,15 @@ class SlippiNetplayClient
 
 	std::unordered_map<std::string, std::map<ENetPeer*, bool>> activeConnections;
 
-	std::deque<std::unique_ptr<SlippiPad>> localPadQueue; // most recent inputs at start of deque
-	std::deque<std::unique_ptr<SlippiPad>>
-	    remotePadQueue[SLIPPI_REMOTE_PLAYER_MAX]; // most recent inputs at start of deque
+	SlippiPadRing localPadQueue;                            // most recent inputs at the front
+	SlippiPadRing remotePadQueue[SLIPPI_REMOTE_PLAYER_MAX]; // most recent inputs at the front
 
 	u64 pingUs[SLIPPI_REMOTE_PLAYER_MAX];
 	int32_t lastFrameAcked[SLIPPI_REMOTE_PLAYER_MAX];
+	u8 remoteNetplayFlags[SLIPPI_REMOTE_PLAYER_MAX];
 	FrameOffsetData frameOffsetData[SLIPPI_REMOTE_PLAYER_MAX];
+	SlippiTimeSync timeSync;
+	SlippiPredictionEvaluator predictionEvaluators[SLIPPI_REMOTE_PLAYER_MAX];
 	FrameTiming lastFrameTiming[SLIPPI_REMOTE_PLAYER_MAX];
 	std::array<Common::FifoQueue<FrameTiming, false>, SLIPPI_REMOTE_PLAYER_MAX> ackTimers;
 
@@ -217,7 +231,11 @@ class SlippiNetplayClient
 	u8 PlayerIdxFromPort(u8 port);
 	unsigned int OnData(sf::Packet &packet, ENetPeer *peer);
 	void Send(sf::Packet &packet);
+	bool IsCompactPadsNegotiated();
+	// Sends everything SendAsync queued up right away
+	void FlushAsyncQueue();
 	void Disconnect();
+	void logPredictionStats();
 
 	bool m_is_connected = false;
 
@@ -0,0 +1,130 @@
+#include "SlippiOnlineTrace.h"
+
+#include <algorithm>
+
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+#include "Common/FileUtil.h"
+#include "Common/Logging/Log.h"
+#include "Common/Timer.h"
+
+static json durationSummary(std::vector<u32> &durationsUs)
+{
+	if (durationsUs.empty())
+		return {{"count", 0}};
+
+	std::sort(durationsUs.begin(), durationsUs.end());
+
+	u64 total = 0;
+	for (u32 duration : durationsUs)
+		total += duration;
+
+	auto percentile = [&durationsUs](double p) {
+		return durationsUs[std::min(durationsUs.size() - 1, (size_t)(p / 100.0 * durationsUs.size()))];
+	};
+
+	return {{"count", durationsUs.size()},
+	        {"avgUs", total / durationsUs.size()},
+	        {"p50Us", percentile(50)},
+	        {"p99Us", percentile(99)},
+	        {"maxUs", durationsUs.back()}};
+}
+
+SlippiOnlineTrace::SlippiOnlineTrace(const std::string &outputPath, const std::string &linkConditions)
+    : link(linkConditions)
+{
+	OpenFStream(output, outputPath, std::ios_base::out | std::ios_base::app);
+	if (!output.is_open())
+		ERROR_LOG(SLIPPI_ONLINE, "Failed to open online trace file: %s", outputPath.c_str());
+}
+
+SlippiOnlineTrace::~SlippiOnlineTrace()
+{
+	EndGame();
+}
+
+void SlippiOnlineTrace::StartGame()
+{
+	EndGame();
+
+	isGameActive = true;
+	gameIndex++;
+	gameStartTimeUs = Common::Timer::GetTimeUs();
+	currentFrame = 0;
+
+	rollbackCount = 0;
+	rolledBackFrames = 0;
+	maxRollbackDepth = 0;
+	stallFrames = 0;
+	skipCount = 0;
+	skippedFrames = 0;
+	captureUs.clear();
+	loadUs.clear();
+
+	writeLine(json({{"type", "game_start"}, {"game", gameIndex}, {"link", link}}).dump());
+}
+
+void SlippiOnlineTrace::EndGame()
+{
+	if (!isGameActive)
+		return;
+	isGameActive = false;
+
+	json line = {{"type", "game_end"},
+	             {"game", gameIndex},
+	             {"frames", currentFrame},
+	             {"playMs", (Common::Timer::GetTimeUs() - gameStartTimeUs) / 1000.0},
+	             {"rollbacks", rollbackCount},
+	             {"rolledBackFrames", rolledBackFrames},
+	             {"maxRollbackDepth", maxRollbackDepth},
+	             {"stallFrames", stallFrames},
+	             {"timeSyncSkips", skipCount},
+	             {"timeSyncSkippedFrames", skippedFrames},
+	             {"capture", durationSummary(captureUs)},
+	             {"load", durationSummary(loadUs)}};
+	writeLine(line.dump());
+	output.flush();
+}
+
+void SlippiOnlineTrace::Frame(s32 frame)
+{
+	currentFrame = frame;
+}
+
+void SlippiOnlineTrace::Stall(s32 frame, s32 latestRemoteFrame)
+{
+	stallFrames++;
+	writeLine(json({{"type", "stall"}, {"frame", frame}, {"latestRemoteFrame", latestRemoteFrame}}).dump());
+}
+
+void SlippiOnlineTrace::TimeSyncSkip(s32 frame, s32 offsetUs, int frames)
+{
+	skipCount++;
+	skippedFrames += frames;
+	writeLine(json({{"type", "skip"}, {"frame", frame}, {"offsetUs", offsetUs}, {"frames", frames}}).dump());
+}
+
+void SlippiOnlineTrace::Capture(u32 durationUs)
+{
+	captureUs.push_back(durationUs);
+}
+
+void SlippiOnlineTrace::Load(s32 frame, u32 durationUs)
+{
+	s32 depth = currentFrame - frame;
+	rollbackCount++;
+	rolledBackFrames += std::max(depth, 0);
+	maxRollbackDepth = std::max(maxRollbackDepth, depth);
+	loadUs.push_back(durationUs);
+
+	writeLine(json({{"type", "rollback"}, {"frame", currentFrame}, {"toFrame", frame}, {"depth", depth},
+	                {"loadUs", durationUs}})
+	              .dump());
+}
+
+void SlippiOnlineTrace::writeLine(const std::string &line)
+{
+	if (output.is_open())
+		output << line << '\n';
+}
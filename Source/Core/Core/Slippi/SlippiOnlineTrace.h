@@ -0,0 +1,49 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Writes what the netcode did during online games as one json object per line: every rollback, stall
+// and time sync skip as it happens and a summary with the savestate costs when a game ends. Meant to be
+// compared between runs over a SlippiLinkSimulator link
+class SlippiOnlineTrace
+{
+  public:
+	SlippiOnlineTrace(const std::string &outputPath, const std::string &linkConditions);
+	~SlippiOnlineTrace();
+
+	void StartGame();
+	void EndGame();
+
+	// The frame the game is asking inputs for, rollbacks are measured from it
+	void Frame(s32 frame);
+
+	void Stall(s32 frame, s32 latestRemoteFrame);
+	void TimeSyncSkip(s32 frame, s32 offsetUs, int frames);
+	void Capture(u32 durationUs);
+	// A load is a rollback from the current frame back to frame
+	void Load(s32 frame, u32 durationUs);
+
+  private:
+	void writeLine(const std::string &line);
+
+	std::ofstream output;
+	std::string link;
+
+	bool isGameActive = false;
+	u32 gameIndex = 0;
+	u64 gameStartTimeUs = 0;
+	s32 currentFrame = 0;
+
+	u32 rollbackCount = 0;
+	u64 rolledBackFrames = 0;
+	s32 maxRollbackDepth = 0;
+	u32 stallFrames = 0;
+	u32 skipCount = 0;
+	u32 skippedFrames = 0;
+	std::vector<u32> captureUs;
+	std::vector<u32> loadUs;
+};
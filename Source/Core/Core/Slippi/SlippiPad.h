@@ -5,9 +5,14 @@
 #define SLIPPI_PAD_FULL_SIZE 0xC
 #define SLIPPI_PAD_DATA_SIZE 0x8
 
+// Number of pads a SlippiPadRing holds. Has to be a power of two and comfortably more than the rollback
+// window plus the input delay on both sides plus the frames that are unacked while a packet is in flight
+#define SLIPPI_PAD_RING_SIZE 128
+
 class SlippiPad
 {
 public:
+  SlippiPad() : SlippiPad(0) {}
   SlippiPad(int32_t frame);
   SlippiPad(int32_t frame, u8* padBuf);
   SlippiPad(int32_t frame, u8 playerIdx, u8 *padBuf);
@@ -18,3 +23,46 @@ public:
   u8 padBuf[SLIPPI_PAD_FULL_SIZE];
 };
 
+
+// Fixed capacity queue of pads with the most recent one at the front. Pads are pushed for consecutive
+// frames so a pad can be found from its frame without searching
+class SlippiPadRing
+{
+public:
+  bool Empty() const { return count == 0; }
+  u32 Size() const { return count; }
+
+  const SlippiPad &Front() const { return pads[head]; }
+  const SlippiPad &Back() const { return pads[(head + count - 1) & (SLIPPI_PAD_RING_SIZE - 1)]; }
+
+  // Index 0 is the most recent pad
+  const SlippiPad &At(u32 idx) const { return pads[(head + idx) & (SLIPPI_PAD_RING_SIZE - 1)]; }
+
+  // Index of the pad for frame, or -1 if it isn't in the ring
+  int IndexOf(int32_t frame) const
+  {
+    if (count == 0 || frame > Front().frame || Front().frame - frame >= (int32_t)count)
+      return -1;
+    return Front().frame - frame;
+  }
+
+  // Returns false if the ring was full, the oldest pad is overwritten in that case
+  bool PushFront(const SlippiPad &pad)
+  {
+    head = (head - 1) & (SLIPPI_PAD_RING_SIZE - 1);
+    pads[head] = pad;
+    if (count == SLIPPI_PAD_RING_SIZE)
+      return false;
+
+    count++;
+    return true;
+  }
+
+  void PopBack() { count--; }
+  void Clear() { count = 0; }
+
+private:
+  SlippiPad pads[SLIPPI_PAD_RING_SIZE];
+  u32 head = 0;
+  u32 count = 0;
+};
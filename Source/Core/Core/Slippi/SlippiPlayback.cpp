@@ -13,7 +13,6 @@
 #include "SlippiPlayback.h"
 #include <VideoCommon/OnScreenDisplay.h>
 
-#define FRAME_INTERVAL 900
 #define SLEEP_TIME_MS 8
 
 std::unique_ptr<SlippiPlaybackStatus> g_playbackStatus;
@@ -21,12 +20,8 @@ extern std::unique_ptr<SlippiReplayComm> g_replayComm;
 
 static std::mutex mtx;
 static std::mutex seekMtx;
-static std::mutex diffMtx;
-static std::unique_lock<std::mutex> processingLock(diffMtx);
 static std::condition_variable condVar;
 static std::condition_variable cv_waitingForTargetFrame;
-static std::condition_variable cv_processingDiff;
-static std::atomic<int> numDiffsProcessing(0);
 
 s32 emod(s32 a, s32 b)
 {
@@ -35,21 +30,6 @@ s32 emod(s32 a, s32 b)
 	return r >= 0 ? r : r + std::abs(b);
 }
 
-std::string processDiff(std::vector<u8> iState, std::vector<u8> cState)
-{
-	INFO_LOG(SLIPPI, "Processing diff");
-	numDiffsProcessing += 1;
-	cv_processingDiff.notify_one();
-	std::string diff = std::string();
-	open_vcdiff::VCDiffEncoder encoder((char *)iState.data(), iState.size());
-	encoder.Encode((char *)cState.data(), cState.size(), &diff);
-
-	INFO_LOG(SLIPPI, "done processing");
-	numDiffsProcessing -= 1;
-	cv_processingDiff.notify_one();
-	return diff;
-}
-
 SlippiPlaybackStatus::SlippiPlaybackStatus()
 {
 	shouldJumpBack = false;
@@ -68,6 +48,7 @@ SlippiPlaybackStatus::SlippiPlaybackStatus()
 
 void SlippiPlaybackStatus::startThreads()
 {
+	saveInterval = std::max(SConfig::GetInstance().m_slippiPlaybackSeekInterval, 60);
 	shouldRunThreads = true;
 	m_savestateThread = std::thread(&SlippiPlaybackStatus::SavestateThread, this);
 	m_seekThread = std::thread(&SlippiPlaybackStatus::SeekThread, this);
@@ -75,15 +56,8 @@ void SlippiPlaybackStatus::startThreads()
 
 void SlippiPlaybackStatus::prepareSlippiPlayback(s32 &frameIndex)
 {
-	// block if there's too many diffs being processed
-	while (shouldRunThreads && numDiffsProcessing > 3)
-	{
-		INFO_LOG(SLIPPI, "Processing too many diffs, blocking main process");
-		cv_processingDiff.wait(processingLock);
-	}
-
 	// Unblock thread to save a state every interval
-	if (shouldRunThreads && ((currentPlaybackFrame + 122) % FRAME_INTERVAL == 0))
+	if (shouldRunThreads && ((currentPlaybackFrame - Slippi::PLAYBACK_FIRST_SAVE) % saveInterval == 0))
 		condVar.notify_one();
 
 	if (SConfig::GetInstance().m_slippiEnableFrameIndex)
@@ -127,8 +101,7 @@ void SlippiPlaybackStatus::resetPlayback()
 			m_seekThread.detach();
 
 		condVar.notify_one(); // Will allow thread to kill itself
-		futureDiffs.clear();
-		futureDiffs.rehash(0);
+		seekStore.Clear();
 	}
 
 	shouldJumpBack = false;
@@ -139,12 +112,6 @@ void SlippiPlaybackStatus::resetPlayback()
 	inSlippiPlayback = false;
 }
 
-void SlippiPlaybackStatus::processInitialState(std::vector<u8> &iState)
-{
-	INFO_LOG(SLIPPI, "saving iState");
-	State::SaveToBuffer(iState);
-};
-
 void SlippiPlaybackStatus::SavestateThread()
 {
 	Common::SetCurrentThreadName("Savestate thread");
@@ -156,7 +123,7 @@ void SlippiPlaybackStatus::SavestateThread()
 	{
 		// Wait to hit one of the intervals
 		// Possible while rewinding that we hit this wait again.
-		while (shouldRunThreads && (currentPlaybackFrame - Slippi::PLAYBACK_FIRST_SAVE) % FRAME_INTERVAL != 0)
+		while (shouldRunThreads && (currentPlaybackFrame - Slippi::PLAYBACK_FIRST_SAVE) % saveInterval != 0)
 			condVar.wait(intervalLock);
 
 		if (!shouldRunThreads)
@@ -167,19 +134,22 @@ void SlippiPlaybackStatus::SavestateThread()
 			continue;
 
 		bool isStartFrame = fixedFrameNumber == Slippi::PLAYBACK_FIRST_SAVE;
-		bool hasStateBeenProcessed = futureDiffs.count(fixedFrameNumber) > 0;
+		bool hasStateBeenProcessed = seekStore.HasState(fixedFrameNumber);
 
 		if (!inSlippiPlayback && isStartFrame)
 		{
-			processInitialState(iState);
+			INFO_LOG(SLIPPI, "saving iState");
+			State::SaveToBuffer(cState);
+			seekStore.SetInitialState(std::move(cState));
 			inSlippiPlayback = true;
 		}
 		else if (SConfig::GetInstance().m_InterfaceSeekbar && !hasStateBeenProcessed && !isStartFrame)
 		{
+			// The state is encoded on the seek store's workers, if they fall behind the state is dropped
+			// and seeking falls back to an earlier state instead of stalling emulation
 			INFO_LOG(SLIPPI, "saving diff at frame: %d", fixedFrameNumber);
 			State::SaveToBuffer(cState);
-
-			futureDiffs[fixedFrameNumber] = std::async(processDiff, iState, cState);
+			seekStore.AddState(fixedFrameNumber, std::move(cState));
 		}
 		Common::SleepCurrentThread(SLEEP_TIME_MS);
 	}
@@ -224,7 +194,7 @@ void SlippiPlaybackStatus::SeekThread()
 				targetFrameNum = latestFrame;
 			}
 
-			s32 closestStateFrame = targetFrameNum - emod(targetFrameNum - Slippi::PLAYBACK_FIRST_SAVE, FRAME_INTERVAL);
+			s32 closestStateFrame = targetFrameNum - emod(targetFrameNum - Slippi::PLAYBACK_FIRST_SAVE, saveInterval);
 
 			// Somtimes prepareSlippiPlayback sets currentPlaybackFrame = targetFrameNum so check if target is <=
 			bool isLoadingStateOptimal =
@@ -234,29 +204,29 @@ void SlippiPlaybackStatus::SeekThread()
 			{
 				if (closestStateFrame <= Slippi::PLAYBACK_FIRST_SAVE)
 				{
-					State::LoadFromBuffer(iState);
+					loadState(Slippi::PLAYBACK_FIRST_SAVE);
 				}
 				else
 				{
 					// If this diff has been processed, load it
-					if (futureDiffs.count(closestStateFrame) > 0)
+					if (seekStore.HasState(closestStateFrame))
 					{
 						loadState(closestStateFrame);
 					}
 					else if (targetFrameNum < currentPlaybackFrame)
 					{
-						s32 closestActualStateFrame = closestStateFrame - FRAME_INTERVAL;
+						s32 closestActualStateFrame = closestStateFrame - saveInterval;
 						while (closestActualStateFrame > Slippi::PLAYBACK_FIRST_SAVE &&
-						       futureDiffs.count(closestActualStateFrame) == 0)
-							closestActualStateFrame -= FRAME_INTERVAL;
+						       !seekStore.HasState(closestActualStateFrame))
+							closestActualStateFrame -= saveInterval;
 						loadState(closestActualStateFrame);
 					}
 					else if (targetFrameNum > currentPlaybackFrame)
 					{
-						s32 closestActualStateFrame = closestStateFrame - FRAME_INTERVAL;
+						s32 closestActualStateFrame = closestStateFrame - saveInterval;
 						while (closestActualStateFrame > currentPlaybackFrame &&
-						       futureDiffs.count(closestActualStateFrame) == 0)
-							closestActualStateFrame -= FRAME_INTERVAL;
+						       !seekStore.HasState(closestActualStateFrame))
+							closestActualStateFrame -= saveInterval;
 
 						// only load a savestate if we find one past our current frame since we are seeking forwards
 						if (closestActualStateFrame > currentPlaybackFrame)
@@ -309,15 +279,11 @@ void SlippiPlaybackStatus::setHardFFW(bool enable)
 
 void SlippiPlaybackStatus::loadState(s32 closestStateFrame)
 {
-	if (closestStateFrame == Slippi::PLAYBACK_FIRST_SAVE)
-		State::LoadFromBuffer(iState);
-	else
-	{
-		std::string stateString;
-		decoder.Decode((char *)iState.data(), iState.size(), futureDiffs[closestStateFrame].get(), &stateString);
-		std::vector<u8> stateToLoad(stateString.begin(), stateString.end());
+	std::vector<u8> stateToLoad;
+	bool hasState = closestStateFrame <= Slippi::PLAYBACK_FIRST_SAVE ? seekStore.GetInitialState(stateToLoad)
+	                                                                  : seekStore.GetState(closestStateFrame, stateToLoad);
+	if (hasState)
 		State::LoadFromBuffer(stateToLoad);
-	}
 }
 
 bool SlippiPlaybackStatus::shouldFFWFrame(int32_t frameIndex) const
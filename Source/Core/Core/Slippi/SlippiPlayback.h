@@ -2,13 +2,11 @@
 
 #include <SlippiLib/SlippiGame.h>
 #include <climits>
-#include <future>
-#include <open-vcdiff/src/google/vcdecoder.h>
-#include <open-vcdiff/src/google/vcencoder.h>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 
 #include "../../Common/CommonTypes.h"
+#include "SlippiSeekStore.h"
 
 class SlippiPlaybackStatus
 {
@@ -26,6 +24,7 @@ class SlippiPlaybackStatus
 	s32 currentPlaybackFrame = INT_MIN;
 	s32 targetFrameNum = INT_MAX;
 	s32 latestFrame = Slippi::GAME_FIRST_FRAME;
+	s32 saveInterval = 900;
 
 	bool prevOCEnable;
 	float prevOCFactor;
@@ -43,14 +42,8 @@ class SlippiPlaybackStatus
 	void SavestateThread(void);
 	void SeekThread(void);
 	void loadState(s32 closestStateFrame);
-	void processInitialState(std::vector<u8> &iState);
 	void updateWatchSettingsStartEnd();
 
-	std::unordered_map<int32_t, std::shared_future<std::string>>
-	    futureDiffs;        // State diffs keyed by frameIndex, processed async
-	std::vector<u8> iState; // The initial state
+	SlippiSeekStore seekStore;
 	std::vector<u8> cState; // The current (latest) state
-
-	open_vcdiff::VCDiffDecoder decoder;
-	open_vcdiff::VCDiffEncoder *encoder = NULL;
 };
@@ -0,0 +1,94 @@
+#include "SlippiReplayCompressor.h"
+
+#include <SlippiGame.h>
+#include <cstring>
+#include <zlib.h>
+
+#include "Common/Logging/Log.h"
+
+SlippiReplayCompressor::SlippiReplayCompressor()
+{
+	block.reserve(Slippi::COMPRESSED_BLOCK_SIZE * 2);
+	compressed.reserve(compressBound(Slippi::COMPRESSED_BLOCK_SIZE * 2));
+}
+
+void SlippiReplayCompressor::Start(std::vector<u8> &out)
+{
+	block.clear();
+	index.clear();
+	fileOffset = 0;
+	blockFirstFrame = NO_FRAME;
+	lastFrame = Slippi::GAME_FIRST_FRAME;
+
+	u8 header[Slippi::COMPRESSED_HEADER_SIZE] = {};
+	memcpy(header, Slippi::COMPRESSED_MAGIC, 4);
+	header[4] = Slippi::COMPRESSED_VERSION;
+	write(out, header, sizeof(header));
+}
+
+void SlippiReplayCompressor::Append(const u8 *data, u32 length, s32 frame, std::vector<u8> &out)
+{
+	if (frame != NO_FRAME)
+	{
+		if (blockFirstFrame == NO_FRAME)
+			blockFirstFrame = frame;
+		lastFrame = frame;
+	}
+
+	block.insert(block.end(), data, data + length);
+	if (block.size() >= Slippi::COMPRESSED_BLOCK_SIZE)
+		compressBlock(out);
+}
+
+void SlippiReplayCompressor::Finish(u32 rawLength, std::vector<u8> &out)
+{
+	compressBlock(out);
+
+	u64 indexOffset = fileOffset;
+	u32 indexHeader[3] = {Slippi::COMPRESSED_INDEX_MARKER, rawLength, (u32)index.size()};
+	write(out, indexHeader, sizeof(indexHeader));
+
+	for (auto &entry : index)
+	{
+		write(out, &entry.fileOffset, 8);
+		write(out, &entry.firstFrame, 4);
+	}
+
+	write(out, &indexOffset, 8);
+	write(out, Slippi::COMPRESSED_INDEX_MAGIC, 4);
+}
+
+void SlippiReplayCompressor::compressBlock(std::vector<u8> &out)
+{
+	if (block.empty())
+		return;
+
+	uLongf compressedSize = compressBound((uLong)block.size());
+	compressed.resize(compressedSize);
+	int result = compress2(&compressed[0], &compressedSize, &block[0], (uLong)block.size(), Z_DEFAULT_COMPRESSION);
+	if (result != Z_OK)
+	{
+		ERROR_LOG(SLIPPI, "Failed to compress replay block: %d", result);
+		block.clear();
+		return;
+	}
+
+	// A block without any frame events still sits after the last frame that was seen
+	s32 firstFrame = blockFirstFrame == NO_FRAME ? lastFrame : blockFirstFrame;
+	index.push_back({fileOffset, firstFrame});
+
+	u32 blockHeader[3] = {(u32)compressedSize, (u32)block.size(), (u32)firstFrame};
+	write(out, blockHeader, sizeof(blockHeader));
+	write(out, &compressed[0], compressedSize);
+
+	block.clear();
+	blockFirstFrame = NO_FRAME;
+}
+
+// The container is little endian, same as every platform we build for
+void SlippiReplayCompressor::write(std::vector<u8> &out, const void *data, size_t length)
+{
+	const u8 *bytes = static_cast<const u8 *>(data);
+	out.insert(out.end(), bytes, bytes + length);
+	fileOffset += length;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Writes the compressed replay container described in SlippiGame.h. Replay bytes are gathered
+// until a block is full and then compressed with zlib, blocks always end on an event boundary
+// so any of them can be decompressed and parsed on its own
+class SlippiReplayCompressor
+{
+  public:
+	SlippiReplayCompressor();
+
+	// Starts a new file, its header is added to out
+	void Start(std::vector<u8> &out);
+
+	// Adds the bytes of one event. frame is the frame the event belongs to, or NO_FRAME
+	void Append(const u8 *data, u32 length, s32 frame, std::vector<u8> &out);
+
+	// Compresses the last block and adds the block index
+	void Finish(u32 rawLength, std::vector<u8> &out);
+
+	static const s32 NO_FRAME = INT32_MIN;
+
+  private:
+	typedef struct
+	{
+		u64 fileOffset;
+		s32 firstFrame;
+	} BlockEntry;
+
+	void compressBlock(std::vector<u8> &out);
+	void write(std::vector<u8> &out, const void *data, size_t length);
+
+	std::vector<u8> block;
+	std::vector<u8> compressed;
+	std::vector<BlockEntry> index;
+
+	u64 fileOffset = 0;
+	s32 blockFirstFrame;
+	s32 lastFrame;
+};
@@ -1,5 +1,6 @@
 #include "SlippiSavestate.h"
 #include "Common/CommonFuncs.h"
+#include "Common/Intrinsics.h"
 #include "Common/MemoryUtil.h"
 #include "Core/HW/AudioInterface.h"
 #include "Core/HW/DSP.h"
@@ -12,18 +13,34 @@
 #include "Core/HW/SI.h"
 #include "Core/HW/VideoInterface.h"
 #include "Core/PowerPC/PowerPC.h"
+#include <algorithm>
 #include <vector>
+#include <xxhash.h>
 
 bool SlippiSavestate::shouldForceInit;
 
-SlippiSavestate::SlippiSavestate()
+// Size of the pages snapshots are split into. Unchanged pages are shared between snapshots
+static const u32 SS_PAGE_SIZE = 0x1000;
+static const u32 SS_CHUNKS_PER_SLAB = 256;
+static const u32 SS_NO_CHUNK = 0xFFFFFFFF;
+
+SlippiSavestate::SlippiSavestate(size_t capacity)
 {
 	initBackupLocs();
 
 	for (auto it = backupLocs.begin(); it != backupLocs.end(); ++it)
 	{
-		auto size = it->endAddress - it->startAddress;
-		it->data = static_cast<u8 *>(Common::AllocateAlignedMemory(size, 64));
+		for (u32 address = it->startAddress; address < it->endAddress; address += SS_PAGE_SIZE)
+			pages.push_back({address, std::min(SS_PAGE_SIZE, it->endAddress - address)});
+	}
+
+	snapshots.resize(capacity);
+	for (auto it = snapshots.begin(); it != snapshots.end(); ++it)
+	{
+		it->frame = 0;
+		it->isActive = false;
+		it->chunks.resize(pages.size(), SS_NO_CHUNK);
+		it->hashes.resize(pages.size(), 0);
 	}
 
 	// u8 *ptr = nullptr;
@@ -36,10 +53,41 @@ SlippiSavestate::SlippiSavestate()
 
 SlippiSavestate::~SlippiSavestate()
 {
-	for (auto it = backupLocs.begin(); it != backupLocs.end(); ++it)
+	for (auto it = chunkSlabs.begin(); it != chunkSlabs.end(); ++it)
+	{
+		Common::FreeAlignedMemory(*it);
+	}
+}
+
+u32 SlippiSavestate::allocChunk()
+{
+	if (freeChunks.empty())
 	{
-		Common::FreeAlignedMemory(it->data);
+		// Grow the arena by a whole slab, this only happens until the arena fits the rollback window
+		u32 firstId = (u32)chunkRefs.size();
+		chunkSlabs.push_back(static_cast<u8 *>(Common::AllocateAlignedMemory(SS_CHUNKS_PER_SLAB * SS_PAGE_SIZE, 64)));
+		chunkRefs.resize(chunkRefs.size() + SS_CHUNKS_PER_SLAB, 0);
+
+		for (u32 i = SS_CHUNKS_PER_SLAB; i > 0; i--)
+			freeChunks.push_back(firstId + i - 1);
 	}
+
+	u32 id = freeChunks.back();
+	freeChunks.pop_back();
+	chunkRefs[id] = 1;
+	return id;
+}
+
+void SlippiSavestate::releaseChunk(u32 id)
+{
+	chunkRefs[id]--;
+	if (chunkRefs[id] == 0)
+		freeChunks.push_back(id);
+}
+
+u8 *SlippiSavestate::getChunk(u32 id) const
+{
+	return chunkSlabs[id / SS_CHUNKS_PER_SLAB] + (id % SS_CHUNKS_PER_SLAB) * SS_PAGE_SIZE;
 }
 
 bool cmpFn(SlippiSavestate::PreserveBlock pb1, SlippiSavestate::PreserveBlock pb2)
@@ -50,13 +98,13 @@ bool cmpFn(SlippiSavestate::PreserveBlock pb1, SlippiSavestate::PreserveBlock pb
 void SlippiSavestate::initBackupLocs()
 {
 	static std::vector<ssBackupLoc> fullBackupRegions = {
-	    {0x80005520, 0x80005940, nullptr}, // Data Sections 0 and 1
-	    {0x803b7240, 0x804DEC00, nullptr}, // Data Sections 2-7 and in between sections including BSS
+	    {0x80005520, 0x80005940}, // Data Sections 0 and 1
+	    {0x803b7240, 0x804DEC00}, // Data Sections 2-7 and in between sections including BSS
 
 	    // Full Unknown Region: [804fec00 - 80BD5C40)
 	    // https://docs.google.com/spreadsheets/d/16ccNK_qGrtPfx4U25w7OWIDMZ-NxN1WNBmyQhaDxnEg/edit?usp=sharing
-	    {0x8065c000, 0x8071b000, nullptr}, // Unknown Region Pt1. Maybe get the low bound pointer at 804d5c10 and the size of the audio heap at 804d5e18
-	    {0x80bd5c40, 0x811AD5A0, nullptr}, // Unknown Region Pt2, Heap [80bd5c40 - 811AD5A0). Gets overwritten on init
+	    {0x8065c000, 0x8071b000}, // Unknown Region Pt1. Maybe get the low bound pointer at 804d5c10 and the size of the audio heap at 804d5e18
+	    {0x80bd5c40, 0x811AD5A0}, // Unknown Region Pt2, Heap [80bd5c40 - 811AD5A0). Gets overwritten on init
 	};
 
 	static std::vector<PreserveBlock> excludeSections = {
@@ -157,7 +205,7 @@ void SlippiSavestate::initBackupLocs()
 			// Add split section after exclusion
 			if (backupLocs[idx].endAddress > ipb.address + ipb.length)
 			{
-				ssBackupLoc newLoc = {ipb.address + ipb.length, backupLocs[idx].endAddress, nullptr};
+				ssBackupLoc newLoc = {ipb.address + ipb.length, backupLocs[idx].endAddress};
 				backupLocs.insert(backupLocs.begin() + idx + 1, newLoc);
 			}
 
@@ -201,23 +249,119 @@ void SlippiSavestate::getDolphinState(PointerWrap &p)
 	// p.DoMarker("AudioInterface");
 }
 
-void SlippiSavestate::Capture()
+// Copies src to dst in 64 byte lines, skipping the lines dst already matches
+static void restoreChangedLines(u8 *dst, const u8 *src, u32 length)
 {
-	// First copy memory
-	for (auto it = backupLocs.begin(); it != backupLocs.end(); ++it)
+	u32 offset = 0;
+	for (; offset + 64 <= length; offset += 64)
+	{
+#ifdef _M_X86
+		const __m128i *s = reinterpret_cast<const __m128i *>(src + offset);
+		const __m128i *d = reinterpret_cast<const __m128i *>(dst + offset);
+		__m128i eq0 = _mm_cmpeq_epi8(_mm_load_si128(s), _mm_loadu_si128(d));
+		__m128i eq1 = _mm_cmpeq_epi8(_mm_load_si128(s + 1), _mm_loadu_si128(d + 1));
+		__m128i eq2 = _mm_cmpeq_epi8(_mm_load_si128(s + 2), _mm_loadu_si128(d + 2));
+		__m128i eq3 = _mm_cmpeq_epi8(_mm_load_si128(s + 3), _mm_loadu_si128(d + 3));
+		__m128i eq = _mm_and_si128(_mm_and_si128(eq0, eq1), _mm_and_si128(eq2, eq3));
+		if (_mm_movemask_epi8(eq) == 0xFFFF)
+			continue;
+#else
+		if (memcmp(dst + offset, src + offset, 64) == 0)
+			continue;
+#endif
+
+		memcpy(dst + offset, src + offset, 64);
+	}
+
+	if (offset < length)
+		memcpy(dst + offset, src + offset, length - offset);
+}
+
+bool SlippiSavestate::HasFrame(s32 frame) const
+{
+	for (auto it = snapshots.begin(); it != snapshots.end(); ++it)
+	{
+		if (it->isActive && it->frame == frame)
+			return true;
+	}
+
+	return false;
+}
+
+void SlippiSavestate::Capture(s32 frame)
+{
+	// Pick the snapshot to overwrite. Prefer one already holding this frame, then an unused one and
+	// finally the oldest frame
+	int idx = -1;
+	for (int i = 0; i < (int)snapshots.size(); i++)
+	{
+		auto &ss = snapshots[i];
+		if (ss.isActive && ss.frame == frame)
+		{
+			idx = i;
+			break;
+		}
+
+		if (idx == -1 || (snapshots[idx].isActive && (!ss.isActive || ss.frame < snapshots[idx].frame)))
+			idx = i;
+	}
+
+	auto &ss = snapshots[idx];
+	const ssSnapshot *base = baseIdx >= 0 ? &snapshots[baseIdx] : nullptr;
+
+	// First copy memory. Pages that did not change since the last capture or load are shared with
+	// that snapshot instead of being copied again
+	for (size_t i = 0; i < pages.size(); i++)
 	{
-		auto size = it->endAddress - it->startAddress;
-		Memory::CopyFromEmu(it->data, it->startAddress, size);
+		const u8 *src = Memory::GetPointer(pages[i].address);
+		u64 hash = XXH64(src, pages[i].length, 0);
+
+		u32 chunk;
+		// The hash only rules pages out cheaply, a collision must not share a page that changed
+		if (base && base->chunks[i] != SS_NO_CHUNK && base->hashes[i] == hash &&
+		    !memcmp(getChunk(base->chunks[i]), src, pages[i].length))
+		{
+			chunk = base->chunks[i];
+			chunkRefs[chunk]++;
+		}
+		else
+		{
+			chunk = allocChunk();
+			memcpy(getChunk(chunk), src, pages[i].length);
+		}
+
+		if (ss.chunks[i] != SS_NO_CHUNK)
+			releaseChunk(ss.chunks[i]);
+
+		ss.chunks[i] = chunk;
+		ss.hashes[i] = hash;
 	}
 
+	ss.frame = frame;
+	ss.isActive = true;
+	baseIdx = idx;
+
 	//// Second copy dolphin states
 	// u8 *ptr = &dolphinSsBackup[0];
 	// PointerWrap p(&ptr, PointerWrap::MODE_WRITE);
 	// getDolphinState(p);
 }
 
-void SlippiSavestate::Load(std::vector<PreserveBlock> blocks)
+bool SlippiSavestate::Load(s32 frame, const std::vector<PreserveBlock> &blocks)
 {
+	int idx = -1;
+	for (int i = 0; i < (int)snapshots.size(); i++)
+	{
+		if (snapshots[i].isActive && snapshots[i].frame == frame)
+		{
+			idx = i;
+			break;
+		}
+	}
+
+	if (idx == -1)
+		return false;
+
 	// static std::vector<PreserveBlock> interruptStuff = {
 	//    {0x804BF9D2, 4},
 	//    {0x804C3DE4, 20},
@@ -231,22 +375,28 @@ void SlippiSavestate::Load(std::vector<PreserveBlock> blocks)
 	// }
 
 	// Back up
+	size_t preservationSize = 0;
 	for (auto it = blocks.begin(); it != blocks.end(); ++it)
 	{
-		if (!preservationMap.count(*it))
-		{
-			// TODO: Clear preservation map when game ends
-			preservationMap[*it] = std::vector<u8>(it->length);
-		}
+		preservationSize += it->length;
+	}
+
+	if (preservationData.size() < preservationSize)
+		preservationData.resize(preservationSize);
 
-		Memory::CopyFromEmu(&preservationMap[*it][0], it->address, it->length);
+	size_t offset = 0;
+	for (auto it = blocks.begin(); it != blocks.end(); ++it)
+	{
+		Memory::CopyFromEmu(&preservationData[offset], it->address, it->length);
+		offset += it->length;
 	}
 
-	// Restore memory blocks
-	for (auto it = backupLocs.begin(); it != backupLocs.end(); ++it)
+	// Restore memory blocks. Only a small part of the heap changes between the loaded frame and now,
+	// so only write back the cache lines that actually differ
+	auto &ss = snapshots[idx];
+	for (size_t i = 0; i < pages.size(); i++)
 	{
-		auto size = it->endAddress - it->startAddress;
-		Memory::CopyToEmu(it->startAddress, it->data, size);
+		restoreChangedLines(Memory::GetPointer(pages[i].address), getChunk(ss.chunks[i]), pages[i].length);
 	}
 
 	//// Restore audio
@@ -255,8 +405,21 @@ void SlippiSavestate::Load(std::vector<PreserveBlock> blocks)
 	// getDolphinState(p);
 
 	// Restore
+	offset = 0;
 	for (auto it = blocks.begin(); it != blocks.end(); ++it)
 	{
-		Memory::CopyToEmu(it->address, &preservationMap[*it][0], it->length);
+		Memory::CopyToEmu(it->address, &preservationData[offset], it->length);
+		offset += it->length;
+	}
+
+	// Every frame after the loaded one is about to be simulated again, so none of the snapshots can be
+	// loaded anymore. Their pages are kept so the next captures can share them
+	for (auto it = snapshots.begin(); it != snapshots.end(); ++it)
+	{
+		it->isActive = false;
 	}
+
+	baseIdx = idx;
+
+	return true;
 }
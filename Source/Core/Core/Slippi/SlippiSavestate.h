@@ -2,10 +2,13 @@
 
 #include "Common/ChunkFile.h"
 #include "Common/CommonTypes.h"
-#include <unordered_map>
+#include <vector>
 
 class PointerWrap;
 
+// Holds the rollback savestates for the most recent frames. Every savestate is split into pages that
+// live in a shared arena of reference counted chunks, so a capture only has to copy the pages that
+// changed since the previous capture and shares the rest with it
 class SlippiSavestate
 {
   public:
@@ -17,11 +20,12 @@ class SlippiSavestate
 		bool operator==(const PreserveBlock &p) const { return address == p.address && length == p.length; }
 	};
 
-	SlippiSavestate();
+	SlippiSavestate(size_t capacity);
 	~SlippiSavestate();
 
-	void Capture();
-	void Load(std::vector<PreserveBlock> blocks);
+	void Capture(s32 frame);
+	bool Load(s32 frame, const std::vector<PreserveBlock> &blocks);
+	bool HasFrame(s32 frame) const;
 
 	static bool shouldForceInit;
 
@@ -30,7 +34,6 @@ class SlippiSavestate
 	{
 		u32 startAddress;
 		u32 endAddress;
-		u8 *data;
 	} ssBackupLoc;
 
 	// These are the game locations to back up and restore
@@ -41,18 +44,42 @@ class SlippiSavestate
 	typedef struct
 	{
 		u32 address;
-		u32 value;
-	} ssBackupStaticToHeapPtr;
+		u32 length;
+	} ssPage;
+
+	// backupLocs split into pages, each page of a snapshot is stored in one chunk
+	std::vector<ssPage> pages;
 
-	struct preserve_hash_fn
+	typedef struct
 	{
-		std::size_t operator()(const PreserveBlock &node) const
-		{
-			return node.address ^ node.length; // TODO: This is probably a bad hash
-		}
-	};
+		s32 frame;
+		bool isActive;
+		std::vector<u32> chunks;
+		std::vector<u64> hashes;
+	} ssSnapshot;
+
+	// Fixed ring of snapshots, a snapshot is only valid to load while it is active
+	std::vector<ssSnapshot> snapshots;
+
+	// Snapshot that matches the most recent capture or load, new captures share unchanged pages with it
+	int baseIdx = -1;
+
+	std::vector<u8 *> chunkSlabs;
+	std::vector<u32> chunkRefs;
+	std::vector<u32> freeChunks;
+
+	u32 allocChunk();
+	void releaseChunk(u32 id);
+	u8 *getChunk(u32 id) const;
+
+	typedef struct
+	{
+		u32 address;
+		u32 value;
+	} ssBackupStaticToHeapPtr;
 
-	std::unordered_map<PreserveBlock, std::vector<u8>, preserve_hash_fn> preservationMap;
+	// Scratch space holding the preserve blocks back to back while a savestate is loaded
+	std::vector<u8> preservationData;
 
 	std::vector<u8> dolphinSsBackup;
 
@@ -0,0 +1,291 @@
+#include "SlippiSeekStore.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Common/Logging/Log.h"
+#include "Common/Thread.h"
+
+static void appendU32(std::vector<u8> &buf, u32 value)
+{
+	u8 bytes[4];
+	memcpy(bytes, &value, 4);
+	buf.insert(buf.end(), bytes, bytes + 4);
+}
+
+static u32 readU32(const std::vector<u8> &buf, size_t pos)
+{
+	u32 value;
+	memcpy(&value, &buf[pos], 4);
+	return value;
+}
+
+// Reads the word at index idx, treating everything past the end of the buffer as zero
+static inline u64 readWord(const std::vector<u8> &buf, size_t idx)
+{
+	u64 word = 0;
+	size_t pos = idx * 8;
+	if (pos < buf.size())
+		memcpy(&word, &buf[pos], std::min<size_t>(8, buf.size() - pos));
+	return word;
+}
+
+SlippiSeekStore::SlippiSeekStore()
+{
+	threadCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+	maxPendingJobs = threadCount * 2;
+}
+
+SlippiSeekStore::~SlippiSeekStore()
+{
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		shouldRunWorkers = false;
+		jobs.clear();
+	}
+	cvJob.notify_all();
+	cvReady.notify_all();
+
+	for (auto &worker : workers)
+		worker.join();
+}
+
+void SlippiSeekStore::SetInitialState(std::vector<u8> &&state)
+{
+	std::lock_guard<std::mutex> lk(mtx);
+	initialState = std::make_shared<const std::vector<u8>>(std::move(state));
+
+	// Nothing can be encoded before there is an initial state, so the workers only start with the first
+	// replay that gets seeked in
+	if (workers.empty())
+	{
+		for (unsigned int i = 0; i < threadCount; i++)
+			workers.emplace_back(&SlippiSeekStore::WorkerThread, this);
+	}
+}
+
+bool SlippiSeekStore::GetInitialState(std::vector<u8> &state)
+{
+	std::lock_guard<std::mutex> lk(mtx);
+	if (!initialState)
+		return false;
+
+	state = *initialState;
+	return true;
+}
+
+bool SlippiSeekStore::AddState(s32 frame, std::vector<u8> &&state)
+{
+	std::unique_lock<std::mutex> lk(mtx);
+
+	if (!initialState || entries.count(frame))
+		return false;
+
+	// Wait for the workers to catch up instead of dropping the state, a missing state would make seeking
+	// to it replay from the keyframe before
+	u64 startGeneration = generation;
+	cvReady.wait(lk, [&] {
+		return !shouldRunWorkers || generation != startGeneration || jobs.size() < maxPendingJobs;
+	});
+	if (!shouldRunWorkers || generation != startGeneration || entries.count(frame))
+		return false;
+
+	ssJob job;
+	job.generation = generation;
+	job.frame = frame;
+	job.state = std::make_shared<const std::vector<u8>>(std::move(state));
+
+	ssEntry entry;
+	entry.isReady = false;
+
+	if (!lastKeyframe || ++statesSinceKeyframe >= KEYFRAME_INTERVAL)
+	{
+		job.base = initialState;
+		entry.baseFrame = INITIAL_STATE_FRAME;
+
+		lastKeyframe = job.state;
+		lastKeyframeFrame = frame;
+		statesSinceKeyframe = 0;
+	}
+	else
+	{
+		job.base = lastKeyframe;
+		entry.baseFrame = lastKeyframeFrame;
+	}
+
+	entries[frame] = std::move(entry);
+	jobs.push_back(std::move(job));
+
+	lk.unlock();
+	cvJob.notify_one();
+	return true;
+}
+
+bool SlippiSeekStore::HasState(s32 frame)
+{
+	std::lock_guard<std::mutex> lk(mtx);
+	return entries.count(frame) > 0;
+}
+
+bool SlippiSeekStore::GetState(s32 frame, std::vector<u8> &state)
+{
+	std::unique_lock<std::mutex> lk(mtx);
+
+	if (!initialState)
+		return false;
+
+	u64 startGeneration = generation;
+	auto isReady = [&](s32 f) {
+		auto it = entries.find(f);
+		return it == entries.end() || it->second.isReady;
+	};
+
+	// Wait for the state and the keyframe it is based on to finish encoding
+	cvReady.wait(lk, [&] {
+		if (!shouldRunWorkers || generation != startGeneration)
+			return true;
+
+		auto it = entries.find(frame);
+		if (it == entries.end())
+			return true;
+
+		return it->second.isReady && (it->second.baseFrame == INITIAL_STATE_FRAME || isReady(it->second.baseFrame));
+	});
+
+	auto it = entries.find(frame);
+	if (generation != startGeneration || it == entries.end())
+		return false;
+
+	if (it->second.baseFrame == INITIAL_STATE_FRAME)
+	{
+		ApplyDelta(*initialState, it->second.delta, state);
+		return true;
+	}
+
+	auto baseIt = entries.find(it->second.baseFrame);
+	if (baseIt == entries.end())
+		return false;
+
+	std::vector<u8> keyframe;
+	ApplyDelta(*initialState, baseIt->second.delta, keyframe);
+	ApplyDelta(keyframe, it->second.delta, state);
+	return true;
+}
+
+void SlippiSeekStore::Clear()
+{
+	std::lock_guard<std::mutex> lk(mtx);
+
+	generation++;
+	jobs.clear();
+	entries.clear();
+	initialState.reset();
+	lastKeyframe.reset();
+	lastKeyframeFrame = INITIAL_STATE_FRAME;
+	statesSinceKeyframe = 0;
+
+	cvReady.notify_all();
+}
+
+void SlippiSeekStore::WorkerThread()
+{
+	Common::SetCurrentThreadName("Seek store worker");
+
+	std::unique_lock<std::mutex> lk(mtx);
+	while (true)
+	{
+		cvJob.wait(lk, [this] { return !shouldRunWorkers || !jobs.empty(); });
+		if (!shouldRunWorkers)
+			break;
+
+		ssJob job = std::move(jobs.front());
+		jobs.pop_front();
+
+		lk.unlock();
+		// AddState may be waiting for a free job slot
+		cvReady.notify_all();
+		std::vector<u8> delta;
+		EncodeDelta(*job.base, *job.state, delta);
+		job.base.reset();
+		job.state.reset();
+		lk.lock();
+
+		auto it = entries.find(job.frame);
+		if (job.generation != generation || it == entries.end())
+			continue;
+
+		INFO_LOG(SLIPPI, "Encoded seek state for frame %d: %zu bytes", job.frame, delta.size());
+		it->second.delta = std::move(delta);
+		it->second.isReady = true;
+		cvReady.notify_all();
+	}
+}
+
+// Delta layout: the u64 size of the target followed by runs of [u32 unchanged word count]
+// [u32 changed word count][changed words XOR base]. Past the end of base, base reads as zero
+void SlippiSeekStore::EncodeDelta(const std::vector<u8> &base, const std::vector<u8> &target, std::vector<u8> &delta)
+{
+	delta.clear();
+
+	u64 targetSize = target.size();
+	delta.insert(delta.end(), reinterpret_cast<u8 *>(&targetSize), reinterpret_cast<u8 *>(&targetSize) + 8);
+
+	size_t wordCount = (target.size() + 7) / 8;
+	auto xorWord = [&](size_t idx) { return readWord(base, idx) ^ readWord(target, idx); };
+
+	size_t idx = 0;
+	while (idx < wordCount)
+	{
+		size_t skipStart = idx;
+		while (idx < wordCount && xorWord(idx) == 0)
+			idx++;
+
+		// A changed run ends at the first two unchanged words in a row, single unchanged words are
+		// cheaper to store than to start a new run for
+		size_t runStart = idx;
+		while (idx < wordCount && (xorWord(idx) != 0 || (idx + 1 < wordCount && xorWord(idx + 1) != 0)))
+			idx++;
+
+		appendU32(delta, (u32)(runStart - skipStart));
+		appendU32(delta, (u32)(idx - runStart));
+
+		size_t pos = delta.size();
+		delta.resize(pos + (idx - runStart) * 8);
+		for (size_t i = runStart; i < idx; i++, pos += 8)
+		{
+			u64 word = xorWord(i);
+			memcpy(&delta[pos], &word, 8);
+		}
+	}
+}
+
+void SlippiSeekStore::ApplyDelta(const std::vector<u8> &base, const std::vector<u8> &delta, std::vector<u8> &target)
+{
+	u64 targetSize;
+	memcpy(&targetSize, &delta[0], 8);
+
+	target.assign(base.begin(), base.begin() + std::min<size_t>(base.size(), (size_t)targetSize));
+	target.resize((size_t)targetSize, 0);
+
+	size_t idx = 0;
+	size_t pos = 8;
+	while (pos < delta.size())
+	{
+		idx += readU32(delta, pos);
+		u32 count = readU32(delta, pos + 4);
+		pos += 8;
+
+		for (u32 i = 0; i < count; i++, idx++, pos += 8)
+		{
+			size_t offset = idx * 8;
+			size_t len = std::min<size_t>(8, target.size() - offset);
+
+			u64 word = 0;
+			memcpy(&word, &target[offset], len);
+			u64 change;
+			memcpy(&change, &delta[pos], 8);
+			word ^= change;
+			memcpy(&target[offset], &word, len);
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Holds the savestates used to seek through a replay. The initial state is kept as-is and every
+// KEYFRAME_INTERVAL-th state becomes a keyframe. Keyframes are stored as a delta against the initial
+// state and every other state as a delta against the keyframe before it. Deltas XOR the state with its
+// base 8 bytes at a time and skip runs of unchanged words, they are encoded by a small pool of workers
+// started along with the first initial state
+class SlippiSeekStore
+{
+  public:
+	SlippiSeekStore();
+	~SlippiSeekStore();
+
+	void SetInitialState(std::vector<u8> &&state);
+	bool GetInitialState(std::vector<u8> &state);
+
+	// Queues a state to be encoded, blocking while the workers are too far behind. Returns false if the
+	// store was cleared in the meantime
+	bool AddState(s32 frame, std::vector<u8> &&state);
+	bool HasState(s32 frame);
+
+	// Blocks until the state for frame has been encoded, then decodes it into state
+	bool GetState(s32 frame, std::vector<u8> &state);
+
+	void Clear();
+
+	static void EncodeDelta(const std::vector<u8> &base, const std::vector<u8> &target, std::vector<u8> &delta);
+	static void ApplyDelta(const std::vector<u8> &base, const std::vector<u8> &delta, std::vector<u8> &target);
+
+  private:
+	static const int KEYFRAME_INTERVAL = 4;
+	static const s32 INITIAL_STATE_FRAME = INT32_MIN;
+
+	typedef struct
+	{
+		s32 baseFrame;
+		bool isReady;
+		std::vector<u8> delta;
+	} ssEntry;
+
+	typedef struct
+	{
+		u64 generation;
+		s32 frame;
+		std::shared_ptr<const std::vector<u8>> base;
+		std::shared_ptr<const std::vector<u8>> state;
+	} ssJob;
+
+	void WorkerThread();
+
+	std::mutex mtx;
+	std::condition_variable cvJob;
+	std::condition_variable cvReady;
+	std::vector<std::thread> workers;
+	std::deque<ssJob> jobs;
+	unsigned int threadCount;
+	size_t maxPendingJobs;
+	bool shouldRunWorkers = true;
+
+	// Bumped on Clear so jobs that were in flight don't write into the next replay
+	u64 generation = 0;
+
+	std::shared_ptr<const std::vector<u8>> initialState;
+	std::shared_ptr<const std::vector<u8>> lastKeyframe;
+	s32 lastKeyframeFrame = INITIAL_STATE_FRAME;
+	int statesSinceKeyframe = 0;
+
+	std::map<s32, ssEntry> entries;
+};
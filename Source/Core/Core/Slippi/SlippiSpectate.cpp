@@ -1,8 +1,11 @@
 #include "SlippiSpectate.h"
+#include "Common/Common.h"
 #include "Common/CommonTypes.h"
 #include "Common/Logging/Log.h"
 #include "base64.hpp"
 #include <Core/ConfigManager.h>
+#include <algorithm>
+#include <cstring>
 
 // Networking
 #ifdef _WIN32
@@ -10,8 +13,31 @@
 #include <ws2tcpip.h>
 #else
 #include <errno.h>
+#include <time.h>
 #endif
 
+// CPU time used by the calling thread
+static u64 getThreadCpuTimeUs()
+{
+#ifdef _WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+	{
+		return 0;
+	}
+	u64 kernel = (u64)kernel_time.dwHighDateTime << 32 | kernel_time.dwLowDateTime;
+	u64 user = (u64)user_time.dwHighDateTime << 32 | user_time.dwLowDateTime;
+	return (kernel + user) / 10;
+#else
+	timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+	{
+		return 0;
+	}
+	return (u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
 // CALLED FROM DOLPHIN MAIN THREAD
 SlippiSpectateServer *SlippiSpectateServer::getInstance()
 {
@@ -20,41 +46,131 @@ SlippiSpectateServer *SlippiSpectateServer::getInstance()
 	return &instance;
 }
 
+// CALLED FROM DOLPHIN MAIN THREAD
+void SlippiSpectateServer::pushRecord(u8 record_type, const u8 *data, u32 length)
+{
+	if (!m_is_overflowing.load(std::memory_order_acquire) && m_event_ring->Push(record_type, data, length))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lk(m_overflow_mutex);
+	if (m_overflowed_events == 0)
+	{
+		WARN_LOG(SLIPPI, "Spectator server fell behind, queueing events");
+	}
+	m_overflow.emplace_back(record_type, length ? std::string((const char *)data, length) : std::string());
+	m_is_overflowing.store(true, std::memory_order_release);
+	m_overflowed_events++;
+}
+
 // CALLED FROM DOLPHIN MAIN THREAD
 void SlippiSpectateServer::write(u8 *payload, u32 length)
 {
-	if (!SConfig::GetInstance().m_enableSpectator)
+	if (!SConfig::GetInstance().m_enableSpectator || !m_event_ring)
 	{
 		return;
 	}
-	std::string str_payload((char *)payload, length);
-	m_event_queue.Push(str_payload);
+	pushRecord(SPECTATE_RECORD_EVENT, payload, length);
 }
 
 // CALLED FROM DOLPHIN MAIN THREAD
 void SlippiSpectateServer::startGame()
 {
-	if (!SConfig::GetInstance().m_enableSpectator)
+	if (!SConfig::GetInstance().m_enableSpectator || !m_event_ring)
 	{
 		return;
 	}
-
-	json start_game_message;
-	start_game_message["type"] = "start_game";
-	m_event_queue.Push(start_game_message.dump());
+	pushRecord(SPECTATE_RECORD_START_GAME, nullptr, 0);
 }
 
 // CALLED FROM DOLPHIN MAIN THREAD
 void SlippiSpectateServer::endGame(bool dolphin_closed)
 {
-	if (!SConfig::GetInstance().m_enableSpectator)
+	if (!SConfig::GetInstance().m_enableSpectator || !m_event_ring)
 	{
 		return;
 	}
-	json end_game_message;
-	end_game_message["type"] = "end_game";
-	end_game_message["dolphin_closed"] = dolphin_closed;
-	m_event_queue.Push(end_game_message.dump());
+	u8 closed = dolphin_closed;
+	pushRecord(SPECTATE_RECORD_END_GAME, &closed, 1);
+}
+
+// CALLED FROM ANY THREAD
+SpectateServerStats SlippiSpectateServer::getStats() const
+{
+	SpectateServerStats stats;
+	stats.packets_sent = m_packets_sent;
+	stats.bytes_sent = m_bytes_sent;
+	stats.thread_cpu_us = m_thread_cpu_us;
+	stats.overflowed_events = m_overflowed_events;
+	return stats;
+}
+
+void SlippiSpectateHistory::Append(const std::string &message)
+{
+	u32 length = (u32)message.size();
+	if (m_chunk_used + length > m_chunk_capacity)
+	{
+		m_chunk_capacity = std::max<size_t>(SPECTATE_HISTORY_CHUNK_SIZE, length);
+		m_chunks.emplace_back(new u8[m_chunk_capacity]);
+		m_chunk_used = 0;
+	}
+
+	u8 *data = m_chunks.back().get() + m_chunk_used;
+	memcpy(data, message.data(), length);
+	m_chunk_used += length;
+	m_messages.emplace_back(data, length);
+}
+
+// CALLED FROM SERVER THREAD
+void SlippiSpectateServer::releaseHistoryPacket(ENetPacket *packet)
+{
+	SlippiSpectateHistory *history = static_cast<SlippiSpectateHistory *>(packet->userData);
+	history->m_packet_refs--;
+	if (history->m_is_retired && history->m_packet_refs == 0)
+	{
+		delete history;
+	}
+}
+
+// CALLED FROM SERVER THREAD
+void SlippiSpectateServer::resetHistory()
+{
+	if (m_history)
+	{
+		// Packets still waiting to go out keep the old history alive until ENet frees them
+		m_history->m_is_retired = true;
+		if (m_history->m_packet_refs == 0)
+		{
+			delete m_history;
+		}
+	}
+	m_history = new SlippiSpectateHistory();
+}
+
+// CALLED FROM SERVER THREAD
+void SlippiSpectateServer::appendMessage(u32 cursor, const char *type, const std::string *payload, bool dolphin_closed)
+{
+	// Written by hand in the same key order json::dump() uses, so nothing changes for clients
+	m_message_scratch = "{\"cursor\":";
+	m_message_scratch += std::to_string(cursor);
+	if (!strcmp(type, "end_game"))
+	{
+		m_message_scratch += dolphin_closed ? ",\"dolphin_closed\":true" : ",\"dolphin_closed\":false";
+	}
+	m_message_scratch += ",\"next_cursor\":";
+	m_message_scratch += std::to_string(cursor + 1);
+	if (payload)
+	{
+		m_message_scratch += ",\"payload\":\"";
+		m_message_scratch += base64::Base64::Encode(*payload);
+		m_message_scratch += "\"";
+	}
+	m_message_scratch += ",\"type\":\"";
+	m_message_scratch += type;
+	m_message_scratch += "\"}";
+
+	m_history->Append(m_message_scratch);
 }
 
 // CALLED FROM SERVER THREAD
@@ -66,6 +182,8 @@ void SlippiSpectateServer::writeEvents(u16 peer_id)
 		ENetPacket *packet = enet_packet_create(m_menu_event.data(), m_menu_event.length(), ENET_PACKET_FLAG_RELIABLE);
 		// Batch for sending
 		enet_peer_send(m_sockets[peer_id]->m_peer, 0, packet);
+		m_packets_sent++;
+		m_bytes_sent += m_menu_event.length();
 		// Record for the peer that it was sent
 		m_sockets[peer_id]->m_menu_cursor = m_menu_cursor;
 	}
@@ -76,17 +194,29 @@ void SlippiSpectateServer::writeEvents(u16 peer_id)
 	// If the client's cursor is beyond the end of the event buffer, then
 	//  it's probably left over from an old game. (Or is invalid anyway)
 	//  So reset it back to 0
-	if (m_sockets[peer_id]->m_cursor > m_event_buffer.size())
+	if (m_sockets[peer_id]->m_cursor > m_history->Size())
 	{
 		m_sockets[peer_id]->m_cursor = 0;
 	}
 
-	for (u64 i = m_sockets[peer_id]->m_cursor; i < m_event_buffer.size(); i++)
+	for (u64 i = m_sockets[peer_id]->m_cursor; i < m_history->Size(); i++)
 	{
-		ENetPacket *packet =
-		    enet_packet_create(m_event_buffer[i].data(), m_event_buffer[i].size(), ENET_PACKET_FLAG_RELIABLE);
+		// The packet borrows the message straight from the history
+		ENetPacket *packet = enet_packet_create(m_history->MessageData(i), m_history->MessageLength(i),
+		                                        ENET_PACKET_FLAG_RELIABLE | ENET_PACKET_FLAG_NO_ALLOCATE);
+		packet->userData = m_history;
+		packet->freeCallback = releaseHistoryPacket;
+		m_history->m_packet_refs++;
 		// Batch for sending
-		enet_peer_send(m_sockets[peer_id]->m_peer, 0, packet);
+		if (enet_peer_send(m_sockets[peer_id]->m_peer, 0, packet) < 0)
+		{
+			enet_packet_destroy(packet);
+		}
+		else
+		{
+			m_packets_sent++;
+			m_bytes_sent += m_history->MessageLength(i);
+		}
 		m_sockets[peer_id]->m_cursor++;
 	}
 }
@@ -94,72 +224,89 @@ void SlippiSpectateServer::writeEvents(u16 peer_id)
 // CALLED FROM SERVER THREAD
 void SlippiSpectateServer::popEvents()
 {
-	// Loop through the event queue and keep popping off events and handling them
-	while (!m_event_queue.Empty())
-	{
-		std::string event;
-		m_event_queue.Pop(event);
-		// These two are meta-events, used to signify the start/end of a game
-		json json_message = json::parse(event, nullptr, false);
-		if (!json_message.is_discarded() && (json_message.find("type") != json_message.end()))
-		{
-			if (json_message["type"] == "end_game")
-			{
-				u32 cursor = (u32)(m_event_buffer.size() + m_cursor_offset);
-				json_message["cursor"] = cursor;
-				json_message["next_cursor"] = cursor + 1;
-				m_menu_cursor = 0;
-				m_event_buffer.push_back(json_message.dump());
-				m_cursor_offset += m_event_buffer.size();
-				m_menu_event.clear();
-				m_in_game = false;
-				continue;
-			}
-			if (json_message["type"] == "start_game")
-			{
-				m_event_buffer.clear();
-				u32 cursor = (u32)(m_event_buffer.size() + m_cursor_offset);
-				m_in_game = true;
-				json_message["cursor"] = cursor;
-				json_message["next_cursor"] = cursor + 1;
-				m_event_buffer.push_back(json_message.dump());
-				continue;
-			}
-		}
+	// Loop through the event ring and keep popping off events and handling them
+	u8 record_type;
+	while (m_event_ring->Pop(record_type, m_event_scratch))
+	{
+		handleRecord(record_type, m_event_scratch);
+	}
 
-		// Make json wrapper for game event
-		json game_event;
+	if (!m_is_overflowing.load(std::memory_order_acquire))
+	{
+		return;
+	}
 
-		if (!m_in_game)
+	{
+		// The dolphin thread stops pushing to the ring once it overflows, so whatever is still in the ring
+		//  came before the overflow queue. Holding the lock keeps anything new from going into either
+		std::lock_guard<std::mutex> lk(m_overflow_mutex);
+		while (m_event_ring->Pop(record_type, m_event_scratch))
 		{
-			game_event["payload"] = base64::Base64::Encode(event);
-			m_menu_cursor += 1;
-			game_event["type"] = "menu_event";
-			m_menu_event = game_event.dump();
-			continue;
+			handleRecord(record_type, m_event_scratch);
 		}
+		m_overflow_scratch.swap(m_overflow);
+		m_is_overflowing.store(false, std::memory_order_release);
+	}
+
+	// Anything pushed to the ring from here on is newer, it's handled on the next call
+	for (auto &record : m_overflow_scratch)
+	{
+		handleRecord(record.first, record.second);
+	}
+	m_overflow_scratch.clear();
+}
 
-		u8 command = (u8)event[0];
-		m_event_concat = m_event_concat + event;
+// CALLED FROM SERVER THREAD
+void SlippiSpectateServer::handleRecord(u8 record_type, const std::string &data)
+{
+	// These two are meta-events, used to signify the start/end of a game
+	if (record_type == SPECTATE_RECORD_END_GAME)
+	{
+		u32 cursor = (u32)(m_history->Size() + m_cursor_offset);
+		m_menu_cursor = 0;
+		appendMessage(cursor, "end_game", nullptr, !data.empty() && data[0]);
+		m_cursor_offset += m_history->Size();
+		m_menu_event.clear();
+		m_in_game = false;
+		return;
+	}
+	if (record_type == SPECTATE_RECORD_START_GAME)
+	{
+		resetHistory();
+		u32 cursor = (u32)(m_history->Size() + m_cursor_offset);
+		m_in_game = true;
+		m_event_concat.clear();
+		appendMessage(cursor, "start_game", nullptr);
+		return;
+	}
 
-		static std::unordered_map<u8, bool> sendEvents = {
-		    {0x36, true}, // GAME_INIT
-		    {0x3C, true}, // FRAME_END
-		    {0x39, true}, // GAME_END
-		    {0x10, true}, // SPLIT_MESSAGE
-		};
+	if (data.empty())
+	{
+		return;
+	}
 
-		if (sendEvents.count(command))
-		{
-			u32 cursor = (u32)(m_event_buffer.size() + m_cursor_offset);
-			game_event["payload"] = base64::Base64::Encode(m_event_concat);
-			game_event["type"] = "game_event";
-			game_event["cursor"] = cursor;
-			game_event["next_cursor"] = cursor + 1;
-			m_event_buffer.push_back(game_event.dump());
-
-			m_event_concat = "";
-		}
+	if (!m_in_game)
+	{
+		m_menu_cursor += 1;
+		m_menu_event = "{\"payload\":\"" + base64::Base64::Encode(data) + "\",\"type\":\"menu_event\"}";
+		return;
+	}
+
+	u8 command = (u8)data[0];
+	m_event_concat += data;
+
+	switch (command)
+	{
+	case 0x36: // GAME_INIT
+	case 0x3C: // FRAME_END
+	case 0x39: // GAME_END
+	case 0x10: // SPLIT_MESSAGE
+	{
+		u32 cursor = (u32)(m_history->Size() + m_cursor_offset);
+		appendMessage(cursor, "game_event", &m_event_concat);
+		m_event_concat.clear();
+		break;
+	}
 	}
 }
 
@@ -175,6 +322,9 @@ SlippiSpectateServer::SlippiSpectateServer()
 	m_menu_cursor = 0;
 	m_menu_event.clear();
 	m_cursor_offset = 0;
+	m_event_ring = std::make_unique<SlippiEventRing>(SPECTATE_EVENT_RING_SIZE);
+	m_history = new SlippiSpectateHistory();
+	m_event_concat.reserve(64 * 1024);
 
 	// Spawn thread for socket listener
 	m_stop_socket_thread = false;
@@ -191,6 +341,9 @@ SlippiSpectateServer::~SlippiSpectateServer()
 	{
 		m_socketThread.join();
 	}
+
+	// The server thread has destroyed its host by now, so no packet points into the history anymore
+	delete m_history;
 }
 
 // CALLED FROM SERVER THREAD
@@ -224,7 +377,7 @@ void SlippiSpectateServer::handleMessage(u8 *buffer, u32 length, u16 peer_id)
 			if (requested_cursor >= m_cursor_offset)
 			{
 				// If the requested cursor is past what events we even have, then just tell them to start over
-				if (requested_cursor > m_event_buffer.size() + m_cursor_offset)
+				if (requested_cursor > m_history->Size() + m_cursor_offset)
 				{
 					m_sockets[peer_id]->m_cursor = 0;
 				}
@@ -246,7 +399,7 @@ void SlippiSpectateServer::handleMessage(u8 *buffer, u32 length, u16 peer_id)
 			//  set their cursor to the end
 			if (!m_in_game)
 			{
-				m_sockets[peer_id]->m_cursor = m_event_buffer.size();
+				m_sockets[peer_id]->m_cursor = m_history->Size();
 			}
 
 			json reply;
@@ -366,6 +519,8 @@ void SlippiSpectateServer::SlippicommSocketThread(void)
 			}
 			}
 		}
+
+		m_thread_cpu_us = getThreadCpuTimeUs();
 	}
 
 	enet_host_destroy(server);
@@ -3,9 +3,12 @@
 #include <atomic>
 #include <chrono>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
-#include "Common/FifoQueue.h"
+#include "Core/Slippi/SlippiEventRing.h"
 #include "nlohmann/json.hpp"
 #include <enet/enet.h>
 using json = nlohmann::json;
@@ -19,7 +22,9 @@ using json = nlohmann::json;
 typedef int SOCKET;
 #endif
 
+#ifndef MAX_CLIENTS
 #define MAX_CLIENTS 4
+#endif
 
 #define HANDSHAKE_MSG_BUF_SIZE 128
 #define HANDSHAKE_TYPE 1
@@ -27,6 +32,18 @@ typedef int SOCKET;
 #define KEEPALIVE_TYPE 3
 #define MENU_TYPE 4
 
+// Size of the ring between the dolphin and server threads. Has to be a power of two
+#define SPECTATE_EVENT_RING_SIZE (4 * 1024 * 1024)
+// Size of each chunk of the game event history
+#define SPECTATE_HISTORY_CHUNK_SIZE (1024 * 1024)
+
+enum SpectateRecordType : u8
+{
+	SPECTATE_RECORD_EVENT,
+	SPECTATE_RECORD_START_GAME,
+	SPECTATE_RECORD_END_GAME,
+};
+
 class SlippiSocket
 {
   public:
@@ -36,6 +53,35 @@ class SlippiSocket
 	ENetPeer *m_peer = NULL;    // The ENet peer object for the socket
 };
 
+// Every message sent during a game, stored back to back in fixed size chunks. Chunks never move,
+//  so the packets that catch up a spectator point straight into them instead of copying
+class SlippiSpectateHistory
+{
+  public:
+	void Append(const std::string &message);
+	u64 Size() const { return m_messages.size(); }
+	const u8 *MessageData(u64 index) const { return m_messages[index].first; }
+	u32 MessageLength(u64 index) const { return m_messages[index].second; }
+
+	// Packets still pointing into this history. A retired history is deleted when the last one is freed
+	u32 m_packet_refs = 0;
+	bool m_is_retired = false;
+
+  private:
+	std::vector<std::unique_ptr<u8[]>> m_chunks;
+	size_t m_chunk_used = 0;
+	size_t m_chunk_capacity = 0;
+	std::vector<std::pair<const u8 *, u32>> m_messages;
+};
+
+struct SpectateServerStats
+{
+	u64 packets_sent;
+	u64 bytes_sent;
+	u64 thread_cpu_us; // CPU time used by the server thread so far
+	u32 overflowed_events; // Events that went through the overflow queue because the ring was full
+};
+
 class SlippiSpectateServer
 {
   public:
@@ -59,26 +105,43 @@ class SlippiSpectateServer
 	// If this was called due to dolphin closing then dolphin_closed will be true
 	void endGame(bool dolphin_closed = false);
 
+	// Counters for measuring the server, can be read from any thread
+	SpectateServerStats getStats() const;
+
 	// Don't try to copy the class. Delete those functions
 	SlippiSpectateServer(SlippiSpectateServer const &) = delete;
 	void operator=(SlippiSpectateServer const &) = delete;
 
   private:
 	// ACCESSED FROM BOTH DOLPHIN AND SERVER THREADS
-	// This is a lockless queue that bridges the gap between the main
+	// This is a lockless ring that bridges the gap between the main
 	//  dolphin thread and the spectator server thread. The purpose here
-	//  is to avoid blocking (even if just for a brief mutex) on the main
-	//  dolphin thread.
-	Common::FifoQueue<std::string> m_event_queue;
+	//  is to avoid blocking (even if just for a brief mutex) or allocating
+	//  on the main dolphin thread.
+	std::unique_ptr<SlippiEventRing> m_event_ring;
+	// Records that didn't fit in the ring because the server thread fell behind. Nothing is dropped,
+	//  once a record goes here every following one does too until the server thread takes them,
+	//  which keeps them in order
+	std::mutex m_overflow_mutex;
+	std::vector<std::pair<u8, std::string>> m_overflow;
+	std::atomic<bool> m_is_overflowing{false};
+	std::atomic<u32> m_overflowed_events{0};
 	// Bool gets flipped by the destrctor to tell the server thread to shut down
 	//  bools are probably atomic by default, but just for safety...
 	std::atomic<bool> m_stop_socket_thread;
+	// Only written by the server thread
+	std::atomic<u64> m_packets_sent{0};
+	std::atomic<u64> m_bytes_sent{0};
+	std::atomic<u64> m_thread_cpu_us{0};
 
 	// ONLY ACCESSED FROM SERVER THREAD
 	bool m_in_game;
 	std::map<u16, std::shared_ptr<SlippiSocket>> m_sockets;
-	std::string m_event_concat = "";
-	std::vector<std::string> m_event_buffer;
+	std::string m_event_concat;
+	std::string m_event_scratch;
+	std::vector<std::pair<u8, std::string>> m_overflow_scratch;
+	std::string m_message_scratch;
+	SlippiSpectateHistory *m_history = nullptr;
 	std::string m_menu_event;
 	// In order to emulate Wii behavior, the cursor position should be strictly
 	//  increasing. But internally, we need to index arrays by the cursor value.
@@ -95,6 +158,9 @@ class SlippiSpectateServer
 	SlippiSpectateServer();
 	~SlippiSpectateServer();
 
+	// Hands a record to the server thread through the ring, or the overflow queue when the ring is full
+	void pushRecord(u8 record_type, const u8 *data, u32 length);
+
 	// FUNCTIONS CALLED ONLY FROM SERVER THREAD
 	// Server thread. Accepts new incoming connections and goes back to sleep
 	void SlippicommSocketThread(void);
@@ -105,4 +171,12 @@ class SlippiSpectateServer
 	void writeEvents(u16 peer_id);
 	// Pop events
 	void popEvents();
+	// Handles one record from the ring or the overflow queue
+	void handleRecord(u8 record_type, const std::string &data);
+	// Swap in an empty history for a new game
+	void resetHistory();
+	// Appends a game_event / start_game / end_game message with the given cursor to the history
+	void appendMessage(u32 cursor, const char *type, const std::string *payload, bool dolphin_closed = false);
+	// Frees the history a sent catch-up packet pointed into once nothing else needs it
+	static void releaseHistoryPacket(ENetPacket *packet);
 };
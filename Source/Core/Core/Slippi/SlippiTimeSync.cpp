@@ -0,0 +1,170 @@
+#include "SlippiTimeSync.h"
+
+#include <algorithm>
+#include <cmath>
+
+// How much the real offset is expected to wander between two samples, mostly the remote player
+// adjusting their own timing
+static const double PROCESS_NOISE_US = 200.0;
+static const double INITIAL_NOISE_US = 2000.0;
+static const double MIN_NOISE_US = 250.0;
+static const double NOISE_SMOOTHING = 0.05;
+static const double RTT_SMOOTHING = 0.1;
+// Samples further than this many deviations from the estimate barely move it
+static const double OUTLIER_DEVIATIONS = 3.0;
+static const double OUTLIER_NOISE_SCALE = 25.0;
+
+// Controller gains, per frame
+static const double PROPORTIONAL_GAIN = 0.1;
+static const double INTEGRAL_GAIN = 0.005;
+static const double MAX_INTEGRAL_US = 200.0;
+// At most 3% of a frame so the slowdown can't be seen or heard
+static const double MAX_NUDGE_US = 500.0;
+static const double DEADBAND_US = 250.0;
+
+void SlippiTimeSync::Reset(int remotePlayerCount)
+{
+	std::lock_guard<std::mutex> lk(mutex);
+
+	playerCount = std::min(remotePlayerCount, SLIPPI_TIME_SYNC_MAX_PLAYERS);
+	for (auto &filter : filters)
+		filter = Filter();
+
+	integralUs = 0;
+	lastNudgeUs = 0;
+	totalNudgeUs = 0;
+	totalShiftUs = 0;
+}
+
+void SlippiTimeSync::AddSample(int playerIdx, s64 offsetUs, u64 rttUs)
+{
+	std::lock_guard<std::mutex> lk(mutex);
+
+	if (playerIdx < 0 || playerIdx >= playerCount)
+		return;
+
+	Filter &filter = filters[playerIdx];
+	filter.sampleCount++;
+
+	if (!filter.isInitialized)
+	{
+		filter.isInitialized = true;
+		filter.offsetUs = (double)offsetUs;
+		filter.variance = INITIAL_NOISE_US * INITIAL_NOISE_US;
+		filter.noiseVariance = INITIAL_NOISE_US * INITIAL_NOISE_US;
+		filter.rttUs = (double)rttUs;
+		return;
+	}
+
+	// The sample assumes the pad took half the RTT to get here, so RTT jitter lands straight in it
+	double rttJitterUs = ((double)rttUs - filter.rttUs) / 2;
+	filter.rttUs += RTT_SMOOTHING * ((double)rttUs - filter.rttUs);
+	double sampleVariance = filter.noiseVariance + rttJitterUs * rttJitterUs;
+
+	filter.variance += PROCESS_NOISE_US * PROCESS_NOISE_US;
+
+	double innovation = (double)offsetUs - filter.offsetUs;
+	double innovationVariance = filter.variance + sampleVariance;
+	double outlierLimit = OUTLIER_DEVIATIONS * OUTLIER_DEVIATIONS * innovationVariance;
+	if (innovation * innovation > outlierLimit)
+	{
+		filter.outlierCount++;
+		sampleVariance *= OUTLIER_NOISE_SCALE;
+		innovationVariance = filter.variance + sampleVariance;
+	}
+
+	double gain = filter.variance / innovationVariance;
+	filter.offsetUs += gain * innovation;
+	filter.variance *= 1 - gain;
+
+	// Learn how noisy the link is from how far samples land from the estimate
+	double squaredError = std::min(innovation * innovation, outlierLimit);
+	filter.noiseVariance += NOISE_SMOOTHING * (squaredError - filter.noiseVariance);
+	filter.noiseVariance = std::max(filter.noiseVariance, MIN_NOISE_US * MIN_NOISE_US);
+}
+
+s32 SlippiTimeSync::Update()
+{
+	std::lock_guard<std::mutex> lk(mutex);
+
+	lastNudgeUs = 0;
+
+	bool hasSamples = false;
+	for (int i = 0; i < playerCount; i++)
+		hasSamples |= filters[i].isInitialized;
+	if (!hasSamples)
+		return 0;
+
+	double error = maxOffsetUs();
+	if (std::abs(error) < DEADBAND_US)
+		error = 0;
+
+	// Only ever slow down, a player that is behind is left to the players ahead of them. The integral
+	// covers the steady drift between two clocks and stops growing while the output is maxed out
+	double integral = std::max(0.0, std::min(MAX_INTEGRAL_US, integralUs + INTEGRAL_GAIN * error));
+	double nudge = PROPORTIONAL_GAIN * error + integral;
+	if (nudge <= MAX_NUDGE_US)
+		integralUs = integral;
+
+	lastNudgeUs = (s32)std::max(0.0, std::min(MAX_NUDGE_US, nudge));
+	totalNudgeUs += lastNudgeUs;
+
+	// Account for the delay right away, the samples only show it once the next pads come in
+	for (int i = 0; i < playerCount; i++)
+		filters[i].offsetUs -= lastNudgeUs;
+
+	return lastNudgeUs;
+}
+
+void SlippiTimeSync::ShiftLocalTime(s64 delayUs)
+{
+	std::lock_guard<std::mutex> lk(mutex);
+
+	for (int i = 0; i < playerCount; i++)
+		filters[i].offsetUs -= (double)delayUs;
+	totalShiftUs += delayUs;
+}
+
+s32 SlippiTimeSync::GetOffsetUs()
+{
+	std::lock_guard<std::mutex> lk(mutex);
+	return maxOffsetUs();
+}
+
+SlippiTimeSync::State SlippiTimeSync::GetState()
+{
+	std::lock_guard<std::mutex> lk(mutex);
+
+	State state = {};
+	for (int i = 0; i < playerCount; i++)
+	{
+		state.offsetUs[i] = (s32)filters[i].offsetUs;
+		state.deviationUs[i] = (s32)std::sqrt(filters[i].variance);
+		state.noiseUs[i] = (s32)std::sqrt(filters[i].noiseVariance);
+		state.sampleCount[i] = filters[i].sampleCount;
+		state.outlierCount[i] = filters[i].outlierCount;
+	}
+	state.errorUs = maxOffsetUs();
+	state.integralUs = (s32)integralUs;
+	state.nudgeUs = lastNudgeUs;
+	state.totalNudgeUs = totalNudgeUs;
+	state.totalShiftUs = totalShiftUs;
+	return state;
+}
+
+s32 SlippiTimeSync::maxOffsetUs()
+{
+	bool hasOffset = false;
+	double maxOffset = 0;
+	for (int i = 0; i < playerCount; i++)
+	{
+		if (!filters[i].isInitialized)
+			continue;
+
+		if (!hasOffset || filters[i].offsetUs > maxOffset)
+			maxOffset = filters[i].offsetUs;
+		hasOffset = true;
+	}
+
+	return (s32)maxOffset;
+}
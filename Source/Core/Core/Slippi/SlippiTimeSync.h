@@ -0,0 +1,64 @@
+#pragma once
+
+#include <mutex>
+
+#include "Common/CommonTypes.h"
+
+#define SLIPPI_TIME_SYNC_MAX_PLAYERS 3
+
+// Keeps the local frame timing in step with the remote players. Every received pad gives a noisy
+// sample of how far ahead of a remote player we are, those are smoothed by a Kalman filter per player
+// and a PI controller turns the largest estimate into a small delay for the local frame pacer
+class SlippiTimeSync
+{
+  public:
+	struct State
+	{
+		s32 offsetUs[SLIPPI_TIME_SYNC_MAX_PLAYERS];    // Estimated offset, positive means we're ahead
+		s32 deviationUs[SLIPPI_TIME_SYNC_MAX_PLAYERS]; // Standard deviation of the estimate
+		s32 noiseUs[SLIPPI_TIME_SYNC_MAX_PLAYERS];     // Standard deviation of the samples
+		u32 sampleCount[SLIPPI_TIME_SYNC_MAX_PLAYERS];
+		u32 outlierCount[SLIPPI_TIME_SYNC_MAX_PLAYERS];
+		s32 errorUs;    // Largest offset, what the controller steers towards 0
+		s32 integralUs; // Integral term of the controller, per frame
+		s32 nudgeUs;    // Delay added to the last frame
+		s64 totalNudgeUs;
+		s64 totalShiftUs; // Delay added by whole frame skips
+	};
+
+	void Reset(int remotePlayerCount);
+
+	// Called from the network thread for every pad packet
+	void AddSample(int playerIdx, s64 offsetUs, u64 rttUs);
+
+	// Runs the controller for one frame and returns how many microseconds to delay the frame pacer by
+	s32 Update();
+
+	// Tells the filter the local clock was held back by delayUs, for example by skipping frames
+	void ShiftLocalTime(s64 delayUs);
+
+	s32 GetOffsetUs();
+	State GetState();
+
+  private:
+	struct Filter
+	{
+		bool isInitialized = false;
+		double offsetUs = 0;
+		double variance = 0;
+		double noiseVariance = 0;
+		double rttUs = 0;
+		u32 sampleCount = 0;
+		u32 outlierCount = 0;
+	};
+
+	s32 maxOffsetUs();
+
+	std::mutex mutex;
+	int playerCount = 0;
+	Filter filters[SLIPPI_TIME_SYNC_MAX_PLAYERS];
+	double integralUs = 0;
+	s32 lastNudgeUs = 0;
+	s64 totalNudgeUs = 0;
+	s64 totalShiftUs = 0;
+};
@@ -2,6 +2,9 @@
 // Licensed under GPLv2+
 // Refer to the license.txt file included.
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <lzo/lzo1x.h>
 #include <map>
 #include <mutex>
@@ -31,6 +34,7 @@
 #include "Core/NetPlayClient.h"
 #include "Core/PowerPC/PowerPC.h"
 #include "Core/State.h"
+#include "Core/StateSlotCache.h"
 
 #include "VideoCommon/AVIDump.h"
 #include "VideoCommon/OnScreenDisplay.h"
@@ -48,12 +52,14 @@ static const u32 IN_LEN = 128 * 1024u;
 
 static const u32 OUT_LEN = IN_LEN + (IN_LEN / 16) + 64 + 3;
 
+// Only used to load states in the old format, where chunks have to be decompressed in order
 static unsigned char __LZO_MMODEL out[OUT_LEN];
 
-#define HEAP_ALLOC(var, size)                                                                      \
-  lzo_align_t __LZO_MMODEL var[((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t)]
-
-static HEAP_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
+// Compressed states are written as independent IN_LEN chunks that are compressed and decompressed on
+// every core. Right after the StateHeader comes CHUNKED_STATE_MARKER, the chunk size, the chunk count
+// and the compressed size of every chunk, then the chunks themselves. The old format instead had a
+// compressed length in front of every chunk, which can never be as large as the marker
+static const u32 CHUNKED_STATE_MARKER = 0xFFFFFFFF;
 
 static std::string g_last_filename;
 
@@ -70,6 +76,16 @@ static Common::Event g_compressAndDumpStateSyncEvent;
 
 static std::thread g_save_thread;
 
+// The states saved this session, so loading them doesn't have to go through their files
+static SlotCache g_slot_cache;
+
+// Size of the last state saved or loaded this session, 0 until there is one. Saves size their buffer
+// from it and serialize in one pass instead of measuring the state first, see WriteStateToBuffer
+static std::atomic<size_t> g_state_size_hint(0);
+// Room left past the hint for the parts of the state that can grow between saves, like the event
+// queue or the movie input log. Anything bigger falls back to a second pass
+static const size_t STATE_SIZE_SLACK = 256 * 1024;
+
 // Don't forget to increase this after doing changes on the savestate system
 static const u32 STATE_VERSION = 68;  // Last changed in PR 4638
 
@@ -183,6 +199,45 @@ static std::string DoState(PointerWrap& p)
 	return version_created_by;
 }
 
+// Serializes the state into buffer, which keeps its capacity between calls. Returns false if DoState
+// gave up on the state
+static bool WriteStateToBuffer(std::vector<u8>& buffer)
+{
+	size_t capacity = g_state_size_hint;
+	if (!capacity)
+	{
+		u8* ptr = nullptr;
+		PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
+		DoState(p);
+		capacity = reinterpret_cast<size_t>(ptr);
+	}
+	else
+	{
+		capacity += STATE_SIZE_SLACK;
+	}
+
+	while (true)
+	{
+		buffer.resize(capacity);
+		u8* ptr = buffer.data();
+		PointerWrap p(&ptr, PointerWrap::MODE_WRITE, buffer.data() + buffer.size());
+		DoState(p);
+
+		const size_t size = ptr - buffer.data();
+		if (p.GetMode() == PointerWrap::MODE_WRITE)
+		{
+			buffer.resize(size);
+			g_state_size_hint = size;
+			return true;
+		}
+
+		// Running out of room measures the rest of the state, so the second try fits
+		if (size <= capacity)
+			return false;
+		capacity = size;
+	}
+}
+
 void LoadFromBuffer(std::vector<u8>& buffer)
 {
 	if ((NetPlay::IsNetPlayRunning()) && (netplay_client->GetPlayers().size() != 1))
@@ -196,6 +251,8 @@ void LoadFromBuffer(std::vector<u8>& buffer)
 	u8* ptr = &buffer[0];
 	PointerWrap p(&ptr, PointerWrap::MODE_READ);
 	DoState(p);
+	if (p.GetMode() == PointerWrap::MODE_READ)
+		g_state_size_hint = buffer.size();
 
 	Core::PauseAndLock(false, wasUnpaused);
 }
@@ -204,16 +261,7 @@ void SaveToBuffer(std::vector<u8>& buffer)
 {
 	bool wasUnpaused = Core::PauseAndLock(true);
 
-	u8* ptr = nullptr;
-	PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
-
-	DoState(p);
-	const size_t buffer_size = reinterpret_cast<size_t>(ptr);
-	buffer.resize(buffer_size);
-
-	ptr = &buffer[0];
-	p.SetMode(PointerWrap::MODE_WRITE);
-	DoState(p);
+	WriteStateToBuffer(buffer);
 
 	Core::PauseAndLock(false, wasUnpaused);
 }
@@ -284,6 +332,66 @@ struct CompressAndDumpState_args
 	bool wait;
 };
 
+static size_t GetChunkWorkerCount(size_t chunk_count)
+{
+	return std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), chunk_count));
+}
+
+// Calls func(chunk, worker) for every chunk, spread over up to one thread per core with the calling thread
+// being worker 0
+static void ForEachChunk(size_t chunk_count, const std::function<void(size_t, size_t)>& func)
+{
+	std::atomic<size_t> next_chunk(0);
+	auto run_worker = [&](size_t worker) {
+		for (size_t chunk = next_chunk++; chunk < chunk_count; chunk = next_chunk++)
+			func(chunk, worker);
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < GetChunkWorkerCount(chunk_count); i++)
+		threads.emplace_back(run_worker, i);
+	run_worker(0);
+	for (auto& thread : threads)
+		thread.join();
+}
+
+// Reads the chunk index and chunks of a state in the chunked format into buffer, which is already the size
+// of the uncompressed state
+static bool LoadChunkedStateData(File::IOFile& f, u32 chunk_size, u32 chunk_count, std::vector<u8>& buffer)
+{
+	if (chunk_size == 0 || chunk_count != (buffer.size() + chunk_size - 1) / chunk_size)
+		return false;
+
+	std::vector<u32> chunk_sizes(chunk_count);
+	if (!f.ReadArray(chunk_sizes.data(), chunk_count))
+		return false;
+
+	std::vector<size_t> chunk_offsets(chunk_count);
+	size_t compressed_size = 0;
+	for (u32 i = 0; i < chunk_count; i++)
+	{
+		chunk_offsets[i] = compressed_size;
+		compressed_size += chunk_sizes[i];
+	}
+
+	std::vector<u8> compressed(compressed_size);
+	if (!f.ReadBytes(compressed.data(), compressed_size))
+		return false;
+
+	std::atomic<bool> is_valid(true);
+	ForEachChunk(chunk_count, [&](size_t chunk, size_t) {
+		const size_t start = chunk * chunk_size;
+		const lzo_uint expected_len = (lzo_uint)std::min<size_t>(chunk_size, buffer.size() - start);
+		lzo_uint new_len = expected_len;
+		if (lzo1x_decompress_safe(&compressed[chunk_offsets[chunk]], chunk_sizes[chunk], &buffer[start], &new_len,
+		                          nullptr) != LZO_E_OK ||
+		    new_len != expected_len)
+			is_valid = false;
+	});
+
+	return is_valid;
+}
+
 static void CompressAndDumpState(CompressAndDumpState_args save_args)
 {
 	std::lock_guard<std::mutex> lk(*save_args.buffer_mutex);
@@ -315,12 +423,19 @@ static void CompressAndDumpState(CompressAndDumpState_args save_args)
 			File::Delete((File::GetUserPath(D_STATESAVES_IDX) + "lastState.sav"));
 		if (File::Exists(File::GetUserPath(D_STATESAVES_IDX) + "lastState.sav.dtm"))
 			File::Delete((File::GetUserPath(D_STATESAVES_IDX) + "lastState.sav.dtm"));
+		g_slot_cache.Remove(File::GetUserPath(D_STATESAVES_IDX) + "lastState.sav");
 
 		if (!File::Rename(filename, File::GetUserPath(D_STATESAVES_IDX) + "lastState.sav"))
+		{
 			Core::DisplayMessage("Failed to move previous state to state undo backup", 1000);
+		}
 		else
+		{
 			File::Rename(filename + ".dtm", File::GetUserPath(D_STATESAVES_IDX) + "lastState.sav.dtm");
+			g_slot_cache.Rename(filename, File::GetUserPath(D_STATESAVES_IDX) + "lastState.sav");
+		}
 	}
+	g_slot_cache.Remove(filename);
 
 	if ((Movie::IsMovieActive()) && !Movie::IsJustStartingRecordingInputFromSaveState())
 		Movie::SaveRecording(filename + ".dtm");
@@ -344,39 +459,45 @@ static void CompressAndDumpState(CompressAndDumpState_args save_args)
 
 	if (header.size != 0)  // non-zero header size means the state is compressed
 	{
-		lzo_uint i = 0;
-		while (true)
-		{
-			lzo_uint32 cur_len = 0;
+		const u32 chunk_count = (u32)((buffer_size + IN_LEN - 1) / IN_LEN);
+		std::vector<std::vector<u8>> chunks(chunk_count);
+		std::vector<u32> chunk_sizes(chunk_count);
+		std::vector<std::vector<lzo_align_t>> wrkmems(GetChunkWorkerCount(chunk_count));
+
+		ForEachChunk(chunk_count, [&](size_t chunk, size_t worker) {
+			std::vector<lzo_align_t>& wrkmem = wrkmems[worker];
+			if (wrkmem.empty())
+				wrkmem.resize((LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t));
+
+			const size_t start = chunk * IN_LEN;
+			const lzo_uint cur_len = (lzo_uint)std::min<size_t>(IN_LEN, buffer_size - start);
 			lzo_uint out_len = 0;
-
-			if ((i + IN_LEN) >= buffer_size)
-			{
-				cur_len = (lzo_uint32)(buffer_size - i);
-			}
-			else
-			{
-				cur_len = IN_LEN;
-			}
-
-			if (lzo1x_1_compress(buffer_data + i, cur_len, out, &out_len, wrkmem) != LZO_E_OK)
+			chunks[chunk].resize(OUT_LEN);
+			if (lzo1x_1_compress(buffer_data + start, cur_len, chunks[chunk].data(), &out_len, wrkmem.data()) !=
+			    LZO_E_OK)
 				PanicAlertT("Internal LZO Error - compression failed");
 
-			// The size of the data to write is 'out_len'
-			f.WriteArray((lzo_uint32*)&out_len, 1);
-			f.WriteBytes(out, out_len);
-
-			if (cur_len != IN_LEN)
-				break;
+			chunk_sizes[chunk] = (u32)out_len;
+		});
 
-			i += cur_len;
-		}
+		const u32 chunk_header[3] = {CHUNKED_STATE_MARKER, IN_LEN, chunk_count};
+		f.WriteArray(chunk_header, 3);
+		f.WriteArray(chunk_sizes.data(), chunk_count);
+		for (u32 i = 0; i < chunk_count; i++)
+			f.WriteBytes(chunks[i].data(), chunk_sizes[i]);
 	}
 	else  // uncompressed
 	{
 		f.WriteBytes(buffer_data, buffer_size);
 	}
 
+	// The stamp has to be taken once the file is complete
+	if (f.IsGood() && f.Close())
+	{
+		g_slot_cache.Put(filename, {File::GetSize(filename), File::GetFileModTimeNs(filename)},
+		                 *save_args.buffer_vector);
+	}
+
 	Core::DisplayMessage(StringFromFormat("Saved State to %s", filename.c_str()), 2000);
 	Host_UpdateMainFrame();
 }
@@ -386,22 +507,13 @@ void SaveAs(const std::string& filename, bool wait)
 	// Pause the core while we save the state
 	bool wasUnpaused = Core::PauseAndLock(true);
 
-	// Measure the size of the buffer.
-	u8* ptr = nullptr;
-	PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
-	DoState(p);
-	const size_t buffer_size = reinterpret_cast<size_t>(ptr);
-
-	// Then actually do the write.
+	bool written;
 	{
 		std::lock_guard<std::mutex> lk(g_cs_current_buffer);
-		g_current_buffer.resize(buffer_size);
-		ptr = &g_current_buffer[0];
-		p.SetMode(PointerWrap::MODE_WRITE);
-		DoState(p);
+		written = WriteStateToBuffer(g_current_buffer);
 	}
 
-	if (p.GetMode() == PointerWrap::MODE_WRITE)
+	if (written)
 	{
 		Core::DisplayMessage("Saving State...", 1000);
 
@@ -457,6 +569,13 @@ std::string GetInfoStringOfSlot(int slot, bool translate)
 static void LoadFileStateData(const std::string& filename, std::vector<u8>& ret_data)
 {
 	Flush();
+
+	// Only states written this session are cached, and the cache is cleared when the game stops. A file
+	// that changed since it was cached, like one rewritten by another instance, is read again
+	if (File::Exists(filename) &&
+	    g_slot_cache.Get(filename, {File::GetSize(filename), File::GetFileModTimeNs(filename)}, ret_data))
+		return;
+
 	File::IOFile f(filename, "rb");
 	if (!f)
 	{
@@ -482,27 +601,42 @@ static void LoadFileStateData(const std::string& filename, std::vector<u8>& ret_
 
 		buffer.resize(header.size);
 
-		lzo_uint i = 0;
-		while (true)
+		u32 chunk_header[3] = {};
+		f.ReadArray(chunk_header, 3);
+		if (chunk_header[0] == CHUNKED_STATE_MARKER)
 		{
-			lzo_uint32 cur_len = 0;  // number of bytes to read
-			lzo_uint new_len = 0;    // number of bytes to write
-
-			if (!f.ReadArray(&cur_len, 1))
-				break;
-
-			f.ReadBytes(out, cur_len);
-			const int res = lzo1x_decompress(out, cur_len, &buffer[i], &new_len, nullptr);
-			if (res != LZO_E_OK)
+			if (!LoadChunkedStateData(f, chunk_header[1], chunk_header[2], buffer))
 			{
-				// This doesn't seem to happen anymore.
-				PanicAlertT("Internal LZO Error - decompression failed (%d) (%li, %li) \n"
-					"Try loading the state again",
-					res, i, new_len);
+				Core::DisplayMessage("State is corrupted", 2000);
 				return;
 			}
+		}
+		else
+		{
+			f.Seek(sizeof(StateHeader), SEEK_SET);
 
-			i += new_len;
+			lzo_uint i = 0;
+			while (true)
+			{
+				lzo_uint32 cur_len = 0;  // number of bytes to read
+				lzo_uint new_len = 0;    // number of bytes to write
+
+				if (!f.ReadArray(&cur_len, 1))
+					break;
+
+				f.ReadBytes(out, cur_len);
+				const int res = lzo1x_decompress(out, cur_len, &buffer[i], &new_len, nullptr);
+				if (res != LZO_E_OK)
+				{
+					// This doesn't seem to happen anymore.
+					PanicAlertT("Internal LZO Error - decompression failed (%d) (%li, %li) \n"
+						"Try loading the state again",
+						res, i, new_len);
+					return;
+				}
+
+				i += new_len;
+			}
 		}
 	}
 	else  // uncompressed
@@ -565,6 +699,8 @@ void LoadAs(const std::string& filename)
 			version_created_by = DoState(p);
 			loaded = true;
 			loadedSuccessfully = (p.GetMode() == PointerWrap::MODE_READ);
+			if (loadedSuccessfully)
+				g_state_size_hint = buffer.size();
 		}
 	}
 
@@ -650,6 +786,9 @@ void Shutdown()
 		std::lock_guard<std::mutex> lk(g_cs_undo_load_buffer);
 		std::vector<u8>().swap(g_undo_load_buffer);
 	}
+
+	g_slot_cache.Clear();
+	g_state_size_hint = 0;
 }
 
 static std::string MakeStateFilename(int number)
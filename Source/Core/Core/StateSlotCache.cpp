@@ -0,0 +1,142 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/StateSlotCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+namespace State
+{
+void SlotCache::Put(const std::string& key, const FileStamp& stamp, const std::vector<u8>& state)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	m_entries.erase(key);
+	if (state.size() > m_max_bytes)
+		return;
+
+	Entry entry;
+	entry.size = state.size();
+	entry.stamp = stamp;
+	entry.last_use = ++m_use_counter;
+
+	const size_t page_count = (state.size() + PAGE_SIZE - 1) / PAGE_SIZE;
+	if (m_base)
+	{
+		const std::vector<u8>& base = *m_base;
+		for (size_t i = 0; i < page_count && entry.page_indices.size() <= page_count / 2; i++)
+		{
+			const size_t start = i * PAGE_SIZE;
+			const size_t length = std::min(PAGE_SIZE, state.size() - start);
+			if (start + length <= base.size() && !memcmp(&state[start], &base[start], length))
+				continue;
+
+			entry.page_indices.push_back((u32)i);
+			entry.page_data.insert(entry.page_data.end(), &state[start], &state[start] + length);
+		}
+	}
+
+	if (!m_base || entry.page_indices.size() > page_count / 2)
+	{
+		m_base = std::make_shared<const std::vector<u8>>(state);
+		entry.page_indices.clear();
+		entry.page_data.clear();
+	}
+
+	entry.base = m_base;
+	entry.page_indices.shrink_to_fit();
+	entry.page_data.shrink_to_fit();
+	m_entries[key] = std::move(entry);
+
+	while (m_entries.size() > 1 && GetMemoryUsageLocked() > m_max_bytes)
+	{
+		auto oldest = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& a, const auto& b) {
+			return a.second.last_use < b.second.last_use;
+		});
+		m_entries.erase(oldest);
+	}
+}
+
+bool SlotCache::Get(const std::string& key, const FileStamp& stamp, std::vector<u8>& state)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	auto it = m_entries.find(key);
+	if (it == m_entries.end())
+		return false;
+
+	Entry& entry = it->second;
+	if (entry.stamp.size != stamp.size || entry.stamp.time_ns != stamp.time_ns)
+	{
+		m_entries.erase(it);
+		return false;
+	}
+
+	entry.last_use = ++m_use_counter;
+	const std::vector<u8>& base = *entry.base;
+	state.resize(entry.size);
+	memcpy(state.data(), base.data(), std::min(base.size(), entry.size));
+
+	// Anything past the end of the base is in the pages
+	size_t offset = 0;
+	for (u32 page : entry.page_indices)
+	{
+		const size_t start = page * PAGE_SIZE;
+		const size_t length = std::min(PAGE_SIZE, entry.size - start);
+		memcpy(&state[start], &entry.page_data[offset], length);
+		offset += length;
+	}
+
+	return true;
+}
+
+void SlotCache::Rename(const std::string& from, const std::string& to)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+
+	m_entries.erase(to);
+	auto it = m_entries.find(from);
+	if (it == m_entries.end())
+		return;
+
+	m_entries[to] = std::move(it->second);
+	m_entries.erase(it);
+}
+
+void SlotCache::Remove(const std::string& key)
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	m_entries.erase(key);
+}
+
+void SlotCache::Clear()
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	m_entries.clear();
+	m_base.reset();
+}
+
+size_t SlotCache::GetMemoryUsage() const
+{
+	std::lock_guard<std::mutex> lk(m_mutex);
+	return GetMemoryUsageLocked();
+}
+
+size_t SlotCache::GetMemoryUsageLocked() const
+{
+	// The current base stays alive for the next save even when no state uses it anymore
+	size_t usage = m_base ? m_base->size() : 0;
+	std::set<const std::vector<u8>*> bases = {m_base.get()};
+	for (auto& entry : m_entries)
+	{
+		if (bases.insert(entry.second.base.get()).second)
+			usage += entry.second.base->size();
+		usage += entry.second.page_data.size() + entry.second.page_indices.size() * sizeof(u32);
+	}
+
+	return usage;
+}
+}  // namespace State
@@ -0,0 +1,79 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+namespace State
+{
+// Keeps the states saved this session in memory so loading one again skips reading and decompressing
+// its file. Saving still writes the compressed file as before and then hands the state to the cache,
+// which costs a page compare and a copy of the pages that changed on the save thread. States are compared
+// page by page with a full base image and only the pages that differ are kept, so states saved a few
+// seconds apart cost little more than the pages the game touched in between.
+//
+// That makes saving slower to speed up loading, and holds memory for it. The default limit keeps this to
+// the case it pays off for, reloading the last few states of a practice session: one full base image
+// and deltas for a handful of states. A state that differs from the base in most of its pages needs a
+// base of its own and pushes out every state stored against the old one
+class SlotCache
+{
+public:
+	static const size_t PAGE_SIZE = 4096;
+	// A GameCube state is about 26 MB, this fits one base image and about 20 MB of pages
+	static const size_t DEFAULT_MAX_BYTES = 48 * 1024 * 1024;
+
+	// The size and modification time in nanoseconds of the file a state was saved to. A cached state is
+	// only used while its file still matches, another instance sharing the user directory may have
+	// rewritten it
+	struct FileStamp
+	{
+		u64 size;
+		u64 time_ns;
+	};
+
+	explicit SlotCache(size_t max_bytes = DEFAULT_MAX_BYTES) : m_max_bytes(max_bytes) {}
+
+	// Least recently used states are dropped to stay within max_bytes
+	void Put(const std::string& key, const FileStamp& stamp, const std::vector<u8>& state);
+	bool Get(const std::string& key, const FileStamp& stamp, std::vector<u8>& state);
+	void Rename(const std::string& from, const std::string& to);
+	void Remove(const std::string& key);
+	void Clear();
+
+	// Bytes held for every cached state, bases shared between states are counted once
+	size_t GetMemoryUsage() const;
+
+private:
+	typedef std::shared_ptr<const std::vector<u8>> Base;
+
+	struct Entry
+	{
+		Base base;
+		size_t size;
+		FileStamp stamp;
+		u64 last_use;
+		// Pages that differ from base, page_data holds them back to back in the same order
+		std::vector<u32> page_indices;
+		std::vector<u8> page_data;
+	};
+
+	size_t GetMemoryUsageLocked() const;
+
+	// The image new states are compared against. States that differ from it in more than half of their
+	// pages become the new base, older states keep the base they were stored against alive
+	Base m_base;
+	std::map<std::string, Entry> m_entries;
+	size_t m_max_bytes;
+	u64 m_use_counter = 0;
+	mutable std::mutex m_mutex;
+};
+}  // namespace State
@@ -10,9 +10,18 @@
 #include <string>
 #include <thread>
 #include <unistd.h>
+#ifdef IS_PLAYBACK
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sys/wait.h>
+#include <vector>
+#endif
 
 #include "Common/CommonTypes.h"
 #include "Common/Event.h"
+#include "Common/FileUtil.h"
 #include "Common/Flag.h"
 #include "Common/Logging/LogManager.h"
 #include "Common/MsgHandler.h"
@@ -28,6 +37,9 @@
 #include "Core/IPC_HLE/WII_IPC_HLE_Device_usb_bt_emu.h"
 #include "Core/IPC_HLE/WII_IPC_HLE_WiiMote.h"
 #include "Core/State.h"
+#ifdef IS_PLAYBACK
+#include "Core/Slippi/SlippiBatchStats.h"
+#endif
 
 #include "UICommon/UICommon.h"
 
@@ -363,6 +375,89 @@ class PlatformX11 : public Platform
 };
 #endif
 
+#ifdef IS_PLAYBACK
+extern std::unique_ptr<SlippiBatchStats> g_batchStats;
+
+// Splits the replays between instances of this executable, each playing its share as a batch of
+// its own, then merges the per-game results of every instance into output_path
+static int RunBatchJobs(const char* exe, const char* iso, const std::vector<std::string>& replays,
+	const std::string& output_path, int jobs)
+{
+	// Hand the biggest replays out first, each to the instance with the least data so far, so
+	// that all instances finish at about the same time
+	std::vector<std::pair<u64, std::string>> sized_replays;
+	for (const auto& replay : replays)
+		sized_replays.emplace_back(File::GetSize(replay), replay);
+	std::sort(sized_replays.begin(), sized_replays.end(),
+		[](const auto& a, const auto& b) { return a.first > b.first; });
+
+	std::vector<std::vector<std::string>> shards(jobs);
+	std::vector<u64> shard_sizes(jobs, 0);
+	for (const auto& replay : sized_replays)
+	{
+		int idx = int(std::min_element(shard_sizes.begin(), shard_sizes.end()) - shard_sizes.begin());
+		shards[idx].push_back(replay.second);
+		shard_sizes[idx] += replay.first;
+	}
+
+	std::vector<pid_t> pids;
+	std::vector<std::string> temp_files;
+	std::vector<std::string> shard_outputs;
+	for (int i = 0; i < jobs; i++)
+	{
+		if (shards[i].empty())
+			continue;
+
+		std::string manifest_path = output_path + "." + std::to_string(i) + ".txt";
+		std::string shard_output = output_path + "." + std::to_string(i);
+		std::ofstream manifest;
+		OpenFStream(manifest, manifest_path, std::ios_base::out | std::ios_base::trunc);
+		for (const auto& replay : shards[i])
+			manifest << replay << std::endl;
+		manifest.close();
+
+		temp_files.push_back(manifest_path);
+		shard_outputs.push_back(shard_output);
+
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			execlp(exe, exe, "--batch", manifest_path.c_str(), "--batch-output", shard_output.c_str(), iso,
+				nullptr);
+			_exit(1);
+		}
+
+		if (pid < 0)
+			fprintf(stderr, "Failed to start batch instance %d\n", i);
+		else
+			pids.push_back(pid);
+	}
+
+	int result = 0;
+	for (pid_t pid : pids)
+	{
+		int status;
+		if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			result = 1;
+	}
+
+	std::ofstream output;
+	OpenFStream(output, output_path, std::ios_base::out | std::ios_base::trunc);
+	for (const auto& shard_output : shard_outputs)
+	{
+		std::string contents;
+		if (File::ReadFileToString(shard_output, contents))
+			output << contents;
+		File::Delete(shard_output);
+	}
+
+	for (const auto& temp_file : temp_files)
+		File::Delete(temp_file);
+
+	return result;
+}
+#endif
+
 static Platform* GetPlatform()
 {
 #if defined(USE_EGL) && defined(USE_HEADLESS)
@@ -376,17 +471,43 @@ static Platform* GetPlatform()
 int main(int argc, char* argv[])
 {
 	int ch, help = 0;
+#ifdef IS_PLAYBACK
+	std::string batch_path;
+	std::string batch_output = "batch-results.jsonl";
+	int batch_jobs = 1;
+#endif
 	struct option longopts[] = { { "exec", no_argument, nullptr, 'e' },
 	{ "help", no_argument, nullptr, 'h' },
 	{ "version", no_argument, nullptr, 'v' },
+#ifdef IS_PLAYBACK
+	{ "batch", required_argument, nullptr, 'b' },
+	{ "batch-output", required_argument, nullptr, 'o' },
+	{ "jobs", required_argument, nullptr, 'j' },
+#endif
 	{ nullptr, 0, nullptr, 0 } };
+	const char* shortopts = "eh?v"
+#ifdef IS_PLAYBACK
+		"b:o:j:"
+#endif
+		;
 
-	while ((ch = getopt_long(argc, argv, "eh?v", longopts, 0)) != -1)
+	while ((ch = getopt_long(argc, argv, shortopts, longopts, 0)) != -1)
 	{
 		switch (ch)
 		{
 		case 'e':
 			break;
+#ifdef IS_PLAYBACK
+		case 'b':
+			batch_path = optarg;
+			break;
+		case 'o':
+			batch_output = optarg;
+			break;
+		case 'j':
+			batch_jobs = std::max(1, atoi(optarg));
+			break;
+#endif
 		case 'h':
 		case '?':
 			help = 1;
@@ -405,9 +526,32 @@ int main(int argc, char* argv[])
 		fprintf(stderr, "  -e, --exec     Load the specified file\n");
 		fprintf(stderr, "  -h, --help     Show this help message\n");
 		fprintf(stderr, "  -v, --version  Print version and exit\n");
+#ifdef IS_PLAYBACK
+		fprintf(stderr, "  -b, --batch <dir|manifest>  Play every replay in a directory or manifest as fast\n"
+			"                              as possible and record per-game results\n");
+		fprintf(stderr, "  -o, --batch-output <file>   Where to write batch results (default: batch-results.jsonl)\n");
+		fprintf(stderr, "  -j, --jobs <count>          Number of instances to split the batch between\n");
+#endif
 		return 1;
 	}
 
+#ifdef IS_PLAYBACK
+	std::vector<std::string> batch_replays;
+	std::string batch_comm_path = batch_output + ".playback.json";
+	if (!batch_path.empty())
+	{
+		batch_replays = SlippiBatchStats::FindReplays(batch_path);
+		if (batch_replays.empty())
+		{
+			fprintf(stderr, "No replays found in %s\n", batch_path.c_str());
+			return 1;
+		}
+
+		if (batch_jobs > 1)
+			return RunBatchJobs(argv[0], argv[optind], batch_replays, batch_output, batch_jobs);
+	}
+#endif
+
 	platform = GetPlatform();
 	if (!platform)
 	{
@@ -418,6 +562,25 @@ int main(int argc, char* argv[])
 	UICommon::SetUserDirectory("");  // Auto-detect user folder
 	UICommon::Init();
 
+#ifdef IS_PLAYBACK
+	if (!batch_replays.empty())
+	{
+		if (!SlippiBatchStats::WriteQueueFile(batch_comm_path, batch_replays))
+		{
+			fprintf(stderr, "Could not write %s\n", batch_comm_path.c_str());
+			return 1;
+		}
+
+		// Run unthrottled without sound, the batch fast forwards every frame so nothing gets drawn either
+		SConfig& config = SConfig::GetInstance();
+		config.m_strSlippiInput = batch_comm_path;
+		config.m_EmulationSpeed = 0.0f;
+		config.sBackend = BACKEND_NULLSOUND;
+		config.m_slippiSaveReplays = false;
+		g_batchStats = std::make_unique<SlippiBatchStats>(batch_output);
+	}
+#endif
+
 	Core::SetOnStoppedCallback([]() { s_running.Clear(); });
 	platform->Init();
 
@@ -449,9 +612,23 @@ int main(int argc, char* argv[])
 
 	Core::Shutdown();
 	platform->Shutdown();
+
+	int result = 0;
+#ifdef IS_PLAYBACK
+	if (g_batchStats)
+	{
+		result = g_batchStats->IsFinished() ? 0 : 1;
+		g_batchStats.reset();
+		File::Delete(batch_comm_path);
+
+		// Reload the settings so the batch overrides don't get saved over the user's config
+		SConfig::GetInstance().LoadSettings();
+	}
+#endif
+
 	UICommon::Shutdown();
 
 	delete platform;
 
-	return 0;
+	return result;
 }
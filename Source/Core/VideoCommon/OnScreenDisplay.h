@@ -29,6 +29,7 @@ enum class MessageType
 {
 	NetPlayPing,
 	NetPlayBuffer,
+	RollbackStats,
 	FrameIndex,
 
 	// This entry must be kept last so that persistent typed messages are
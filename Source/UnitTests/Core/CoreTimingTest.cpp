@@ -4,12 +4,17 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <array>
 #include <bitset>
+#include <functional>
+#include <random>
+#include <vector>
 
 #include "Core/ConfigManager.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
+#include "Core/CoreTimingQueue.h"
 #include "Core/PowerPC/PowerPC.h"
 
 // Numbers are chosen randomly to make sure the correct one is given.
@@ -318,3 +323,135 @@ TEST(CoreTiming, Overclocking)
   SConfig::GetInstance().m_OCFactor = 1.0;
   AdvanceAndCheck(4, MAX_SLICE_LENGTH);
 }
+
+namespace EventQueueTest
+{
+// Removes by rebuilding the heap like CoreTiming used to, every pop has to match it
+class HeapQueue
+{
+public:
+  void Push(const CoreTiming::Event& event)
+  {
+    m_heap.push_back(event);
+    std::push_heap(m_heap.begin(), m_heap.end(), std::greater<CoreTiming::Event>());
+  }
+  const CoreTiming::Event& Top() { return m_heap.front(); }
+  CoreTiming::Event Pop()
+  {
+    std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<CoreTiming::Event>());
+    CoreTiming::Event event = m_heap.back();
+    m_heap.pop_back();
+    return event;
+  }
+  bool Empty() const { return m_heap.empty(); }
+  void Remove(CoreTiming::EventType* event_type)
+  {
+    auto itr = std::remove_if(m_heap.begin(), m_heap.end(),
+                              [&](const CoreTiming::Event& e) { return e.type == event_type; });
+    if (itr != m_heap.end())
+    {
+      m_heap.erase(itr, m_heap.end());
+      std::make_heap(m_heap.begin(), m_heap.end(), std::greater<CoreTiming::Event>());
+    }
+  }
+
+private:
+  std::vector<CoreTiming::Event> m_heap;
+};
+
+static CoreTiming::EventType* FakeType(u32 index)
+{
+  return reinterpret_cast<CoreTiming::EventType*>(static_cast<uintptr_t>(index + 1) * 64);
+}
+
+// Runs the pattern Advance() sees: slices of up to MAX_SLICE_LENGTH cycles, every due event popped
+// and most of them rescheduled a period later. Returns a checksum of the pop order
+template <typename Queue>
+u64 RunWorkload(Queue& queue, u32 seed, int slices, int types)
+{
+  std::minstd_rand rng(seed);
+  s64 now = 0;
+  u64 fifo = 0;
+  u64 checksum = 0;
+
+  for (int i = 0; i < types; i++)
+    queue.Push(CoreTiming::Event{static_cast<s64>(rng() % MAX_SLICE_LENGTH), fifo++, 0, FakeType(i)});
+
+  for (int slice = 0; slice < slices; slice++)
+  {
+    while (!queue.Empty() && queue.Top().time <= now)
+    {
+      CoreTiming::Event event = queue.Pop();
+      checksum = checksum * 31 + event.fifo_order;
+
+      // Mostly periodic events, some share a time, a few get scheduled into the past
+      const u32 roll = rng() % 64;
+      s64 period = static_cast<s64>(rng() % (4 * MAX_SLICE_LENGTH));
+      if (roll == 0)
+        period = -static_cast<s64>(rng() % 1000);
+      else if (roll < 8)
+        period = 1000;
+      event.time = now + period - (now - event.time);
+      event.fifo_order = fifo++;
+      queue.Push(event);
+    }
+
+    if (rng() % 256 == 0)
+    {
+      const u32 type = rng() % types;
+      queue.Remove(FakeType(type));
+      queue.Push(CoreTiming::Event{now + 100, fifo++, 0, FakeType(type)});
+    }
+
+    now += queue.Empty() ? MAX_SLICE_LENGTH : std::min<s64>(std::max<s64>(queue.Top().time - now, 1),
+                                                             MAX_SLICE_LENGTH);
+  }
+
+  return checksum;
+}
+}
+
+TEST(CoreTiming, EventQueueMatchesHeap)
+{
+  using namespace EventQueueTest;
+
+  for (u32 seed = 0; seed < 8; seed++)
+  {
+    HeapQueue heap;
+    CoreTiming::EventQueue queue;
+    EXPECT_EQ(RunWorkload(heap, seed, 20000, 24), RunWorkload(queue, seed, 20000, 24));
+  }
+
+  // Same times pop in the order they were added
+  CoreTiming::EventQueue queue;
+  for (u64 i = 0; i < 5; i++)
+    queue.Push(CoreTiming::Event{1000, 4 - i, i, FakeType(0)});
+  queue.Push(CoreTiming::Event{-5, 10, 5, FakeType(1)});
+  EXPECT_EQ(5u, queue.Pop().userdata);
+  for (u64 i = 0; i < 5; i++)
+    EXPECT_EQ(4 - i, queue.Pop().userdata);
+  EXPECT_TRUE(queue.Empty());
+
+  // Removing several events of a type, including the last ones in the heap
+  for (u32 seed = 0; seed < 64; seed++)
+  {
+    std::minstd_rand rng(seed);
+    HeapQueue heap;
+    for (u64 i = 0; i < 40; i++)
+    {
+      const CoreTiming::Event event{static_cast<s64>(rng() % 100), i, i, FakeType(rng() % 3)};
+      heap.Push(event);
+      queue.Push(event);
+    }
+
+    heap.Remove(FakeType(seed % 3));
+    const size_t removed = queue.Remove(FakeType(seed % 3));
+    EXPECT_EQ(40u - removed, queue.Size());
+    while (!heap.Empty())
+    {
+      ASSERT_FALSE(queue.Empty());
+      EXPECT_EQ(heap.Pop().userdata, queue.Pop().userdata);
+    }
+    EXPECT_TRUE(queue.Empty());
+  }
+}
@@ -0,0 +1,150 @@
+// Copyright 2008 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/StateSlotCache.h"
+
+// About the size of a GameCube state, most of which is MEM1
+static constexpr size_t STATE_SIZE = 26 * 1024 * 1024;
+static constexpr size_t PAGE_SIZE = State::SlotCache::PAGE_SIZE;
+static const State::SlotCache::FileStamp STAMP = {1000, 1};
+
+static std::vector<u8> MakeState(u32 seed)
+{
+  std::vector<u8> state(STATE_SIZE);
+  std::mt19937 rng(seed);
+  // Mostly zeroes with some noise
+  for (size_t i = 0; i < state.size(); i += 16)
+    state[i] = static_cast<u8>(rng());
+  return state;
+}
+
+// What a few seconds of gameplay do to a state: a handful of pages get rewritten
+static void TouchPages(std::vector<u8>& state, u32 seed, size_t pages)
+{
+  std::mt19937 rng(seed);
+  for (size_t i = 0; i < pages; i++)
+  {
+    const size_t page = rng() % (state.size() / PAGE_SIZE);
+    for (size_t j = 0; j < PAGE_SIZE; j += 8)
+      state[page * PAGE_SIZE + j] ^= static_cast<u8>(rng() | 1);
+  }
+}
+
+TEST(StateSlotCache, RoundTrip)
+{
+  State::SlotCache cache;
+  std::vector<u8> first = MakeState(1);
+  std::vector<u8> second = first;
+  TouchPages(second, 2, 64);
+  // A size that isn't a multiple of the page size has a partial last page
+  second.resize(second.size() + 100, 0x5A);
+
+  cache.Put("slot1", STAMP, first);
+  cache.Put("slot2", STAMP, second);
+
+  std::vector<u8> loaded;
+  EXPECT_TRUE(cache.Get("slot1", STAMP, loaded));
+  EXPECT_EQ(first, loaded);
+  EXPECT_TRUE(cache.Get("slot2", STAMP, loaded));
+  EXPECT_EQ(second, loaded);
+  EXPECT_FALSE(cache.Get("slot3", STAMP, loaded));
+
+  // The second state only keeps the pages that differ
+  EXPECT_LT(cache.GetMemoryUsage(), first.size() + 70 * PAGE_SIZE);
+}
+
+TEST(StateSlotCache, NewBase)
+{
+  // The default limit only has room for one base
+  State::SlotCache cache(2 * STATE_SIZE);
+  std::vector<u8> first = MakeState(1);
+  std::vector<u8> second = MakeState(2);
+
+  cache.Put("slot1", STAMP, first);
+  cache.Put("slot2", STAMP, second);
+
+  // Every page differs, so the second state became a base of its own and the first one kept its own
+  std::vector<u8> loaded;
+  EXPECT_TRUE(cache.Get("slot1", STAMP, loaded));
+  EXPECT_EQ(first, loaded);
+  EXPECT_TRUE(cache.Get("slot2", STAMP, loaded));
+  EXPECT_EQ(second, loaded);
+  EXPECT_EQ(first.size() + second.size(), cache.GetMemoryUsage());
+
+  cache.Remove("slot1");
+  EXPECT_EQ(second.size(), cache.GetMemoryUsage());
+}
+
+TEST(StateSlotCache, RenameAndOverwrite)
+{
+  State::SlotCache cache;
+  std::vector<u8> first = MakeState(1);
+  std::vector<u8> second = first;
+  TouchPages(second, 2, 16);
+
+  cache.Put("slot1", STAMP, first);
+  cache.Rename("slot1", "lastState");
+  cache.Put("slot1", STAMP, second);
+
+  std::vector<u8> loaded;
+  EXPECT_TRUE(cache.Get("lastState", STAMP, loaded));
+  EXPECT_EQ(first, loaded);
+  EXPECT_TRUE(cache.Get("slot1", STAMP, loaded));
+  EXPECT_EQ(second, loaded);
+
+  cache.Clear();
+  EXPECT_FALSE(cache.Get("slot1", STAMP, loaded));
+  EXPECT_EQ(0u, cache.GetMemoryUsage());
+}
+
+TEST(StateSlotCache, ChangedFile)
+{
+  State::SlotCache cache;
+  std::vector<u8> first = MakeState(1);
+  cache.Put("slot1", STAMP, first);
+
+  // The file was rewritten by someone else, the cached state is dropped
+  std::vector<u8> loaded;
+  EXPECT_FALSE(cache.Get("slot1", {STAMP.size, STAMP.time_ns + 1}, loaded));
+  EXPECT_FALSE(cache.Get("slot1", STAMP, loaded));
+
+  cache.Put("slot1", STAMP, first);
+  EXPECT_FALSE(cache.Get("slot1", {STAMP.size + 1, STAMP.time_ns}, loaded));
+}
+
+TEST(StateSlotCache, MemoryLimit)
+{
+  // Room for two full states, every state here needs its own base
+  State::SlotCache cache(2 * STATE_SIZE + STATE_SIZE / 2);
+  std::vector<u8> first = MakeState(1);
+  std::vector<u8> second = MakeState(2);
+  std::vector<u8> third = MakeState(3);
+
+  cache.Put("slot1", STAMP, first);
+  cache.Put("slot2", STAMP, second);
+  std::vector<u8> loaded;
+  EXPECT_TRUE(cache.Get("slot1", STAMP, loaded));
+
+  // slot2 was used longest ago
+  cache.Put("slot3", STAMP, third);
+  EXPECT_LE(cache.GetMemoryUsage(), 2 * STATE_SIZE + STATE_SIZE / 2);
+  EXPECT_FALSE(cache.Get("slot2", STAMP, loaded));
+  EXPECT_TRUE(cache.Get("slot1", STAMP, loaded));
+  EXPECT_EQ(first, loaded);
+  EXPECT_TRUE(cache.Get("slot3", STAMP, loaded));
+  EXPECT_EQ(third, loaded);
+
+  // A state bigger than the limit isn't kept at all
+  State::SlotCache small_cache(STATE_SIZE / 2);
+  small_cache.Put("slot1", STAMP, first);
+  EXPECT_FALSE(small_cache.Get("slot1", STAMP, loaded));
+  EXPECT_EQ(0u, small_cache.GetMemoryUsage());
+}